@@ -0,0 +1,70 @@
+#include "line_reader.h"
+
+LineReader::LineReader()
+    : head_(0), tail_(0), fill_(0), inLine_(false), discard_(false),
+      discardIsOverlong_(false), lines_(0), overlong_(0), dropped_(0) {}
+
+uint8_t LineReader::feed(const uint8_t *data, size_t n, uint32_t nowUs) {
+  uint8_t completed = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    uint8_t c = data[i];
+    uint32_t head = head_.load(std::memory_order_relaxed);
+
+    if (!inLine_) {
+      // New line: claim the next slot, or drop the line if the consumer
+      // has not released it yet
+      inLine_ = true;
+      fill_ = 0;
+      discard_ = head - tail_.load(std::memory_order_acquire) >= LINE_SLOTS;
+      discardIsOverlong_ = false;
+      if (!discard_) slots_[head % LINE_SLOTS].firstByteUs = nowUs;
+    }
+
+    if (c == '\n') {
+      inLine_ = false;
+      if (discard_) {
+        if (discardIsOverlong_) overlong_++;
+        else dropped_++;
+        continue;
+      }
+
+      LineSlot &slot = slots_[head % LINE_SLOTS];
+      while (fill_ > 0 && (slot.text[fill_ - 1] == '\r' || slot.text[fill_ - 1] == ' ' ||
+                           slot.text[fill_ - 1] == '\t')) {
+        fill_--;
+      }
+      if (fill_ == 0) continue;   // blank line
+
+      slot.text[fill_] = '\0';
+      slot.len = fill_;
+      lines_++;
+      completed++;
+      head_.store(head + 1, std::memory_order_release);
+      continue;
+    }
+
+    if (discard_) continue;
+    if (fill_ == LINE_MAX_LEN) {
+      // Blanks past the limit only count once text follows them, so a
+      // full-length line sent with CRLF still fits
+      if (c == '\r' || c == ' ' || c == '\t') continue;
+      discard_ = true;
+      discardIsOverlong_ = true;
+      continue;
+    }
+    slots_[head % LINE_SLOTS].text[fill_++] = (char)c;
+  }
+
+  return completed;
+}
+
+LineSlot *LineReader::peek() {
+  uint32_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail == head_.load(std::memory_order_acquire)) return nullptr;
+  return &slots_[tail % LINE_SLOTS];
+}
+
+void LineReader::release() {
+  tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
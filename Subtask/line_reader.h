@@ -0,0 +1,57 @@
+#pragma once
+
+// ==========================================
+// SERIAL LINE READER (portable, no Arduino deps)
+// ==========================================
+// Assembles '\n'-terminated command lines from raw UART bytes straight into
+// a fixed ring of line slots: no heap, no String. One producer (the UART
+// receive callback) feeds bytes; one consumer (InputTask) takes complete
+// lines in place and releases them. Lines longer than LINE_MAX_LEN, not
+// counting '\r' and trailing blanks, are discarded up to their newline.
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LINE_MAX_LEN 127   // characters per line, excluding the newline
+#define LINE_SLOTS 4       // complete lines waiting for the consumer
+
+struct LineSlot {
+  char text[LINE_MAX_LEN + 1];   // NUL-terminated, '\r' and trailing blanks stripped
+  uint16_t len;
+  uint32_t firstByteUs;          // arrival of the line's first byte
+};
+
+class LineReader {
+public:
+  LineReader();
+
+  // Producer: appends received bytes, nowUs timestamps a line that starts
+  // in this batch. Returns the number of lines completed.
+  uint8_t feed(const uint8_t *data, size_t n, uint32_t nowUs);
+
+  // Consumer: oldest complete line, or NULL. The slot stays valid (and may
+  // be modified, e.g. by in-place JSON parsing) until release().
+  LineSlot *peek();
+  void release();
+
+  // Counters since construction
+  uint32_t lines() const { return lines_; }          // delivered lines
+  uint32_t overlong() const { return overlong_; }    // discarded, too long
+  uint32_t dropped() const { return dropped_; }      // discarded, ring full
+
+private:
+  LineSlot slots_[LINE_SLOTS];
+  std::atomic<uint32_t> head_;   // next slot the producer fills
+  std::atomic<uint32_t> tail_;   // next slot the consumer reads
+
+  // Producer-only state for the line being assembled
+  uint16_t fill_;
+  bool inLine_;
+  bool discard_;
+  bool discardIsOverlong_;
+
+  uint32_t lines_;
+  uint32_t overlong_;
+  uint32_t dropped_;
+};
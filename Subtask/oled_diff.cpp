@@ -0,0 +1,89 @@
+#include "oled_diff.h"
+
+#include <string.h>
+
+OledDiff::OledDiff(uint8_t width, uint8_t height)
+    : width_(width > OLED_MAX_WIDTH ? OLED_MAX_WIDTH : width),
+      pages_((height + 7) / 8 > OLED_MAX_PAGES ? OLED_MAX_PAGES : (height + 7) / 8),
+      valid_(false), frames_(0), pushed_(0), bytes_(0) {
+  memset(shadow_, 0, sizeof(shadow_));
+}
+
+void OledDiff::invalidate() {
+  valid_ = false;
+}
+
+uint8_t OledDiff::diff(const uint8_t *frame, OledSpan *spans) {
+  uint8_t count = 0;
+  frames_++;
+
+  for (uint8_t page = 0; page < pages_; page++) {
+    const uint8_t *now = frame + (size_t)page * width_;
+    uint8_t *was = shadow_ + (size_t)page * width_;
+    uint8_t onPage = 0;
+
+    if (!valid_) {
+      spans[count++] = {page, 0, (uint8_t)(width_ - 1)};
+      bytes_ += width_;
+      continue;
+    }
+
+    int col = 0;
+    while (col < width_) {
+      // Skip to the next changed byte
+      while (col < width_ && now[col] == was[col]) col++;
+      if (col == width_) break;
+
+      // Extend over changes separated by short unchanged gaps; the last
+      // allowed span on a page swallows everything to the right
+      int start = col, end = col, gap = 0;
+      bool last = onPage == kMaxSpansPerPage - 1;
+      for (col++; col < width_; col++) {
+        if (now[col] != was[col]) {
+          end = col;
+          gap = 0;
+        } else if (++gap > kMergeGap && !last) {
+          break;
+        }
+      }
+
+      spans[count++] = {page, (uint8_t)start, (uint8_t)end};
+      onPage++;
+      bytes_ += end - start + 1;
+      col = end + 1;
+    }
+  }
+
+  memcpy(shadow_, frame, (size_t)width_ * pages_);
+  valid_ = true;
+  if (count > 0) pushed_++;
+  return count;
+}
+
+RateCounter::RateCounter() : total_(0) {
+  memset(stamp_, 0, sizeof(stamp_));
+  memset(count_, 0, sizeof(count_));
+}
+
+void RateCounter::tick(uint32_t nowMs) {
+  total_++;
+
+  uint32_t bucket = nowMs / RATE_BUCKET_MS;
+  uint8_t slot = bucket % RATE_BUCKETS;
+  if (stamp_[slot] != bucket) {
+    // Slot last used a full window (or more) ago
+    stamp_[slot] = bucket;
+    count_[slot] = 0;
+  }
+  if (count_[slot] < UINT16_MAX) count_[slot]++;
+}
+
+float RateCounter::rate(uint32_t nowMs) const {
+  uint32_t bucket = nowMs / RATE_BUCKET_MS;
+  uint32_t events = 0;
+  for (uint8_t i = 0; i < RATE_BUCKETS; i++) {
+    // Unsigned subtraction: stale and never-used slots fall out
+    if (bucket - stamp_[i] < RATE_BUCKETS) events += count_[i];
+  }
+  return events * 1000.0f / (RATE_BUCKETS * RATE_BUCKET_MS);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// ==========================================
+// OLED DIRTY-REGION DIFF (portable, no Arduino deps)
+// ==========================================
+// SSD1306 GDDRAM is organised in pages of 8 pixel rows: byte (page, col)
+// holds 8 vertical pixels, bit 0 on top, which is also the layout of the
+// Adafruit_SSD1306 buffer (index = col + page * width). OledDiff keeps a
+// shadow copy of what the panel shows and turns a new frame into the few
+// column spans per page that actually changed.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define OLED_MAX_WIDTH 128
+#define OLED_MAX_PAGES 8
+
+// A run of changed bytes on one page, columns [col0, col1] inclusive
+struct OledSpan {
+  uint8_t page;
+  uint8_t col0;
+  uint8_t col1;
+};
+
+class OledDiff {
+public:
+  // Setting up a span (page + column address) costs 6 command bytes, so
+  // dirty runs closer than this are sent as one span.
+  static const uint8_t kMergeGap = 6;
+  static const uint8_t kMaxSpansPerPage = 4;
+  static const uint8_t kMaxSpans = OLED_MAX_PAGES * kMaxSpansPerPage;
+
+  OledDiff(uint8_t width, uint8_t height);
+
+  // Forget the shadow so the next diff() reports the whole screen
+  // (after display.begin() or anything that bypassed the diff).
+  void invalidate();
+
+  // Compares frame with the shadow, writes the dirty spans (page order,
+  // left to right) and takes frame as the new shadow. Returns the number
+  // of spans, 0 if nothing changed.
+  uint8_t diff(const uint8_t *frame, OledSpan *spans);
+
+  uint8_t width() const { return width_; }
+  uint8_t pages() const { return pages_; }
+
+  // Counters since construction
+  uint32_t frames() const { return frames_; }          // diff() calls
+  uint32_t pushedFrames() const { return pushed_; }    // ... with changes
+  uint32_t bytesSent() const { return bytes_; }        // data bytes in spans
+
+  // Bytes a full refresh would have sent for the same frames
+  uint32_t bytesFull() const { return frames_ * (uint32_t)width_ * pages_; }
+
+private:
+  uint8_t width_;
+  uint8_t pages_;
+  bool valid_;
+  uint8_t shadow_[OLED_MAX_WIDTH * OLED_MAX_PAGES];
+
+  uint32_t frames_;
+  uint32_t pushed_;
+  uint32_t bytes_;
+};
+
+// Events per second over a sliding one-second window, fed with a
+// millisecond clock (millis() on the board, anything on the host). The
+// window slides in RATE_BUCKET_MS steps, so the rate falls to 0 within a
+// second once ticks stop.
+#define RATE_BUCKET_MS 100
+#define RATE_BUCKETS 10
+
+class RateCounter {
+public:
+  RateCounter();
+
+  void tick(uint32_t nowMs);
+
+  // Events in the last RATE_BUCKETS * RATE_BUCKET_MS ms, per second
+  float rate(uint32_t nowMs) const;
+  uint32_t total() const { return total_; }
+
+private:
+  uint32_t stamp_[RATE_BUCKETS];   // bucket number, nowMs / RATE_BUCKET_MS
+  uint16_t count_[RATE_BUCKETS];
+  uint32_t total_;
+};
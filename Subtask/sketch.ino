@@ -4,11 +4,22 @@
 #include <Adafruit_SSD1306.h>
 #include <ArduinoJson.h>
 
+#include "line_reader.h"
+#include "oled_diff.h"
+
 #define LED_PIN 2   // change to 13 / 15 / whatever your LED is wired to
+#define HEART_ON_MS 100
+#define HEART_MIN_DELAY_MS 10      // accepted "delay" range; commands outside
+#define HEART_MAX_DELAY_MS 60000   // it are clamped
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
+#define OLED_I2C_ADDR 0x3C
+#define OLED_I2C_CHUNK 32   // data bytes per I2C transaction, fits any Wire buffer
 
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
+OledDiff oledDiff(SCREEN_WIDTH, SCREEN_HEIGHT);
+RateCounter oledRate;
+LineReader serialLines;
 
 // RTOS Handles
 QueueHandle_t commandQueue;
@@ -17,44 +28,132 @@ TaskHandle_t t_Display;
 TaskHandle_t t_Blink;
 
 // Shared Global Variable
-volatile int currentDelay = 1000; // Default 1 second blink
+volatile int currentDelay = 1000; // Default 1 second blink, as applied by HeartTask
+
+// Heartbeat timing, written by HeartTask only
+struct HeartStats {
+  volatile int32_t lastEdgeErrorUs;   // actual - scheduled time of the last LED edge
+  volatile int32_t maxEdgeErrorUs;    // largest |error| since boot
+  volatile uint32_t edges;
+  volatile uint32_t lastApplyUs;      // heartSetRate() -> new rate in effect
+  volatile uint32_t maxApplyUs;
+};
+HeartStats heartStats;
+volatile uint32_t heartRequestUs;
 
 // Data Structure for the Queue
 struct Command {
   char text[20];
   int blinkRate;
+  uint32_t rxUs;   // micros() when the command's first byte arrived
 };
 
 // ==========================================
 // TASK 1: THE HEART (Blink LED)
 // ==========================================
+// Edges are scheduled on absolute time (each phase starts exactly where
+// the previous one was scheduled to end), so wake-up jitter never
+// accumulates. A new rate arrives as a task notification and applies at
+// once: a running OFF phase is re-timed from its original start, ending
+// immediately if the new length has already elapsed.
 void HeartTask(void *pvParameters) {
   pinMode(LED_PIN, OUTPUT);
 
+  bool on = true;
+  digitalWrite(LED_PIN, HIGH);
+  uint32_t phaseStart = micros();
+  uint32_t phaseLen = HEART_ON_MS * 1000UL;
+
   for (;;) {
-    digitalWrite(LED_PIN, HIGH);
-    vTaskDelay(pdMS_TO_TICKS(100));   // ON for 100ms
+    uint32_t edge = phaseStart + phaseLen;
+    int32_t remaining = (int32_t)(edge - micros());
+    TickType_t wait = remaining > 0 ? pdMS_TO_TICKS((remaining + 999) / 1000) : 0;
+
+    uint32_t newDelay;
+    if (xTaskNotifyWait(0, UINT32_MAX, &newDelay, wait) == pdTRUE) {
+      currentDelay = (int)newDelay;
+      if (!on) {
+        uint32_t elapsed = micros() - phaseStart;
+        uint64_t newLen = (uint64_t)newDelay * 1000;
+        phaseLen = newLen > elapsed ? (uint32_t)newLen : elapsed;
+      }
+
+      uint32_t apply = micros() - heartRequestUs;
+      heartStats.lastApplyUs = apply;
+      if (apply > heartStats.maxApplyUs) heartStats.maxApplyUs = apply;
+      continue;
+    }
+
+    int32_t error = (int32_t)(micros() - edge);
+    heartStats.lastEdgeErrorUs = error;
+    if (abs(error) > heartStats.maxEdgeErrorUs) heartStats.maxEdgeErrorUs = abs(error);
+    heartStats.edges++;
 
-    digitalWrite(LED_PIN, LOW);
-    vTaskDelay(pdMS_TO_TICKS(currentDelay));
+    on = !on;
+    digitalWrite(LED_PIN, on ? HIGH : LOW);
+    phaseStart = edge;
+    phaseLen = (uint32_t)((uint64_t)(on ? HEART_ON_MS : currentDelay) * 1000);
+
+    // More than a whole phase behind (e.g. halted in a debugger): resync
+    // instead of firing a burst of catch-up edges
+    if ((int32_t)(micros() - (phaseStart + phaseLen)) > 0) phaseStart = micros();
   }
 }
 
-
+// Called by DisplayTask; HeartTask runs at a higher priority, so the new
+// rate is in effect before this returns. The clamp keeps phases far below
+// the 2^31 us that the wrap-safe micros() comparisons can handle.
+void heartSetRate(int delayMs) {
+  if (delayMs < HEART_MIN_DELAY_MS || delayMs > HEART_MAX_DELAY_MS) {
+    delayMs = constrain(delayMs, HEART_MIN_DELAY_MS, HEART_MAX_DELAY_MS);
+    Serial.printf("Heartbeat delay clamped to %d ms\n", delayMs);
+  }
+  heartRequestUs = micros();
+  xTaskNotify(t_Blink, (uint32_t)delayMs, eSetValueWithOverwrite);
+}
 
 // ==========================================
 // TASK 2: THE EAR (Serial Input)
 // ==========================================
+// Runs in the UART driver's event task whenever bytes arrive (or the line
+// goes idle): bytes go straight into the line ring, and InputTask is woken
+// only once a full line is there (or one was rejected, to report it).
+void onSerialReceive() {
+  uint8_t buf[64];
+  uint8_t lines = 0;
+  uint32_t now = micros();
+  uint32_t rejected = serialLines.overlong() + serialLines.dropped();
+
+  size_t n;
+  while ((n = Serial.available()) > 0) {
+    n = Serial.read(buf, n < sizeof(buf) ? n : sizeof(buf));
+    lines += serialLines.feed(buf, n, now);
+  }
+
+  rejected = serialLines.overlong() + serialLines.dropped() - rejected;
+  if ((lines > 0 || rejected > 0) && t_Input != NULL) {
+    xTaskNotifyGive(t_Input);
+  }
+}
+
 void InputTask(void *pvParameters) {
+  t_Input = xTaskGetCurrentTaskHandle();   // before the first callback
+
   Serial.begin(115200);
+  Serial.setRxTimeout(1);          // callback after 1 idle symbol, not a full FIFO
+  Serial.onReceive(onSerialReceive);
+
+  uint32_t lastOverlong = 0, lastDropped = 0;
 
   for (;;) {
-    if (Serial.available() > 0) {
-      String input = Serial.readStringUntil('\n');
-      input.trim();
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
+    LineSlot *line;
+    while ((line = serialLines.peek()) != NULL) {
+      // Zero-copy parse: a mutable char* lets ArduinoJson point its
+      // strings into the slot instead of duplicating them
       StaticJsonDocument<200> doc;
-      DeserializationError error = deserializeJson(doc, input);
+      DeserializationError error = deserializeJson(doc, line->text);
 
       if (!error) {
         Command cmd;
@@ -62,6 +161,7 @@ void InputTask(void *pvParameters) {
         // Extract JSON fields
         strlcpy(cmd.text, doc["msg"] | "", sizeof(cmd.text));
         cmd.blinkRate = doc["delay"] | currentDelay;
+        cmd.rxUs = line->firstByteUs;
 
         // Send command to queue
         xQueueSend(commandQueue, &cmd, portMAX_DELAY);
@@ -70,41 +170,100 @@ void InputTask(void *pvParameters) {
       } else {
         Serial.println("JSON Error");
       }
+      serialLines.release();
+    }
+
+    if (serialLines.overlong() != lastOverlong) {
+      lastOverlong = serialLines.overlong();
+      Serial.printf("Line too long (max %d chars), discarded\n", LINE_MAX_LEN);
+    }
+    if (serialLines.dropped() != lastDropped) {
+      lastDropped = serialLines.dropped();
+      Serial.println("Input busy, line dropped");
     }
-    vTaskDelay(50 / portTICK_PERIOD_MS);
   }
 }
 
+// ==========================================
+// OLED PUSH (dirty regions only)
+// ==========================================
+// Replaces display.display(): instead of the whole 1 KB framebuffer, only
+// the column spans that differ from what the panel already shows are sent.
+// Returns the number of spans written.
+uint8_t oledPush() {
+  static OledSpan spans[OledDiff::kMaxSpans];
+  uint8_t *buf = display.getBuffer();
+  uint8_t n = oledDiff.diff(buf, spans);
+
+  for (uint8_t i = 0; i < n; i++) {
+    const OledSpan &s = spans[i];
+
+    // Address window = this span; GDDRAM writes then auto-increment in it
+    display.ssd1306_command(SSD1306_PAGEADDR);
+    display.ssd1306_command(s.page);
+    display.ssd1306_command(s.page);
+    display.ssd1306_command(SSD1306_COLUMNADDR);
+    display.ssd1306_command(s.col0);
+    display.ssd1306_command(s.col1);
+
+    const uint8_t *p = buf + s.page * SCREEN_WIDTH + s.col0;
+    int len = s.col1 - s.col0 + 1;
+    while (len > 0) {
+      int chunk = len < OLED_I2C_CHUNK ? len : OLED_I2C_CHUNK;
+      Wire.beginTransmission(OLED_I2C_ADDR);
+      Wire.write((uint8_t)0x40);   // Co = 0, D/C = 1: data stream
+      Wire.write(p, chunk);
+      Wire.endTransmission();
+      p += chunk;
+      len -= chunk;
+    }
+  }
+
+  if (n > 0) oledRate.tick(millis());
+  return n;
+}
+
 // ==========================================
 // TASK 3: THE FACE (OLED Display)
 // ==========================================
 void DisplayTask(void *pvParameters) {
   Command receivedCmd;
 
-  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
+  if (!display.begin(SSD1306_SWITCHCAPVCC, OLED_I2C_ADDR)) {
     for (;;);
   }
+  oledDiff.invalidate();   // begin() showed the splash, panel state unknown
 
+  // clearDisplay() and the draw calls only touch the RAM buffer
   display.clearDisplay();
   display.setTextSize(2);
   display.setTextColor(SSD1306_WHITE);
   display.setCursor(0, 20);
   display.println("Waiting...");
-  display.display();
+  oledPush();
 
   for (;;) {
     if (xQueueReceive(commandQueue, &receivedCmd, portMAX_DELAY)) {
 
       // Update heartbeat delay
-      currentDelay = receivedCmd.blinkRate;
+      heartSetRate(receivedCmd.blinkRate);
 
       // Update OLED
       display.clearDisplay();
       display.setCursor(0, 20);
       display.println(receivedCmd.text);
-      display.display();
+      uint8_t spans = oledPush();
+      uint32_t latencyUs = micros() - receivedCmd.rxUs;
 
-      Serial.println("Screen Updated.");
+      Serial.printf("Screen Updated. (%u spans, %lu/%lu bytes vs full refresh, %.1f fps, "
+                    "command-to-screen %lu us)\n",
+                    spans, (unsigned long)oledDiff.bytesSent(),
+                    (unsigned long)oledDiff.bytesFull(), oledRate.rate(millis()),
+                    (unsigned long)latencyUs);
+      Serial.printf("Heartbeat: %d ms applied in %lu us (max %lu), edge error last %ld us / max %ld us\n",
+                    currentDelay, (unsigned long)heartStats.lastApplyUs,
+                    (unsigned long)heartStats.maxApplyUs,
+                    (long)heartStats.lastEdgeErrorUs, (long)heartStats.maxEdgeErrorUs);
     }
   }
 }
@@ -117,7 +276,9 @@ void setup() {
   commandQueue = xQueueCreate(5, sizeof(Command));
 
   // Create Tasks
-  xTaskCreate(HeartTask, "Heart", 2048, NULL, 1, &t_Blink);
+  // Heart above Input/Display: it is almost always blocked, and rate
+  // changes and LED edges must not wait behind an OLED transfer
+  xTaskCreate(HeartTask, "Heart", 2048, NULL, 3, &t_Blink);
   xTaskCreate(InputTask, "Input", 4096, NULL, 2, &t_Input);
   xTaskCreate(DisplayTask, "Display", 4096, NULL, 2, &t_Display);
 }
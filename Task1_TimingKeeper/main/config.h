@@ -4,15 +4,30 @@
 
 #define WIFI_SSID "A"
 #define WIFI_PASS "12345678"
+#define WIFI_STATIC_IP 1 // reuse the last DHCP lease on reboot
 
+#define MQTT_BROKER_URI "mqtt://broker.mqttdashboard.com:1883"
 #define MQTT_TOPIC "shrimphub/led/timing/set"
 
+// Binary snapshots from reef_trace (REEF_TRACE builds only)
+#define METRICS_TOPIC "shouryadippizzachor/metrics/timing_keeper"
+#define METRICS_PERIOD_MS 1000
+
 #define RED_PIN 21
 #define GREEN_PIN 19
 #define BLUE_PIN 18
 
 #define MAX_PATTERN_LEN 16
 
+// Stack depth per LED task (bytes on the ESP32); the reef_mem report shows
+// the high-water mark
+#define LED_TASK_STACK 2048
+
+// Placement per reef_profile (idf.py -DREEF_PROFILE=...): the LED tasks are
+// the timing-critical path; priority is raised under pinned_rt
+#define LED_TASK_CORE REEF_CORE_CRITICAL
+#define LED_TASK_PRIORITY REEF_PRIO(5, 20)
+
 #define LED_ACTIVE_HIGH 0 // Common Anode
 
 #if LED_ACTIVE_HIGH
@@ -5,26 +5,23 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
-#include "freertos/event_groups.h"
 
-#include "esp_wifi.h"
-#include "esp_event.h"
-#include "esp_netif.h"
-#include "nvs_flash.h"
 #include "mqtt_client.h"
 #include "esp_log.h"
 
 #include "driver/gpio.h"
 #include "cJSON.h"
+#include "reef_net.h"
+#include "reef_log.h"
+#include "reef_mem.h"
+#include "reef_trace.h"
+#include "reef_bench.h"
+#include "reef_state.h"
 
 #include "config.h"
 
 static const char *TAG = "TIMING_KEEPER";
 
-// WiFi sync ---------------------------------------------------------------- //
-#define WIFI_CONNECTED_BIT BIT0
-static EventGroupHandle_t wifi_event_group;
-
 // LED pattern -------------------------------------------------------------- //
 typedef struct
 {
@@ -32,66 +29,24 @@ typedef struct
     uint8_t length;
 } led_pattern_t;
 
-static led_pattern_t red_pattern = {.length = 0};
-static led_pattern_t green_pattern = {.length = 0};
-static led_pattern_t blue_pattern = {.length = 0};
-
-static SemaphoreHandle_t pattern_mutex;
-
-// MQTT --------------------------------------------------------------------- //
-static esp_mqtt_client_handle_t mqtt_client;
-
-// WIFI --------------------------------------------------------------------- //
-static void wifi_event_handler(void *arg,
-                               esp_event_base_t event_base,
-                               int32_t event_id,
-                               void *event_data)
-{
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
-    {
-        esp_wifi_connect();
-    }
-
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
-    {
-        ESP_LOGI(TAG, "WiFi disconnected, retrying...");
-        esp_wifi_connect();
-    }
-
-    if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
-    {
-        ESP_LOGI(TAG, "WiFi got IP");
-        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
-    }
-}
-
-static void wifi_init(void)
+typedef struct
 {
-    wifi_event_group = xEventGroupCreate();
+    led_pattern_t red;
+    led_pattern_t green;
+    led_pattern_t blue;
+} led_patterns_t;
 
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+static led_patterns_t patterns;
 
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-    ESP_ERROR_CHECK(esp_event_handler_register(
-        WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_register(
-        IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
+static SemaphoreHandle_t pattern_mutex;
+REEF_MUTEX_STORAGE(pattern);
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASS,
-        },
-    };
+// Active patterns survive resets; restored before Wi-Fi, so the LEDs pick
+// up where they were without waiting for a new message
+REEF_STATE_DEFINE(patterns_state, "patterns", 1, led_patterns_t);
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-}
+// MQTT --------------------------------------------------------------------- //
+static esp_mqtt_client_handle_t mqtt_client;
 
 // MQTT --------------------------------------------------------------------- //
 static void parse_pattern(cJSON *array, led_pattern_t *pattern)
@@ -116,14 +71,18 @@ static void mqtt_event_handler(void *handler_args,
 {
     esp_mqtt_event_handle_t event = event_data;
 
-    if (event->event_id == MQTT_EVENT_DATA)
+    // (Re)subscribe on every connect, the session is not persistent
+    if (event->event_id == MQTT_EVENT_CONNECTED)
     {
-        char *payload = strndup(event->data, event->data_len);
-        ESP_LOGI(TAG, "MQTT DATA: %s", payload);
+        esp_mqtt_client_subscribe(mqtt_client, MQTT_TOPIC, 0);
+    }
 
-        cJSON *root = cJSON_Parse(payload);
-        free(payload);
+    if (event->event_id == MQTT_EVENT_DATA)
+    {
+        REEF_LOGI(TAG, "MQTT DATA: %.*s", REEF_LOG_BYTES(event->data, event->data_len));
 
+        // Parses in place: no NUL-terminated copy of the payload
+        cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
         if (!root)
         {
             return;
@@ -137,52 +96,47 @@ static void mqtt_event_handler(void *handler_args,
 
         if (r)
         {
-            parse_pattern(r, &red_pattern);
+            parse_pattern(r, &patterns.red);
         }
         if (g)
         {
-            parse_pattern(g, &green_pattern);
+            parse_pattern(g, &patterns.green);
         }
         if (b)
         {
-            parse_pattern(g, &blue_pattern);
+            parse_pattern(g, &patterns.blue);
         }
 
+        reef_state_put(&patterns_state, &patterns);
         xSemaphoreGive(pattern_mutex);
         cJSON_Delete(root);
     }
 }
 
-static void mqtt_init(void)
-{
-    esp_mqtt_client_config_t cfg = {
-        .broker.address.uri = "mqtt://broker.mqttdashboard.com:1883",
-    };
+// LED Task ----------------------------------------------------------------- //
+REEF_TASK_STORAGE(red_led, LED_TASK_STACK);
+REEF_TASK_STORAGE(green_led, LED_TASK_STACK);
+REEF_TASK_STORAGE(blue_led, LED_TASK_STACK);
 
-    mqtt_client = esp_mqtt_client_init(&cfg);
-    esp_mqtt_client_register_event(
-        mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-    esp_mqtt_client_start(mqtt_client);
-    esp_mqtt_client_subscribe(mqtt_client, MQTT_TOPIC, 0);
-}
+// How late each LED edge lands after the requested duration
+REEF_BENCH_DEFINE(led_wake, "led_wake");
 
-// LED Task ----------------------------------------------------------------- //
 static void led_task(void *arg)
 {
-    gpio_num_t pin = (gpio_num_t)arg;
+    gpio_num_t pin = (gpio_num_t)(intptr_t)arg;
     led_pattern_t *pattern;
 
     if (pin == RED_PIN)
     {
-        pattern = &red_pattern;
+        pattern = &patterns.red;
     }
     else if (pin == GREEN_PIN)
     {
-        pattern = &green_pattern;
+        pattern = &patterns.green;
     }
     else
     {
-        pattern = &blue_pattern;
+        pattern = &patterns.blue;
     }
 
     uint8_t idx = 0;
@@ -209,11 +163,18 @@ static void led_task(void *arg)
         uint32_t duration = pattern->durations[idx];
         xSemaphoreGive(pattern_mutex);
 
+        int64_t expected_us = (int64_t)pdTICKS_TO_MS(pdMS_TO_TICKS(duration)) * 1000;
+
+        int64_t edge_us = REEF_BENCH_NOW();
         LED_ON(pin);
+        reef_state_first_output("LED pattern");
         vTaskDelay(pdMS_TO_TICKS(duration));
+        REEF_BENCH_RECORD(led_wake, REEF_BENCH_NOW() - edge_us - expected_us);
 
+        edge_us = REEF_BENCH_NOW();
         LED_OFF(pin);
         vTaskDelay(pdMS_TO_TICKS(duration));
+        REEF_BENCH_RECORD(led_wake, REEF_BENCH_NOW() - edge_us - expected_us);
 
         idx = (idx + 1) % pattern->length;
     }
@@ -222,9 +183,14 @@ static void led_task(void *arg)
 // Main --------------------------------------------------------------------- //
 void app_main(void)
 {
-    ESP_ERROR_CHECK(nvs_flash_init());
+    reef_log_init();
+
+    // Before Wi-Fi: the LED tasks start on the restored patterns
+    reef_state_restore(&patterns_state, &patterns);
+    reef_state_start();
 
-    pattern_mutex = xSemaphoreCreateMutex();
+    pattern_mutex = REEF_MUTEX_CREATE(pattern);
+    reef_trace_queue(pattern_mutex, "pattern");
 
     gpio_config_t io_conf = {
         .mode = GPIO_MODE_OUTPUT,
@@ -235,19 +201,25 @@ void app_main(void)
     };
     gpio_config(&io_conf);
 
-    wifi_init();
-
-    xEventGroupWaitBits(
-        wifi_event_group,
-        WIFI_CONNECTED_BIT,
-        false,
-        true,
-        portMAX_DELAY);
-
-    ESP_LOGI(TAG, "WiFi connected, starting MQTT");
-    mqtt_init();
+    // Blinking restored patterns while Wi-Fi comes up
+    REEF_TASK_CREATE(red_led, led_task, "red_led", (void *)RED_PIN,
+                     LED_TASK_PRIORITY, LED_TASK_CORE);
+    REEF_TASK_CREATE(green_led, led_task, "green_led", (void *)GREEN_PIN,
+                     LED_TASK_PRIORITY, LED_TASK_CORE);
+    REEF_TASK_CREATE(blue_led, led_task, "blue_led", (void *)BLUE_PIN,
+                     LED_TASK_PRIORITY, LED_TASK_CORE);
+
+    // MQTT connects and subscribes on its own once Wi-Fi is up
+    reef_net_config_t net = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+        .static_ip = WIFI_STATIC_IP,
+        .broker_uri = MQTT_BROKER_URI,
+        .mqtt_handler = mqtt_event_handler,
+    };
+    ESP_ERROR_CHECK(reef_net_start(&net, &mqtt_client));
+    reef_trace_start(mqtt_client, METRICS_TOPIC, METRICS_PERIOD_MS);
 
-    xTaskCreate(led_task, "red_led", 2048, (void *)RED_PIN, 5, NULL);
-    xTaskCreate(led_task, "green_led", 2048, (void *)GREEN_PIN, 5, NULL);
-    xTaskCreate(led_task, "blue_led", 2048, (void *)BLUE_PIN, 5, NULL);
+    reef_mem_report_start();
+    reef_bench_start();
 }
@@ -4,6 +4,7 @@
 
 #define WIFI_SSID "Redmi Note 12 5G"
 #define WIFI_PASS "12345678"
+#define WIFI_STATIC_IP 1 // reuse the last DHCP lease on reboot
 
 #define MQTT_BROKER_URI "mqtt://broker.mqttdashboard.com:1883"
 
@@ -11,13 +12,60 @@
 #define DISTRESS_TOPIC "shouryadippizzachor"
 #define ACK_TOPIC "shouryadipchakrabortypizzachor"
 
+// Binary snapshots from reef_trace (REEF_TRACE builds only)
+#define METRICS_TOPIC "shouryadippizzachor/metrics/priority_guardian"
+#define METRICS_PERIOD_MS 1000
+
 #define LED_GPIO 21
 
 #define ROLLING_WINDOW 10
 
-#define PRIORITY_STREAM 1
-#define PRIORITY_MQTT 2
-#define PRIORITY_DISTRESS 3
+// Stream subscription QoS; distress is always QoS 1. At QoS 0 the broker
+// sends each sample once with no PUBACK, and lost samples show up as gaps
+// in the sequence numbers. 1 is the old mode; the host simulation takes
+// it from cmake -DTASK2_STREAM_QOS=.
+#ifndef STREAM_QOS
+#define STREAM_QOS 0
+#endif
+
+// Stream payloads are a bare number, or a JSON object with these keys. With
+// a sequence number, losses, reordering and duplicates are counted and the
+// rolling window covers the last ROLLING_WINDOW sequence numbers, so a gap
+// leaves holes instead of stretching the window. With only a timestamp,
+// reordering is counted.
+#define STREAM_VALUE_KEY "value"
+#define STREAM_SEQ_KEY "seq"
+#define STREAM_TS_KEY "timestamp_ms"
+
+// A jump of more than this many sequence numbers forward, or back past the
+// rolling window, is taken as a restarted publisher and starts the window
+// over
+#define STREAM_SEQ_RESYNC 1000
+
+// Stream counters (rate, lost, reordered, ...) are logged this often
+#define STREAM_STATS_PERIOD_MS 5000
+
+// Priorities and cores per reef_profile (idf.py -DREEF_PROFILE=...):
+// dispatch and distress are the ACK path and go to the critical core, the
+// stream average stays with the background work. pinned_rt raises the
+// critical pair above the IDF MQTT client task (5).
+#define PRIORITY_STREAM REEF_PRIO(1, 1)
+#define PRIORITY_MQTT REEF_PRIO(2, 19)
+#define PRIORITY_DISTRESS REEF_PRIO(3, 20)
+
+#define CORE_STREAM REEF_CORE_BACKGROUND
+#define CORE_MQTT REEF_CORE_CRITICAL
+#define CORE_DISTRESS REEF_CORE_CRITICAL
+
+// Queue lengths and stack depths (bytes on the ESP32), static with
+// REEF_STATIC_ALLOC; the reef_mem report shows stack high-water marks
+#define DISPATCH_QUEUE_LEN 10
+#define STREAM_QUEUE_LEN 10
+#define DISTRESS_QUEUE_LEN 5
+
+#define DISPATCH_TASK_STACK 4096
+#define STREAM_TASK_STACK 4096
+#define DISTRESS_TASK_STACK 4096
 
 #define LED_ACTIVE_HIGH 0 // Common Anode
 
@@ -1,30 +1,29 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
-#include "freertos/event_groups.h"
 
-#include "esp_wifi.h"
-#include "esp_event.h"
-#include "esp_netif.h"
-#include "nvs_flash.h"
 #include "mqtt_client.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 
 #include "driver/gpio.h"
+#include "reef_net.h"
+#include "reef_log.h"
+#include "reef_mem.h"
+#include "reef_trace.h"
+#include "reef_bench.h"
+#include "reef_state.h"
 
 #include "config.h"
 
 static const char *TAG = "PRIORITY_GUARDIAN";
 
-/* ================= WIFI ================= */
-#define WIFI_CONNECTED_BIT BIT0
-static EventGroupHandle_t wifi_event_group;
-
 /* ================= MQTT ================= */
 static esp_mqtt_client_handle_t mqtt_client;
 
@@ -38,67 +37,83 @@ typedef enum
 {
     MQTT_MSG_STREAM,
     MQTT_MSG_DISTRESS,
-    MQTT_MSG_OTHER
+    MQTT_MSG_OTHER,
+    MQTT_MSG_TYPES
 } mqtt_msg_type_t;
 
 typedef struct
 {
     mqtt_msg_type_t type;
-    char data[64];
+    int64_t rx_us; // handler entry, REEF_BENCH builds only
+    char data[96];
 } mqtt_dispatch_msg_t;
 
 typedef struct
 {
-    int64_t rx_time_ms;
-} distress_msg_t;
+    float value;
+    uint32_t seq;
+    int64_t ts_ms;
+    bool has_seq;
+    bool has_ts;
+} stream_sample_t;
 
-/* ================= WIFI HANDLER ================= */
-static void wifi_event_handler(void *arg,
-                               esp_event_base_t event_base,
-                               int32_t event_id,
-                               void *event_data)
+typedef struct
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
-        esp_wifi_connect();
-
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
-        esp_wifi_connect();
-
-    if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
-        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
-}
+    float value;
+    uint32_t seq;
+    bool valid;
+    bool missing; // skipped by a gap and counted in `lost`
+} stream_slot_t;
 
-static void wifi_init(void)
+typedef struct
+{
+    uint32_t received;
+    uint32_t lost;      // sequence numbers skipped and not seen since
+    uint32_t reordered; // arrived after a later sample
+    uint32_t duplicates;
+    uint32_t resyncs;   // window started over (publisher restart)
+} stream_stats_t;
+
+// Rolling window and counters, kept across resets by reef_state
+typedef struct
 {
-    wifi_event_group = xEventGroupCreate();
+    stream_slot_t window[ROLLING_WINDOW];
+    stream_stats_t stats;
+    uint32_t head;  // newest sequence number
+    uint32_t first; // first sequence number since (re)sync
+    int64_t last_ts;
+    int32_t msg_num;
+    bool started;
+} stream_state_t;
 
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+static stream_state_t stream_state = {.last_ts = INT64_MIN};
 
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+typedef struct
+{
+    int64_t rx_time_ms;
+    int64_t rx_us;
+} distress_msg_t;
 
-    ESP_ERROR_CHECK(esp_event_handler_register(
-        WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_register(
-        IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
+/* ================= STORAGE ================= */
+REEF_QUEUE_STORAGE(dispatch, DISPATCH_QUEUE_LEN, sizeof(mqtt_dispatch_msg_t));
+REEF_QUEUE_STORAGE(stream, STREAM_QUEUE_LEN, sizeof(stream_sample_t));
+REEF_QUEUE_STORAGE(distress, DISTRESS_QUEUE_LEN, sizeof(distress_msg_t));
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASS,
-        },
-    };
+REEF_TASK_STORAGE(dispatch, DISPATCH_TASK_STACK);
+REEF_TASK_STORAGE(stream, STREAM_TASK_STACK);
+REEF_TASK_STORAGE(distress, DISTRESS_TASK_STACK);
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
+REEF_STATE_DEFINE(stream_snapshot, "stream", 2, stream_state_t);
 
-    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
-}
+/* ================= BENCH ================= */
+REEF_BENCH_DEFINE(bench_dispatch, "handler_to_dispatch");
+REEF_BENCH_DEFINE(bench_ack, "handler_to_ack");
 
 /* ================= MQTT EVENT (MINIMAL) ================= */
+// Messages the handler could not queue for dispatch, per type. Dropped
+// here, stream samples also show up as gaps in `lost`.
+static volatile uint32_t dispatch_dropped[MQTT_MSG_TYPES];
+
 static void mqtt_event_handler(void *handler_args,
                                esp_event_base_t base,
                                int32_t event_id,
@@ -109,7 +124,7 @@ static void mqtt_event_handler(void *handler_args,
     if (event->event_id == MQTT_EVENT_CONNECTED)
     {
         ESP_LOGI(TAG, "MQTT connected");
-        esp_mqtt_client_subscribe(mqtt_client, STREAM_TOPIC, 1);
+        esp_mqtt_client_subscribe(mqtt_client, STREAM_TOPIC, STREAM_QOS);
         esp_mqtt_client_subscribe(mqtt_client, DISTRESS_TOPIC, 1);
         return;
     }
@@ -123,6 +138,7 @@ static void mqtt_event_handler(void *handler_args,
         return;
 
     mqtt_dispatch_msg_t msg = {0};
+    msg.rx_us = REEF_BENCH_NOW();
 
     if (event->topic_len == strlen(STREAM_TOPIC) &&
         strncmp(event->topic, STREAM_TOPIC, event->topic_len) == 0)
@@ -131,7 +147,7 @@ static void mqtt_event_handler(void *handler_args,
     }
     else if (event->topic_len == strlen(DISTRESS_TOPIC) &&
              strncmp(event->topic, DISTRESS_TOPIC, event->topic_len) == 0 &&
-             strstr(event->data, "CHALLENGE"))
+             memmem(event->data, event->data_len, "CHALLENGE", 9))
     {
         msg.type = MQTT_MSG_DISTRESS;
     }
@@ -140,24 +156,70 @@ static void mqtt_event_handler(void *handler_args,
         msg.type = MQTT_MSG_OTHER;
     }
 
-    strncpy(msg.data, event->data, sizeof(msg.data) - 1);
-    xQueueSend(mqtt_dispatch_queue, &msg, 0);
+    // event->data is not NUL-terminated
+    int len = event->data_len < (int)sizeof(msg.data) - 1 ? event->data_len
+                                                           : (int)sizeof(msg.data) - 1;
+    memcpy(msg.data, event->data, len);
+    if (xQueueSend(mqtt_dispatch_queue, &msg, 0) != pdTRUE)
+    {
+        dispatch_dropped[msg.type]++;
+    }
 }
 
-/* ================= MQTT INIT ================= */
-static void mqtt_init(void)
+/* ================= STREAM PARSING ================= */
+// Stream samples the dispatcher could not queue
+static volatile uint32_t stream_dropped = 0;
+
+// Number after "key": in a flat JSON object
+static bool json_number(const char *json, const char *key, double *out)
 {
-    esp_mqtt_client_config_t cfg = {
-        .broker.address.uri = MQTT_BROKER_URI,
-        .session.keepalive = 15,
-        .network.disable_auto_reconnect = false,
-    };
+    char quoted[32];
+    snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+
+    const char *p = strstr(json, quoted);
+    if (!p)
+        return false;
+
+    p += strlen(quoted);
+    while (*p == ' ')
+        p++;
+    if (*p++ != ':')
+        return false;
+
+    char *end;
+    *out = strtod(p, &end);
+    return end != p;
+}
+
+static bool parse_stream_sample(const char *data, stream_sample_t *sample)
+{
+    memset(sample, 0, sizeof(*sample));
+
+    while (*data == ' ')
+        data++;
+
+    if (*data != '{')
+    {
+        sample->value = atof(data);
+        return true;
+    }
 
-    mqtt_client = esp_mqtt_client_init(&cfg);
-    esp_mqtt_client_register_event(
-        mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    double v;
+    if (!json_number(data, STREAM_VALUE_KEY, &v))
+        return false;
+    sample->value = v;
 
-    esp_mqtt_client_start(mqtt_client);
+    if (json_number(data, STREAM_SEQ_KEY, &v))
+    {
+        sample->seq = (uint32_t)v;
+        sample->has_seq = true;
+    }
+    if (json_number(data, STREAM_TS_KEY, &v))
+    {
+        sample->ts_ms = (int64_t)v;
+        sample->has_ts = true;
+    }
+    return true;
 }
 
 /* ================= PRIORITY 2: MQTT DISPATCHER ================= */
@@ -169,51 +231,187 @@ static void mqtt_dispatch_task(void *arg)
     {
         if (xQueueReceive(mqtt_dispatch_queue, &msg, portMAX_DELAY))
         {
+            REEF_BENCH_RECORD(bench_dispatch, REEF_BENCH_NOW() - msg.rx_us);
+
             if (msg.type == MQTT_MSG_STREAM)
             {
-                float value = atof(msg.data);
-                xQueueSend(stream_queue, &value, 0);
+                stream_sample_t sample;
+                if (!parse_stream_sample(msg.data, &sample))
+                {
+                    REEF_LOGW(TAG, "STREAM unparsed: %s", msg.data);
+                }
+                else if (xQueueSend(stream_queue, &sample, 0) != pdTRUE)
+                {
+                    stream_dropped++;
+                }
             }
             else if (msg.type == MQTT_MSG_DISTRESS)
             {
                 distress_msg_t d;
                 d.rx_time_ms = esp_timer_get_time() / 1000;
+                d.rx_us = msg.rx_us;
                 xQueueSend(distress_queue, &d, portMAX_DELAY);
             }
             else
             {
-                ESP_LOGW(TAG, "NEXT CHALLENGE / OTHER MSG: %s", msg.data);
+                REEF_LOGW(TAG, "NEXT CHALLENGE / OTHER MSG: %s", msg.data);
             }
         }
     }
 }
 
 /* ================= PRIORITY 1: STREAM TASK ================= */
+static void log_stream_stats(const stream_stats_t *stats, uint32_t period_rx)
+{
+    ESP_LOGI(TAG, "STREAM qos=%d rx=%lu (%.1f/s) lost=%lu reordered=%lu "
+                  "dup=%lu resync=%lu dropped=%lu dispatch_stream=%lu "
+                  "dispatch_distress=%lu dispatch_other=%lu",
+             STREAM_QOS, (unsigned long)stats->received,
+             period_rx * 1000.0 / STREAM_STATS_PERIOD_MS,
+             (unsigned long)stats->lost, (unsigned long)stats->reordered,
+             (unsigned long)stats->duplicates, (unsigned long)stats->resyncs,
+             (unsigned long)stream_dropped,
+             (unsigned long)dispatch_dropped[MQTT_MSG_STREAM],
+             (unsigned long)dispatch_dropped[MQTT_MSG_DISTRESS],
+             (unsigned long)dispatch_dropped[MQTT_MSG_OTHER]);
+}
+
+// Slots are indexed by sequence number; samples without one are numbered
+// in arrival order
 static void stream_task(void *arg)
 {
-    float window[ROLLING_WINDOW] = {0};
-    int count = 0, index = 0, msg_num = 0;
-    float value;
+    stream_state_t *st = &stream_state;
+    uint32_t period_rx = 0;
+    int64_t next_stats_ms = esp_timer_get_time() / 1000 + STREAM_STATS_PERIOD_MS;
+    stream_sample_t sample;
 
     while (1)
     {
-        if (xQueueReceive(stream_queue, &value, portMAX_DELAY))
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        if (now_ms >= next_stats_ms)
         {
-            msg_num++;
+            log_stream_stats(&st->stats, period_rx);
+            period_rx = 0;
+            next_stats_ms = now_ms + STREAM_STATS_PERIOD_MS;
+        }
+
+        if (!xQueueReceive(stream_queue, &sample,
+                           pdMS_TO_TICKS(next_stats_ms - now_ms)))
+            continue;
+
+        st->msg_num++;
+        period_rx++;
+        st->stats.received++;
 
-            window[index] = value;
-            index = (index + 1) % ROLLING_WINDOW;
-            if (count < ROLLING_WINDOW)
+        if (sample.has_ts && !sample.has_seq)
+        {
+            if (sample.ts_ms < st->last_ts)
+                st->stats.reordered++;
+            else
+                st->last_ts = sample.ts_ms;
+        }
+
+        uint32_t seq = sample.has_seq ? sample.seq : st->head + 1;
+        int32_t ahead = (int32_t)(seq - st->head);
+        bool store = true;
+
+        // Older than the window: nothing to slot it into, so most likely
+        // the publisher restarted its numbering
+        if (!st->started || ahead > STREAM_SEQ_RESYNC || ahead <= -ROLLING_WINDOW)
+        {
+            if (st->started)
+            {
+                st->stats.resyncs++;
+                REEF_LOGW(TAG, "STREAM resync: seq %lu -> %lu",
+                          (unsigned long)st->head, (unsigned long)seq);
+            }
+            memset(st->window, 0, sizeof(st->window));
+            st->head = st->first = seq;
+            st->started = true;
+        }
+        else if (ahead > 0)
+        {
+            if (ahead > 1)
+            {
+                st->stats.lost += ahead - 1;
+                REEF_LOGW(TAG, "STREAM gap after seq %lu: %ld lost",
+                          (unsigned long)st->head, (long)(ahead - 1));
+
+                // Mark the skipped numbers still inside the window, so a
+                // late arrival can be told from one never counted as lost
+                uint32_t from = ahead > ROLLING_WINDOW ? seq - ROLLING_WINDOW + 1
+                                                       : st->head + 1;
+                for (uint32_t s = from; s != seq; s++)
+                {
+                    st->window[s % ROLLING_WINDOW] = (stream_slot_t){
+                        .seq = s,
+                        .missing = true,
+                    };
+                }
+            }
+            st->head = seq;
+        }
+        else
+        {
+            stream_slot_t *slot = &st->window[seq % ROLLING_WINDOW];
+            if (slot->valid && slot->seq == seq)
+            {
+                st->stats.duplicates++;
+                store = false;
+            }
+            else
+            {
+                st->stats.reordered++;
+
+                // Counted as lost when the gap opened
+                if (slot->missing && slot->seq == seq)
+                    st->stats.lost--;
+            }
+        }
+
+        if (store)
+        {
+            st->window[seq % ROLLING_WINDOW] = (stream_slot_t){
+                .value = sample.value,
+                .seq = seq,
+                .valid = true,
+            };
+        }
+
+        // Also when only the counters changed, so none of them go back
+        // after a reset
+        reef_state_put(&stream_snapshot, st);
+
+        if (!store)
+            continue;
+
+        // Average over what arrived of the last ROLLING_WINDOW numbers
+        float sum = 0;
+        int count = 0;
+        for (int i = 0; i < ROLLING_WINDOW; i++)
+        {
+            if (st->window[i].valid && st->head - st->window[i].seq < ROLLING_WINDOW)
+            {
+                sum += st->window[i].value;
                 count++;
+            }
+        }
 
-            float sum = 0;
-            for (int i = 0; i < count; i++)
-                sum += window[i];
+        float avg = sum / count;
+        uint32_t span = st->head - st->first + 1 < ROLLING_WINDOW ? st->head - st->first + 1
+                                                                  : ROLLING_WINDOW;
 
-            float avg = sum / count;
+        reef_state_first_output("first average");
 
-            printf("Message %d: %.2f  -> Average: %.2f\n",
-                   msg_num, value, avg);
+        if (count < (int)span)
+        {
+            REEF_LOGI(TAG, "Message %ld: %.2f  -> Average: %.2f  (%d of last %lu)",
+                      (long)st->msg_num, sample.value, avg, count, (unsigned long)span);
+        }
+        else
+        {
+            REEF_LOGI(TAG, "Message %ld: %.2f  -> Average: %.2f",
+                      (long)st->msg_num, sample.value, avg);
         }
     }
 }
@@ -234,7 +432,7 @@ static void distress_task(void *arg)
             char payload[128];
             snprintf(payload, sizeof(payload),
                      "{\"status\":\"ACK\",\"timestamp_ms\":%lld}",
-                     ack_time_ms);
+                     (long long)ack_time_ms);
 
             esp_mqtt_client_publish(
                 mqtt_client,
@@ -243,11 +441,12 @@ static void distress_task(void *arg)
                 0,
                 1,
                 0);
+            REEF_BENCH_RECORD(bench_ack, REEF_BENCH_NOW() - msg.rx_us);
 
-            ESP_LOGI(TAG,
-                     "DISTRESS RX=%lld ms | ACK SENT=%lld ms",
-                     msg.rx_time_ms,
-                     ack_time_ms);
+            REEF_LOGI(TAG,
+                      "DISTRESS RX=%lld ms | ACK SENT=%lld ms",
+                      (long long)msg.rx_time_ms,
+                      (long long)ack_time_ms);
 
             LED_OFF(LED_GPIO);
         }
@@ -257,34 +456,45 @@ static void distress_task(void *arg)
 /* ================= MAIN ================= */
 void app_main(void)
 {
-    ESP_ERROR_CHECK(nvs_flash_init());
+    reef_log_init();
+
+    // Before Wi-Fi: the stream window and counters continue where they were
+    reef_state_restore(&stream_snapshot, &stream_state);
+    reef_state_start();
 
     gpio_reset_pin(LED_GPIO);
     gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
     LED_OFF(LED_GPIO);
 
-    mqtt_dispatch_queue = xQueueCreate(10, sizeof(mqtt_dispatch_msg_t));
-    stream_queue = xQueueCreate(10, sizeof(float));
-    distress_queue = xQueueCreate(5, sizeof(distress_msg_t));
-
-    wifi_init();
-
-    xEventGroupWaitBits(
-        wifi_event_group,
-        WIFI_CONNECTED_BIT,
-        false,
-        true,
-        portMAX_DELAY);
+    mqtt_dispatch_queue = REEF_QUEUE_CREATE(dispatch);
+    stream_queue = REEF_QUEUE_CREATE(stream);
+    distress_queue = REEF_QUEUE_CREATE(distress);
+
+    reef_trace_queue(mqtt_dispatch_queue, "dispatch");
+    reef_trace_queue(stream_queue, "stream");
+    reef_trace_queue(distress_queue, "distress");
+
+    reef_net_config_t net = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+        .wifi_ps_none = true,
+        .static_ip = WIFI_STATIC_IP,
+        .broker_uri = MQTT_BROKER_URI,
+        .keepalive_s = 15,
+        .mqtt_handler = mqtt_event_handler,
+    };
+    ESP_ERROR_CHECK(reef_net_start(&net, &mqtt_client));
+    reef_trace_start(mqtt_client, METRICS_TOPIC, METRICS_PERIOD_MS);
 
-    ESP_LOGI(TAG, "WiFi connected, starting MQTT");
-    mqtt_init();
+    REEF_TASK_CREATE(dispatch, mqtt_dispatch_task, "mqtt_dispatch",
+                     NULL, PRIORITY_MQTT, CORE_MQTT);
 
-    xTaskCreate(mqtt_dispatch_task, "mqtt_dispatch",
-                4096, NULL, PRIORITY_MQTT, NULL);
+    REEF_TASK_CREATE(stream, stream_task, "stream_task",
+                     NULL, PRIORITY_STREAM, CORE_STREAM);
 
-    xTaskCreate(stream_task, "stream_task",
-                4096, NULL, PRIORITY_STREAM, NULL);
+    REEF_TASK_CREATE(distress, distress_task, "distress_task",
+                     NULL, PRIORITY_DISTRESS, CORE_DISTRESS);
 
-    xTaskCreate(distress_task, "distress_task",
-                4096, NULL, PRIORITY_DISTRESS, NULL);
+    reef_mem_report_start();
+    reef_bench_start();
 }
@@ -4,12 +4,17 @@
 
 #define WIFI_SSID "Redmi Note 12 5G"
 #define WIFI_PASS "12345678"
+#define WIFI_STATIC_IP 1 // reuse the last DHCP lease on reboot
 
 #define MQTT_BROKER_URI "mqtt://broker.mqttdashboard.com:1883"
 
 #define WINDOW_TOPIC "mnjki_window"
 #define SYNC_PUB_TOPIC "cagedmonkey/listener"
 
+// Binary snapshots from reef_trace (REEF_TRACE builds only)
+#define METRICS_TOPIC "shouryadippizzachor/metrics/window_sync"
+#define METRICS_PERIOD_MS 1000
+
 #define BUTTON_GPIO 15
 
 #define LED_RED 21
@@ -20,9 +25,23 @@
 #define WINDOW_MAX_MS 1100
 #define DEBOUNCE_MS 20
 
+// Priorities and cores per reef_profile (idf.py -DREEF_PROFILE=...): the
+// window and button tasks drive the LEDs and go to the critical core;
+// pinned_rt raises them above the IDF MQTT client task (5)
 #define PRIORITY_MQTT 2
-#define PRIORITY_BUTTON 3
-#define PRIORITY_WINDOW 4
+#define PRIORITY_BUTTON REEF_PRIO(3, 19)
+#define PRIORITY_WINDOW REEF_PRIO(4, 20)
+
+#define CORE_BUTTON REEF_CORE_CRITICAL
+#define CORE_WINDOW REEF_CORE_CRITICAL
+
+// Queue lengths and stack depths (bytes on the ESP32), static with
+// REEF_STATIC_ALLOC; the reef_mem report shows stack high-water marks
+#define WINDOW_QUEUE_LEN 5
+#define BUTTON_QUEUE_LEN 5
+
+#define WINDOW_TASK_STACK 4096
+#define BUTTON_TASK_STACK 4096
 
 #define LED_ACTIVE_HIGH 0 // Common Anode
 
@@ -5,26 +5,22 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
-#include "freertos/event_groups.h"
 
-#include "esp_wifi.h"
-#include "esp_event.h"
-#include "esp_netif.h"
-#include "nvs_flash.h"
 #include "mqtt_client.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 
 #include "driver/gpio.h"
+#include "reef_net.h"
+#include "reef_log.h"
+#include "reef_mem.h"
+#include "reef_trace.h"
+#include "reef_bench.h"
 #include "config.h"
 
 static const char *TAG = "WINDOW_SYNC";
 static int64_t window_close_time = 0;
 
-/* ================= WIFI ================= */
-#define WIFI_CONNECTED_BIT BIT0
-static EventGroupHandle_t wifi_event_group;
-
 /* ================= MQTT ================= */
 static esp_mqtt_client_handle_t mqtt_client;
 
@@ -39,53 +35,26 @@ static int64_t window_open_time = 0;
 /* ================= STRUCTS ================= */
 typedef struct
 {
-    int64_t timestamp_ms;
-} button_event_t;
-
-/* ================= WIFI ================= */
-static void wifi_event_handler(void *arg,
-                               esp_event_base_t base,
-                               int32_t id,
-                               void *data)
-{
-    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START)
-        esp_wifi_connect();
+    int64_t open_ms;
+    int64_t rx_us; // handler entry, REEF_BENCH builds only
+} window_event_t;
 
-    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED)
-        esp_wifi_connect();
-
-    if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP)
-        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
-}
-
-static void wifi_init(void)
+typedef struct
 {
-    wifi_event_group = xEventGroupCreate();
-
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
-
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    int64_t timestamp_ms;
+    int64_t isr_us; // REEF_BENCH builds only
+} button_event_t;
 
-    ESP_ERROR_CHECK(esp_event_handler_register(
-        WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_register(
-        IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
+/* ================= STORAGE ================= */
+REEF_QUEUE_STORAGE(window, WINDOW_QUEUE_LEN, sizeof(window_event_t));
+REEF_QUEUE_STORAGE(button, BUTTON_QUEUE_LEN, sizeof(button_event_t));
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASS,
-        },
-    };
+REEF_TASK_STORAGE(window, WINDOW_TASK_STACK);
+REEF_TASK_STORAGE(button, BUTTON_TASK_STACK);
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE)); // IMPORTANT
-}
+/* ================= BENCH ================= */
+REEF_BENCH_DEFINE(bench_window, "handler_to_window_led");
+REEF_BENCH_DEFINE(bench_button, "isr_to_button_led");
 
 /* ================= MQTT ================= */
 static void mqtt_event_handler(void *arg,
@@ -94,6 +63,10 @@ static void mqtt_event_handler(void *arg,
                                void *data)
 {
     esp_mqtt_event_handle_t event = data;
+    int64_t rx_us = REEF_BENCH_NOW();
+
+    if (event_id == MQTT_EVENT_CONNECTED)
+        esp_mqtt_client_subscribe(mqtt_client, WINDOW_TOPIC, 1);
 
     if (event_id != MQTT_EVENT_DATA)
         return;
@@ -106,33 +79,21 @@ static void mqtt_event_handler(void *arg,
     memcpy(payload, event->data, event->data_len);
     payload[event->data_len] = '\0';
 
-    ESP_LOGI(TAG, "MQTT RX | topic='%s' payload='%s'", topic, payload);
+    REEF_LOGI(TAG, "MQTT RX | topic='%s' payload='%s'", topic, payload);
 
     if (strcmp(topic, WINDOW_TOPIC) == 0)
     {
         if (strstr(payload, "open"))
         {
-            int64_t now = esp_timer_get_time() / 1000;
-            xQueueSend(window_queue, &now, 0);
+            window_event_t evt = {
+                .open_ms = esp_timer_get_time() / 1000,
+                .rx_us = rx_us,
+            };
+            xQueueSend(window_queue, &evt, 0);
         }
     }
 }
 
-static void mqtt_init(void)
-{
-    esp_mqtt_client_config_t cfg = {
-        .broker.address.uri = MQTT_BROKER_URI,
-        .session.keepalive = 15,
-    };
-
-    mqtt_client = esp_mqtt_client_init(&cfg);
-    esp_mqtt_client_register_event(
-        mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-
-    esp_mqtt_client_start(mqtt_client);
-    esp_mqtt_client_subscribe(mqtt_client, WINDOW_TOPIC, 1);
-}
-
 /* ================= BUTTON ISR ================= */
 static void IRAM_ATTR button_isr(void *arg)
 {
@@ -144,26 +105,28 @@ static void IRAM_ATTR button_isr(void *arg)
 
     last_press = now;
 
-    button_event_t evt = {.timestamp_ms = now};
+    button_event_t evt = {.timestamp_ms = now, .isr_us = REEF_BENCH_NOW()};
     xQueueSendFromISR(button_queue, &evt, NULL);
 }
 
 /* ================= WINDOW TASK ================= */
 static void window_task(void *arg)
 {
-    int64_t open_time;
+    window_event_t evt;
 
     while (1)
     {
-        if (xQueueReceive(window_queue, &open_time, portMAX_DELAY))
+        if (xQueueReceive(window_queue, &evt, portMAX_DELAY))
         {
+            int64_t open_time = evt.open_ms;
             window_open = true;
             window_open_time = open_time;
 
             LED_ON(LED_BLUE);
             LED_OFF(LED_RED);
+            REEF_BENCH_RECORD(bench_window, REEF_BENCH_NOW() - evt.rx_us);
 
-            ESP_LOGI(TAG, "WINDOW OPEN @ %lld ms", open_time);
+            REEF_LOGI(TAG, "WINDOW OPEN @ %lld ms", (long long)open_time);
 
             vTaskDelay(pdMS_TO_TICKS(1100)); // max window
 
@@ -188,6 +151,7 @@ static void button_task(void *arg)
         if (xQueueReceive(button_queue, &evt, portMAX_DELAY))
         {
             LED_ON(LED_GREEN);
+            REEF_BENCH_RECORD(bench_button, REEF_BENCH_NOW() - evt.isr_us);
             vTaskDelay(pdMS_TO_TICKS(50));
             LED_OFF(LED_GREEN);
 
@@ -200,7 +164,7 @@ static void button_task(void *arg)
                     char payload[128];
                     snprintf(payload, sizeof(payload),
                              "{\"status\":\"synced\",\"timestamp_ms\":%lld}",
-                             evt.timestamp_ms);
+                             (long long)evt.timestamp_ms);
 
                     esp_mqtt_client_publish(
                         mqtt_client,
@@ -210,15 +174,15 @@ static void button_task(void *arg)
                         1,
                         0);
 
-                    ESP_LOGI(TAG,
-                             "SYNC SUCCESS | delta=%lld ms",
-                             delta);
+                    REEF_LOGI(TAG,
+                              "SYNC SUCCESS | delta=%lld ms",
+                              (long long)delta);
                 }
                 else
                 {
-                    ESP_LOGW(TAG,
-                             "MISS | delta=%lld ms",
-                             delta);
+                    REEF_LOGW(TAG,
+                              "MISS | delta=%lld ms",
+                              (long long)delta);
                 }
             }
         }
@@ -228,7 +192,7 @@ static void button_task(void *arg)
 /* ================= MAIN ================= */
 void app_main(void)
 {
-    ESP_ERROR_CHECK(nvs_flash_init());
+    reef_log_init();
 
     gpio_set_direction(LED_RED, GPIO_MODE_OUTPUT);
     gpio_set_direction(LED_GREEN, GPIO_MODE_OUTPUT);
@@ -249,24 +213,29 @@ void app_main(void)
     gpio_install_isr_service(0);
     gpio_isr_handler_add(BUTTON_GPIO, button_isr, NULL);
 
-    window_queue = xQueueCreate(5, sizeof(int64_t));
-    button_queue = xQueueCreate(5, sizeof(button_event_t));
-
-    wifi_init();
-
-    xEventGroupWaitBits(
-        wifi_event_group,
-        WIFI_CONNECTED_BIT,
-        false,
-        true,
-        portMAX_DELAY);
+    window_queue = REEF_QUEUE_CREATE(window);
+    button_queue = REEF_QUEUE_CREATE(button);
+    reef_trace_queue(window_queue, "window");
+    reef_trace_queue(button_queue, "button");
+
+    reef_net_config_t net = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+        .wifi_ps_none = true,
+        .static_ip = WIFI_STATIC_IP,
+        .broker_uri = MQTT_BROKER_URI,
+        .keepalive_s = 15,
+        .mqtt_handler = mqtt_event_handler,
+    };
+    ESP_ERROR_CHECK(reef_net_start(&net, &mqtt_client));
+    reef_trace_start(mqtt_client, METRICS_TOPIC, METRICS_PERIOD_MS);
 
-    ESP_LOGI(TAG, "WiFi connected, starting MQTT");
-    mqtt_init();
+    REEF_TASK_CREATE(window, window_task, "window_task", NULL,
+                     PRIORITY_WINDOW, CORE_WINDOW);
 
-    xTaskCreate(window_task, "window_task", 4096, NULL,
-                PRIORITY_WINDOW, NULL);
+    REEF_TASK_CREATE(button, button_task, "button_task", NULL,
+                     PRIORITY_BUTTON, CORE_BUTTON);
 
-    xTaskCreate(button_task, "button_task", 4096, NULL,
-                PRIORITY_BUTTON, NULL);
+    reef_mem_report_start();
+    reef_bench_start();
 }
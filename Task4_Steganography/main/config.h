@@ -3,6 +3,7 @@
 // ---------------- WiFi ----------------
 #define WIFI_SSID "Redmi Note 12 5G"
 #define WIFI_PASS "12345678"
+#define WIFI_STATIC_IP 1 // reuse the last DHCP lease on reboot
 
 // ---------------- MQTT ----------------
 #define MQTT_BROKER_URI "mqtt://broker.mqttdashboard.com:1883"
@@ -10,10 +11,39 @@
 #define TASK4_REQUEST_TOPIC "kelpsaute/steganography"
 #define TASK4_CHALLENGE_TOPIC "mnjki_window"
 
+// Binary snapshots from reef_trace (REEF_TRACE builds only)
+#define METRICS_TOPIC "shouryadippizzachor/metrics/steganography"
+#define METRICS_PERIOD_MS 1000
+
 // ---------------- Identity ----------------
 #define TEAM_ID "shouryadippizzachor"
 #define TASK3_HIDDEN_MESSAGE "REEFING KRILLS :( CORALS BLOOM <3"
 
 // ---------------- Image ----------------
 #define MAX_IMAGE_BASE64_SIZE (128 * 1024)
-#define MAX_IMAGE_BINARY_SIZE (96 * 1024)
+
+// The image is decoded in place, this many Base64 characters at a time
+// (multiple of 4; the block's output buffer is on the stack)
+#define BASE64_DECODE_BLOCK 512
+
+// ---------------- Transfer sessions ----------------
+// One slot per agent/request ID, so concurrent downloads and foreign
+// traffic on the shared topic never land in the same buffer.
+#define MAX_TRANSFER_SESSIONS 4
+#define TRANSFER_SESSION_KEY_LEN 48
+#define TRANSFER_IDLE_TIMEOUT_MS 5000
+#define TRANSFER_GROW_STEP (8 * 1024)
+
+// Heap budget shared by all sessions' Base64 buffers
+#define TRANSFER_MEMORY_BUDGET (192 * 1024)
+
+// REEF_STATIC_ALLOC builds: concurrent transfers with a buffer, each a
+// static MAX_IMAGE_BASE64_SIZE slot in DRAM. Sized from the same budget as
+// the heap, which with the defaults is a single slot: two 128 KB slots do
+// not fit in the ESP32's static DRAM. A static build then receives one
+// transfer at a time, and a second agent's session is aborted (and
+// logged) until the first one is decoded. Raise it where DRAM allows, e.g.
+// with a smaller MAX_IMAGE_BASE64_SIZE.
+#ifndef TRANSFER_ARENA_SLOTS
+#define TRANSFER_ARENA_SLOTS (TRANSFER_MEMORY_BUDGET / MAX_IMAGE_BASE64_SIZE)
+#endif
@@ -1,33 +1,295 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "esp_log.h"
 #include "esp_system.h"
-#include "nvs_flash.h"
+#include "esp_timer.h"
 
 #include "mqtt_client.h"
 #include "cJSON.h"
 #include "mbedtls/base64.h"
+#include "reef_net.h"
+#include "reef_log.h"
+#include "reef_mem.h"
+#include "reef_trace.h"
+#include "reef_state.h"
 
 #include "config.h"
 
 static const char *TAG = "TASK4";
 
-// --------- Image Buffers ---------
-static char *image_b64 = NULL;
-static size_t image_b64_len = 0;
-static uint8_t *image_bin = NULL;
-static size_t image_bin_len = 0;
+// --------- Transfer Sessions ---------
+typedef struct
+{
+    bool in_use;
+    char key[TRANSFER_SESSION_KEY_LEN];
+    char *b64;
+    size_t b64_len;
+    size_t b64_cap;
+    uint32_t chunks;
+    int64_t last_rx_ms;
+} transfer_session_t;
+
+// What reef_state keeps of each session across resets: only the progress.
+// Chunks carry no offset and the request cannot ask for the rest of an
+// image, so a transfer cut by a reset is reported and sent again in full
+// (the request goes out again on CONNECTED).
+typedef struct
+{
+    char key[TRANSFER_SESSION_KEY_LEN];
+    uint32_t b64_len;
+    uint32_t chunks;
+    bool in_use;
+} session_snapshot_t;
+
+typedef struct
+{
+    session_snapshot_t sessions[MAX_TRANSFER_SESSIONS];
+} transfer_state_t;
+
+REEF_STATE_DEFINE(transfer_snapshot, "transfers", 2, transfer_state_t);
+
+static transfer_session_t sessions[MAX_TRANSFER_SESSIONS];
+static SemaphoreHandle_t session_mutex;
+REEF_MUTEX_STORAGE(sessions);
+
+#if REEF_STATIC_ALLOC
+// Full-size buffers from a static arena, one per concurrent transfer
+#define TRANSFER_BUDGET (TRANSFER_ARENA_SLOTS * MAX_IMAGE_BASE64_SIZE)
+_Static_assert(TRANSFER_ARENA_SLOTS >= 1, "TRANSFER_ARENA_SLOTS must be at least 1");
+REEF_ARENA_STORAGE(transfer, TRANSFER_BUDGET);
+static bool arena_slot_used[TRANSFER_ARENA_SLOTS];
+#else
+#define TRANSFER_BUDGET TRANSFER_MEMORY_BUDGET
+#endif
+
+// Memory currently held by all sessions, checked against TRANSFER_BUDGET
+static size_t transfer_mem_used = 0;
+static size_t transfer_mem_peak = 0;
 
 // --------- MQTT Client ---------
 static esp_mqtt_client_handle_t mqtt_client;
 
 // ------------------------------------------------------------
 
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static bool mem_reserve(size_t bytes)
+{
+    if (transfer_mem_used + bytes > TRANSFER_BUDGET)
+    {
+        return false;
+    }
+
+    transfer_mem_used += bytes;
+    if (transfer_mem_used > transfer_mem_peak)
+    {
+        transfer_mem_peak = transfer_mem_used;
+    }
+    return true;
+}
+
+static void mem_release(size_t bytes)
+{
+    transfer_mem_used -= bytes;
+}
+
+// Caller holds session_mutex
+static transfer_session_t *session_find(const char *key)
+{
+    for (int i = 0; i < MAX_TRANSFER_SESSIONS; i++)
+    {
+        if (sessions[i].in_use && strcmp(sessions[i].key, key) == 0)
+        {
+            return &sessions[i];
+        }
+    }
+    return NULL;
+}
+
+// Caller holds session_mutex
+static transfer_session_t *session_open(const char *key)
+{
+    for (int i = 0; i < MAX_TRANSFER_SESSIONS; i++)
+    {
+        if (!sessions[i].in_use)
+        {
+            transfer_session_t *s = &sessions[i];
+            memset(s, 0, sizeof(*s));
+            s->in_use = true;
+            strlcpy(s->key, key, sizeof(s->key)); // fits, checked by the caller
+            s->last_rx_ms = now_ms();
+
+            ESP_LOGI(TAG, "Session [%s] opened (slot %d)", s->key, i);
+            return s;
+        }
+    }
+    return NULL;
+}
+
+#if REEF_STATIC_ALLOC
+
+// Caller holds session_mutex
+static bool buffer_grow(transfer_session_t *s, size_t need)
+{
+    // A slot already holds MAX_IMAGE_BASE64_SIZE, so only the first chunk
+    // gets here
+    for (int i = 0; i < TRANSFER_ARENA_SLOTS; i++)
+    {
+        if (!arena_slot_used[i] && mem_reserve(MAX_IMAGE_BASE64_SIZE))
+        {
+            arena_slot_used[i] = true;
+            s->b64 = (char *)REEF_ARENA(transfer) + i * MAX_IMAGE_BASE64_SIZE;
+            s->b64_cap = MAX_IMAGE_BASE64_SIZE;
+            return true;
+        }
+    }
+
+    ESP_LOGE(TAG, "Session [%s] no free transfer slot (%d)",
+             s->key, TRANSFER_ARENA_SLOTS);
+    return false;
+}
+
+// Caller holds session_mutex
+static void buffer_free(transfer_session_t *s)
+{
+    arena_slot_used[(s->b64 - (char *)REEF_ARENA(transfer)) / MAX_IMAGE_BASE64_SIZE] = false;
+    mem_release(s->b64_cap);
+}
+
+#else
+
+// Caller holds session_mutex
+static bool buffer_grow(transfer_session_t *s, size_t need)
+{
+    // Grow in fixed steps instead of reserving the worst case up front
+    size_t new_cap = need + TRANSFER_GROW_STEP;
+    if (new_cap > MAX_IMAGE_BASE64_SIZE)
+    {
+        new_cap = MAX_IMAGE_BASE64_SIZE;
+    }
+
+    if (!mem_reserve(new_cap - s->b64_cap))
+    {
+        ESP_LOGE(TAG, "Transfer memory budget exhausted (%lu/%lu)",
+                 (unsigned long)transfer_mem_used, (unsigned long)TRANSFER_BUDGET);
+        return false;
+    }
+
+    char *grown = realloc(s->b64, new_cap);
+    if (!grown)
+    {
+        mem_release(new_cap - s->b64_cap);
+        ESP_LOGE(TAG, "Session [%s] realloc failed", s->key);
+        return false;
+    }
+
+    s->b64 = grown;
+    s->b64_cap = new_cap;
+    return true;
+}
+
+// Caller holds session_mutex
+static void buffer_free(transfer_session_t *s)
+{
+    free(s->b64);
+    mem_release(s->b64_cap);
+}
+
+#endif
+
+// Caller holds session_mutex
+static void session_close(transfer_session_t *s)
+{
+    if (s->b64)
+    {
+        buffer_free(s);
+    }
+    memset(s, 0, sizeof(*s));
+}
+
+// Caller holds session_mutex
+static bool session_append(transfer_session_t *s, const char *data, size_t len)
+{
+    size_t need = s->b64_len + len;
+
+    if (need > MAX_IMAGE_BASE64_SIZE)
+    {
+        ESP_LOGE(TAG, "Session [%s] exceeds %d bytes",
+                 s->key, MAX_IMAGE_BASE64_SIZE);
+        return false;
+    }
+
+    if (need > s->b64_cap && !buffer_grow(s, need))
+    {
+        return false;
+    }
+
+    memcpy(s->b64 + s->b64_len, data, len);
+    s->b64_len += len;
+    s->chunks++;
+    s->last_rx_ms = now_ms();
+    return true;
+}
+
+// ------------------------------------------------------------
+
+// Caller holds session_mutex
+static void sessions_snapshot(void)
+{
+    transfer_state_t state = {0};
+
+    for (int i = 0; i < MAX_TRANSFER_SESSIONS; i++)
+    {
+        const transfer_session_t *s = &sessions[i];
+        session_snapshot_t *p = &state.sessions[i];
+
+        p->in_use = s->in_use;
+        strlcpy(p->key, s->key, sizeof(p->key));
+        p->b64_len = s->b64_len;
+        p->chunks = s->chunks;
+    }
+
+    reef_state_put(&transfer_snapshot, &state);
+}
+
+// Before Wi-Fi: reports transfers that were in progress at the reset. The
+// sessions start empty; the snapshot is cleared once the writer runs.
+static void sessions_restore(void)
+{
+    transfer_state_t state;
+    if (!reef_state_restore(&transfer_snapshot, &state))
+    {
+        return;
+    }
+
+    for (int i = 0; i < MAX_TRANSFER_SESSIONS; i++)
+    {
+        const session_snapshot_t *p = &state.sessions[i];
+        if (p->in_use && p->b64_len > 0)
+        {
+            ESP_LOGW(TAG, "Session [%.*s] lost in the reset: %lu chunks / %lu bytes",
+                     (int)sizeof(p->key), p->key, (unsigned long)p->chunks,
+                     (unsigned long)p->b64_len);
+        }
+    }
+
+    xSemaphoreTake(session_mutex, portMAX_DELAY);
+    sessions_snapshot();
+    xSemaphoreGive(session_mutex);
+}
+
+// ------------------------------------------------------------
+
 static void publish_task4_request(void)
 {
     cJSON *root = cJSON_CreateObject();
@@ -53,50 +315,104 @@ static void publish_task4_request(void)
 
 // ------------------------------------------------------------
 
-static void try_decode_image(void)
+// Decodes Base64 into the start of its own buffer, a block at a time.
+// Each block's output is shorter than its input, so it only overwrites
+// text that has already been read. Expects no line breaks in the text.
+static int base64_decode_in_place(uint8_t *buf, size_t len, size_t *out_len)
 {
-    image_bin = malloc(MAX_IMAGE_BINARY_SIZE);
-    if (!image_bin)
+    uint8_t block[BASE64_DECODE_BLOCK / 4 * 3];
+    size_t in = 0, out = 0;
+
+    while (in < len)
     {
-        ESP_LOGE(TAG, "Binary buffer alloc failed");
-        return;
-    }
+        size_t n = len - in < BASE64_DECODE_BLOCK ? len - in : BASE64_DECODE_BLOCK;
+        size_t got = 0;
 
-    int ret = mbedtls_base64_decode(
-        image_bin,
-        MAX_IMAGE_BINARY_SIZE,
-        &image_bin_len,
-        (unsigned char *)image_b64,
-        image_b64_len);
+        int ret = mbedtls_base64_decode(block, sizeof(block), &got, buf + in, n);
+        if (ret != 0)
+        {
+            return ret;
+        }
 
-    if (ret != 0)
-    {
-        ESP_LOGE(TAG, "Base64 decode failed: %d", ret);
-        return;
+        memcpy(buf + out, block, got);
+        in += n;
+        out += got;
     }
 
-    ESP_LOGI(TAG, "Image decoded successfully");
-    ESP_LOGI(TAG, "Binary size: %d bytes", image_bin_len);
+    *out_len = out;
+    return 0;
+}
 
-    // ---- PNG signature check ----
-    const uint8_t png_magic[8] = {
-        0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+// Caller holds session_mutex; the session's text is consumed
+static void try_decode_image(transfer_session_t *s)
+{
+    uint8_t *image_bin = (uint8_t *)s->b64;
+    size_t image_bin_len = 0;
+    int ret = base64_decode_in_place(image_bin, s->b64_len, &image_bin_len);
 
-    if (memcmp(image_bin, png_magic, 8) == 0)
+    if (ret != 0)
     {
-        ESP_LOGI(TAG, "PNG signature OK");
+        ESP_LOGE(TAG, "Session [%s] Base64 decode failed: %d", s->key, ret);
     }
     else
     {
-        ESP_LOGE(TAG, "Invalid PNG signature");
+        ESP_LOGI(TAG, "Session [%s] image decoded successfully", s->key);
+        reef_state_first_output("image decoded");
+        ESP_LOGI(TAG, "Binary size: %lu bytes", (unsigned long)image_bin_len);
+
+        // ---- PNG signature check ----
+        const uint8_t png_magic[8] = {
+            0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+
+        if (image_bin_len >= 8 && memcmp(image_bin, png_magic, 8) == 0)
+        {
+            ESP_LOGI(TAG, "PNG signature OK");
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Invalid PNG signature");
+        }
+    }
+
+    s->b64_len = 0;
+}
+
+// ------------------------------------------------------------
+
+// Sessions that stopped receiving chunks are considered complete: decode
+// what arrived and give the slot and its memory back to the pool.
+static void evict_idle_sessions(void)
+{
+    xSemaphoreTake(session_mutex, portMAX_DELAY);
+
+    int64_t now = now_ms();
+    for (int i = 0; i < MAX_TRANSFER_SESSIONS; i++)
+    {
+        transfer_session_t *s = &sessions[i];
+        if (!s->in_use || now - s->last_rx_ms < TRANSFER_IDLE_TIMEOUT_MS)
+        {
+            continue;
+        }
+
+        ESP_LOGI(TAG, "Session [%s] idle, %lu chunks / %lu bytes",
+                 s->key, (unsigned long)s->chunks, (unsigned long)s->b64_len);
+
+        if (s->b64_len > 0)
+        {
+            try_decode_image(s);
+        }
+        session_close(s);
+        sessions_snapshot();
     }
+
+    xSemaphoreGive(session_mutex);
 }
 
 // ------------------------------------------------------------
 
-static void handle_image_json(const char *payload)
+static void handle_image_json(const char *payload, size_t len)
 {
-    cJSON *root = cJSON_Parse(payload);
+    cJSON *root = cJSON_ParseWithLength(payload, len);
     if (!root)
     {
         ESP_LOGE(TAG, "Invalid JSON");
@@ -118,20 +434,62 @@ static void handle_image_json(const char *payload)
         ESP_LOGW(TAG, "Unexpected image type: %s", type->valuestring);
     }
 
-    size_t chunk_len = strlen(data->valuestring);
+    // Session key: agent_id, else request_id, else a shared anonymous slot
+    const char *key = "anonymous";
+    cJSON *agent = cJSON_GetObjectItem(root, "agent_id");
+    cJSON *request = cJSON_GetObjectItem(root, "request_id");
 
-    if (!image_b64)
+    if (cJSON_IsString(agent))
+    {
+        key = agent->valuestring;
+    }
+    else if (cJSON_IsString(request))
     {
-        image_b64 = malloc(MAX_IMAGE_BASE64_SIZE);
-        image_b64_len = 0;
+        key = request->valuestring;
     }
 
-    memcpy(image_b64 + image_b64_len, data->valuestring, chunk_len);
-    image_b64_len += chunk_len;
+    // Sessions are matched on the whole key; one that does not fit would
+    // open a new session per chunk
+    if (strlen(key) >= TRANSFER_SESSION_KEY_LEN)
+    {
+        ESP_LOGE(TAG, "Session key too long (max %d characters), dropping chunk",
+                 TRANSFER_SESSION_KEY_LEN - 1);
+        cJSON_Delete(root);
+        return;
+    }
 
-    ESP_LOGI(TAG, "Received image chunk (%d bytes)", chunk_len);
-    ESP_LOGI(TAG, "Total Base64 size: %d", image_b64_len);
+    size_t chunk_len = strlen(data->valuestring);
 
+    xSemaphoreTake(session_mutex, portMAX_DELAY);
+
+    transfer_session_t *s = session_find(key);
+    if (!s)
+    {
+        s = session_open(key);
+    }
+
+    if (!s)
+    {
+        ESP_LOGW(TAG, "Session pool full, dropping chunk for [%s]", key);
+    }
+    else if (!session_append(s, data->valuestring, chunk_len))
+    {
+        ESP_LOGE(TAG, "Session [%s] aborted", s->key);
+        session_close(s);
+        sessions_snapshot();
+    }
+    else
+    {
+        sessions_snapshot();
+        REEF_LOGI(TAG, "Session [%s] chunk %lu (%lu bytes), total %lu",
+                  s->key, (unsigned long)s->chunks, (unsigned long)chunk_len,
+                  (unsigned long)s->b64_len);
+        REEF_LOGI(TAG, "Transfer memory: %lu used / %lu peak / %lu budget",
+                  (unsigned long)transfer_mem_used, (unsigned long)transfer_mem_peak,
+                  (unsigned long)TRANSFER_BUDGET);
+    }
+
+    xSemaphoreGive(session_mutex);
     cJSON_Delete(root);
 }
 
@@ -157,19 +515,17 @@ static void mqtt_event_handler(void *arg, esp_event_base_t base,
         break;
 
     case MQTT_EVENT_DATA:
-        ESP_LOGI(TAG, "RX | topic='%.*s' len=%d",
-                 event->topic_len,
-                 event->topic,
-                 event->data_len);
+        REEF_LOGI(TAG, "RX | topic='%.*s' len=%d",
+                  REEF_LOG_BYTES(event->topic, event->topic_len),
+                  event->data_len);
 
-        ESP_LOGI(TAG, "Payload: %.*s",
-                 event->data_len,
-                 event->data);
+        REEF_LOGI(TAG, "Payload: %.*s",
+                  REEF_LOG_BYTES(event->data, event->data_len));
 
         // If JSON with "data", treat as image chunk
-        if (strstr(event->data, "\"data\""))
+        if (memmem(event->data, event->data_len, "\"data\"", 6))
         {
-            handle_image_json(event->data);
+            handle_image_json(event->data, event->data_len);
         }
         break;
 
@@ -186,31 +542,30 @@ static void mqtt_event_handler(void *arg, esp_event_base_t base,
 
 void app_main(void)
 {
-    ESP_ERROR_CHECK(nvs_flash_init());
-
-    image_b64 = malloc(MAX_IMAGE_BASE64_SIZE);
-    memset(image_b64, 0, MAX_IMAGE_BASE64_SIZE);
-
-    esp_mqtt_client_config_t cfg = {
-        .broker.address.uri = MQTT_BROKER_URI};
-
-    mqtt_client = esp_mqtt_client_init(&cfg);
-    esp_mqtt_client_register_event(
-        mqtt_client,
-        ESP_EVENT_ANY_ID,
-        mqtt_event_handler,
-        NULL);
-
-    esp_mqtt_client_start(mqtt_client);
-
-    // ---- Wait for all chunks ----
-    vTaskDelay(pdMS_TO_TICKS(5000));
-
-    ESP_LOGI(TAG, "Attempting image decode...");
-    try_decode_image();
-
+    reef_log_init();
+
+    session_mutex = REEF_MUTEX_CREATE(sessions);
+    reef_trace_queue(session_mutex, "sessions");
+
+    sessions_restore();
+    reef_state_start();
+
+    // MQTT starts once Wi-Fi has an IP; the request goes out on CONNECTED
+    reef_net_config_t net = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+        .static_ip = WIFI_STATIC_IP,
+        .broker_uri = MQTT_BROKER_URI,
+        .mqtt_handler = mqtt_event_handler,
+    };
+    ESP_ERROR_CHECK(reef_net_start(&net, &mqtt_client));
+    reef_trace_start(mqtt_client, METRICS_TOPIC, METRICS_PERIOD_MS);
+    reef_mem_report_start();
+
+    // ---- Finalize transfers as they go idle ----
     while (1)
     {
         vTaskDelay(pdMS_TO_TICKS(1000));
+        evict_idle_sessions();
     }
 }
@@ -1,63 +1,132 @@
-import paho.mqtt.client as mqtt
-from PIL import Image
-import base64
-import json
 import os
+import sys
+
+import numpy as np
+from PIL import Image
 
 # --- PATH CONFIGURATION ---
-# Fixed the syntax error here:
 IMAGE_PATH = "artifact.png"
 
+# How many ranked candidates to print
+TOP_N = 5
+
+# Longest message (in bytes) a candidate is scored over
+MAX_MESSAGE_BYTES = 4096
+
+# Shorter candidates are down-weighted and get no terminator bonus: a few
+# noise bytes ending on "}" or NUL are common across the rule set
+MIN_MESSAGE_BYTES = 8
+
+# Common message closers: JSON/flag brace, C-string NUL
+TERMINATORS = (ord("}"), 0)
+
+
+# --- CANDIDATE BIT RULES ---
+# Each rule maps the (H, W) channel planes to one bit per pixel.
+# They are all evaluated on the same decoded pixel array, so the image is
+# read exactly once no matter how many rules are tried.
+def build_rules(r, g, b):
+    s = r + g + b
+    return {
+        "lsb(r)": (r & 1) == 1,
+        "lsb(g)": (g & 1) == 1,
+        "lsb(b)": (b & 1) == 1,
+        "r > g": r > g,
+        "g > r": g > r,
+        "g > b": g > b,
+        "b > g": b > g,
+        "r > b": r > b,
+        "b > r": b > r,
+        "(r+g+b) % 2 == 0": (s & 1) == 0,
+        "(r+g+b) % 2 == 1": (s & 1) == 1,
+    }
+
+
+def bits_to_bytes(bits):
+    # MSB-first, trailing partial byte dropped (same as the old decoder)
+    usable = (bits.size // 8) * 8
+    return np.packbits(bits[:usable]).tobytes()
+
+
+def score_stream(data):
+    """Printable-ASCII ratio up to the first terminator, weighted down below
+    MIN_MESSAGE_BYTES, plus a bonus if a terminator was actually seen.
+    Returns (score, message, terminated)."""
+    data = data[:MAX_MESSAGE_BYTES]
+
+    end = len(data)
+    terminated = False
+    for t in TERMINATORS:
+        pos = data.find(bytes([t]))
+        if pos != -1 and pos < end:
+            # keep the closing brace, drop the NUL
+            end = pos + 1 if t == ord("}") else pos
+            terminated = True
+
+    body = data[:end]
+    if not body:
+        return 0.0, "", terminated
+
+    arr = np.frombuffer(body, dtype=np.uint8)
+    printable = np.count_nonzero((arr >= 32) & (arr <= 126))
+    ratio = printable / arr.size
+    score = ratio * min(1.0, arr.size / MIN_MESSAGE_BYTES)
+
+    # A run of printable bytes that ends on a terminator is much stronger
+    # evidence than a long run of noise that never terminates.
+    if terminated and ratio > 0.9 and arr.size >= MIN_MESSAGE_BYTES:
+        score += 0.5
+
+    message = "".join(chr(c) for c in body if 32 <= c <= 126)
+    return score, message, terminated
+
+
 def extract_hidden_language(path):
-    try:
-        # 1. Import the image
-        img = Image.open(path).convert('RGB')
-        pixels = img.load()
-        width, height = img.size
-        
-        binary_data = ""
-        print(f"Examining {width}x{height} pixels...")
-
-        # 2. Methodical examination of components
-        for y in range(height):
-            for x in range(width):
-                r, g, b = pixels[x, y]
-                
-                # RELATIONSHIP 1: Comparison (Red > Green)
-                # If this gives gibberish, change to: if (r + g + b) % 2 == 0:
-                if r > g:
-                    binary_data += "1"
-                else:
-                    binary_data += "0"
-
-        # 3. Assemble observations into language (ASCII)
-        message = ""
-        for i in range(0, len(binary_data), 8):
-            byte = binary_data[i:i+8]
-            if len(byte) < 8: break
-            
-            char_code = int(byte, 2)
-            
-            # Filter for printable ASCII characters
-            if 32 <= char_code <= 126:
-                message += chr(char_code)
-            
-            # Stop if we hit a common flag/message closer
-            if "}" in message:
-                break
-        
-        return message
-
-    except Exception as e:
-        return f"Error processing image: {e}"
+    # 1. Import the image (single read)
+    img = np.asarray(Image.open(path).convert("RGB"), dtype=np.int16)
+    height, width, _ = img.shape
+    print(f"Examining {width}x{height} pixels...")
+
+    r, g, b = img[:, :, 0], img[:, :, 1], img[:, :, 2]
+    rules = build_rules(r, g, b)
+
+    # 2. Feed every rule in both scan orders and score the streams
+    results = []
+    for name, plane in rules.items():
+        for order, flat in (("row-major", plane.ravel()),
+                            ("col-major", plane.T.ravel())):
+            data = bits_to_bytes(flat.astype(np.uint8))
+            score, message, terminated = score_stream(data)
+            results.append((score, name, order, terminated, message))
+
+    # 3. Rank by plausibility
+    results.sort(key=lambda x: x[0], reverse=True)
+    return results
+
+
+def print_results(results):
+    print(f"\n--- TOP {min(TOP_N, len(results))} CANDIDATES ---")
+    for rank, (score, name, order, terminated, message) in \
+            enumerate(results[:TOP_N], 1):
+        preview = message[:60] + ("..." if len(message) > 60 else "")
+        print(f"{rank}. score={score:.3f}  rule={name:<18} {order:<9} "
+              f"term={'y' if terminated else 'n'}  {preview!r}")
+    print("-------------------------")
+
 
 # Execute Extraction
 if __name__ == "__main__":
-    if os.path.exists(IMAGE_PATH):
-        result = extract_hidden_language(IMAGE_PATH)
-        print("\n--- EXTRACTED MESSAGE ---")
-        print(result if result else "No readable text found with this relationship.")
-        print("-------------------------\n")
-    else:
-        print(f"Error: File not found at {IMAGE_PATH}")
-        print("Ensure you have run your ESP32/MQTT script first to save the image.")
\ No newline at end of file
+    path = sys.argv[1] if len(sys.argv) > 1 else IMAGE_PATH
+
+    if not os.path.exists(path):
+        print(f"Error: File not found at {path}")
+        print("Ensure you have run your ESP32/MQTT script first to save the image.")
+        sys.exit(1)
+
+    results = extract_hidden_language(path)
+    print_results(results)
+
+    best = results[0]
+    print("\n--- EXTRACTED MESSAGE ---")
+    print(best[4] if best[4] else "No readable text found with any rule.")
+    print("-------------------------\n")
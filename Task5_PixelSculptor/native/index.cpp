@@ -0,0 +1,321 @@
+// Target index: build, mmap, indexed transport ------------------------------ //
+
+#include "index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ssim.h"
+#include "thread_pool.h"
+#include "transport.h"
+
+namespace ps
+{
+
+namespace
+{
+
+const char kMagic[8] = {'P', 'S', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+uint64_t align64(uint64_t off)
+{
+    return (off + 63) & ~uint64_t(63);
+}
+
+bool index_params(const ps_params_t &p)
+{
+    return valid_params(p) && p.levels == 0 && p.directions == 1;
+}
+
+// Same effective block-mode params (weights compared after defaulting)
+bool same_params(const IndexHeader &h, const ps_params_t &p)
+{
+    int w[3];
+    lum_weights(p, w);
+    return h.block == p.block && h.offset_x == p.offset_x &&
+           h.offset_y == p.offset_y && h.weights[0] == w[0] &&
+           h.weights[1] == w[1] && h.weights[2] == w[2];
+}
+
+IndexHeader make_header(int width, int height, const ps_params_t &p,
+                        uint64_t hash)
+{
+    IndexHeader h = {};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = PS_INDEX_VERSION;
+    h.header_size = sizeof(IndexHeader);
+    h.width = width;
+    h.height = height;
+    h.block = p.block;
+    h.offset_x = p.offset_x;
+    h.offset_y = p.offset_y;
+    lum_weights(p, h.weights);
+    h.target_hash = hash;
+
+    const uint64_t pixels = static_cast<uint64_t>(width) * height;
+    const uint64_t windows =
+        static_cast<uint64_t>(std::max(0, width - Ssim::kWin + 1)) *
+        std::max(0, height - Ssim::kWin + 1);
+
+    h.orders_off = align64(sizeof(IndexHeader));
+    h.gray_off = align64(h.orders_off + pixels * sizeof(uint32_t));
+    h.sum_off = align64(h.gray_off + pixels);
+    h.sq_off = align64(h.sum_off + windows * sizeof(int32_t));
+    h.file_size = h.sq_off + windows * sizeof(int32_t);
+    return h;
+}
+
+} // namespace
+
+uint64_t hash_rgb(const uint8_t *rgb, size_t bytes)
+{
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < bytes; i++)
+    {
+        h = (h ^ rgb[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+} // namespace ps
+
+// C API --------------------------------------------------------------------- //
+
+extern "C" int ps_index_build(const uint8_t *target_rgb, int width, int height,
+                              const ps_params_t *params, const char *path)
+{
+    if (!target_rgb || !params || !path || width <= 0 || height <= 0 ||
+        !ps::index_params(*params))
+    {
+        return PS_ERR_ARG;
+    }
+
+    const ps_params_t &p = *params;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    ps::IndexHeader h = ps::make_header(width, height, p,
+                                        ps::hash_rgb(target_rgb, 3 * pixels));
+
+    std::vector<uint8_t> file;
+    try
+    {
+        file.assign(h.file_size, 0);
+        std::memcpy(file.data(), &h, sizeof(h));
+
+        uint32_t *orders = reinterpret_cast<uint32_t *>(&file[h.orders_off]);
+        uint8_t *gray = &file[h.gray_off];
+        int32_t *sum = reinterpret_cast<int32_t *>(&file[h.sum_off]);
+        int32_t *sq = reinterpret_cast<int32_t *>(&file[h.sq_off]);
+
+        std::vector<uint32_t> lum =
+            ps::luminance_plane(target_rgb, width, height, h.weights);
+
+        // Same tiling as transport_tile_row(), sorting only the target side
+        ps::pool().parallel_for(ps::tile_rows(p, height), [&](int64_t row) {
+            thread_local ps::RadixSorter sorter;
+            thread_local std::vector<uint32_t> keys;
+
+            int y0, y1;
+            ps::tile_row_span(p, height, static_cast<int>(row), &y0, &y1);
+            int th = y1 - y0;
+
+            for (int start = -p.offset_x; start < width; start += p.block)
+            {
+                int x0 = std::max(0, start);
+                int w = std::min(width, start + p.block) - x0;
+
+                keys.resize(static_cast<size_t>(w) * th);
+                for (int dy = 0; dy < th; dy++)
+                {
+                    std::memcpy(&keys[dy * w],
+                                &lum[static_cast<size_t>(y0 + dy) * width + x0],
+                                w * sizeof(uint32_t));
+                }
+                sorter.sort(keys.data(), static_cast<uint32_t>(keys.size()),
+                            orders + ps::tile_offset(width, x0, y0, th));
+            }
+        });
+
+        ps::gray_plane(target_rgb, gray, static_cast<int64_t>(pixels));
+        ps::Ssim::target_sums(gray, width, height, sum, sq);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return PS_ERR_NO_MEM;
+    }
+
+    // Write next to the destination and rename, so a reader never maps a
+    // half-written file
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f)
+    {
+        return PS_ERR_IO;
+    }
+    bool ok = std::fwrite(file.data(), 1, file.size(), f) == file.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path) != 0)
+    {
+        std::remove(tmp.c_str());
+        return PS_ERR_IO;
+    }
+
+    return PS_OK;
+}
+
+extern "C" ps_index_t *ps_index_open(const char *path, const uint8_t *target_rgb,
+                                     int width, int height,
+                                     const ps_params_t *params)
+{
+    if (!path)
+    {
+        return nullptr;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 &&
+        static_cast<size_t>(st.st_size) >= sizeof(ps::IndexHeader))
+    {
+        map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    const size_t size = st.st_size;
+    const auto *h = static_cast<const ps::IndexHeader *>(map);
+
+    // Recompute the layout from the header fields instead of trusting the
+    // stored offsets, which also rejects truncated files
+    bool ok = std::memcmp(h->magic, ps::kMagic, sizeof(ps::kMagic)) == 0 &&
+              h->version == PS_INDEX_VERSION &&
+              h->header_size == sizeof(ps::IndexHeader) &&
+              h->width > 0 && h->height > 0;
+    if (ok)
+    {
+        ps_params_t p = ps_default_params();
+        p.block = h->block;
+        p.offset_x = h->offset_x;
+        p.offset_y = h->offset_y;
+        std::memcpy(p.weights, h->weights, sizeof(p.weights));
+
+        ps::IndexHeader expect =
+            ps::make_header(h->width, h->height, p, h->target_hash);
+        ok = ps::index_params(p) && h->orders_off == expect.orders_off &&
+             h->gray_off == expect.gray_off && h->sum_off == expect.sum_off &&
+             h->sq_off == expect.sq_off && h->file_size == expect.file_size &&
+             size >= expect.file_size;
+    }
+    if (ok && (width > 0 || height > 0))
+    {
+        ok = h->width == width && h->height == height;
+    }
+    if (ok && params)
+    {
+        ok = ps::same_params(*h, *params);
+    }
+    if (ok && target_rgb)
+    {
+        size_t bytes = 3 * static_cast<size_t>(h->width) * h->height;
+        ok = ps::hash_rgb(target_rgb, bytes) == h->target_hash;
+    }
+
+    ps_index_t *idx = ok ? new (std::nothrow) ps_index_t : nullptr;
+    if (!idx)
+    {
+        munmap(map, size);
+        return nullptr;
+    }
+
+    const uint8_t *base = static_cast<const uint8_t *>(map);
+    idx->map = map;
+    idx->size = size;
+    idx->header = h;
+    idx->orders = reinterpret_cast<const uint32_t *>(base + h->orders_off);
+    idx->gray = base + h->gray_off;
+    idx->sum = reinterpret_cast<const int32_t *>(base + h->sum_off);
+    idx->sq = reinterpret_cast<const int32_t *>(base + h->sq_off);
+    return idx;
+}
+
+extern "C" void ps_index_close(ps_index_t *idx)
+{
+    if (idx)
+    {
+        munmap(idx->map, idx->size);
+        delete idx;
+    }
+}
+
+extern "C" void ps_index_info(const ps_index_t *idx, int *width, int *height,
+                              ps_params_t *params)
+{
+    const ps::IndexHeader &h = *idx->header;
+    if (width)
+    {
+        *width = h.width;
+    }
+    if (height)
+    {
+        *height = h.height;
+    }
+    if (params)
+    {
+        *params = ps_default_params();
+        params->block = h.block;
+        params->offset_x = h.offset_x;
+        params->offset_y = h.offset_y;
+        std::memcpy(params->weights, h.weights, sizeof(params->weights));
+    }
+}
+
+extern "C" int ps_transport_indexed(const uint8_t *src, const ps_index_t *idx,
+                                    uint8_t *out)
+{
+    if (!src || !idx || !out)
+    {
+        return PS_ERR_ARG;
+    }
+
+    ps_params_t p;
+    int width, height;
+    ps_index_info(idx, &width, &height, &p);
+
+    try
+    {
+        std::vector<uint32_t> src_lum =
+            ps::luminance_plane(src, width, height, p.weights);
+
+        ps::TileJob job = {src, src_lum.data(), nullptr, nullptr, out,
+                           width, height, p, idx->orders};
+
+        ps::pool().parallel_for(ps::tile_rows(p, height), [&](int64_t row) {
+            thread_local ps::TileScratch scratch;
+            thread_local ps::SlicedScratch sliced;
+            ps::transport_tile_row(job, static_cast<int>(row), scratch, sliced);
+        });
+    }
+    catch (const std::bad_alloc &)
+    {
+        return PS_ERR_NO_MEM;
+    }
+
+    return PS_OK;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Target index file layout --------------------------------------------------- //
+//
+// One header followed by 64-byte aligned sections, native byte order (the
+// index is a local cache, not an interchange format):
+//
+//   orders  uint32[width * height]  per-tile target sort order, tiles back
+//                                   to back at tile_offset()
+//   gray    uint8[width * height]   OpenCV RGB2GRAY of the target
+//   sum     int32[windows]          SSIM 7x7 window sums of gray
+//   sq      int32[windows]          SSIM 7x7 window sums of gray^2
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pixel_sculptor.h"
+
+namespace ps
+{
+
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t width;
+    int32_t height;
+    int32_t block;
+    int32_t offset_x;
+    int32_t offset_y;
+    int32_t weights[3];
+    uint64_t target_hash;
+    uint64_t orders_off;
+    uint64_t gray_off;
+    uint64_t sum_off;
+    uint64_t sq_off;
+    uint64_t file_size;
+};
+
+// FNV-1a over the target pixels, to catch an index built for another image
+uint64_t hash_rgb(const uint8_t *rgb, size_t bytes);
+
+} // namespace ps
+
+struct ps_index
+{
+    void *map;
+    size_t size;
+    const ps::IndexHeader *header;
+    const uint32_t *orders;
+    const uint8_t *gray;
+    const int32_t *sum;
+    const int32_t *sq;
+};
@@ -0,0 +1,419 @@
+// pixelsculptor: standalone CLI for the native engine ----------------------- //
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "pixel_sculptor.h"
+#include "ppm.h"
+
+namespace
+{
+
+struct Options
+{
+    ps_params_t params = ps_default_params();
+    int threads = 0;
+    int band_rows = 0;
+    std::string index;
+    std::vector<int> blocks = {4, 6, 8, 12, 16};
+    std::vector<std::string> positional;
+};
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "usage: pixelsculptor transport [options] SRC.ppm TGT.ppm OUT.ppm\n"
+                 "       pixelsculptor ssim [options] IMG.ppm TGT.ppm\n"
+                 "       pixelsculptor tune [options] SRC.ppm TGT.ppm\n"
+                 "       pixelsculptor index [options] TGT.ppm OUT.psidx\n"
+                 "       pixelsculptor stream [options] SRC.ppm TGT.ppm OUT.ppm\n"
+                 "\n"
+                 "options:\n"
+                 "  --block N       OT block size (default 8)\n"
+                 "  --levels N      coarse-to-fine pyramid levels, 0 = off (default 0)\n"
+                 "  --region N      pyramid region size in cells (default 4)\n"
+                 "  --directions N  sliced RGB projections, 1 = luminance only (default 1)\n"
+                 "  --offset-x N    shift the tile grid left by N px, < block (default 0)\n"
+                 "  --offset-y N    shift the tile grid up by N px, < block (default 0)\n"
+                 "  --threads N     worker threads, 0 = all cores (default 0)\n"
+                 "  --band-rows N   stream: band height in tile rows (default 8)\n"
+                 "  --index FILE    transport/ssim: read the target side from an index\n"
+                 "  --blocks LIST   tune: comma-separated block sizes (default 4,6,8,12,16)\n");
+}
+
+Options parse(int argc, char **argv, int first)
+{
+    Options opt;
+
+    for (int i = first; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&]() -> int {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            return std::atoi(argv[++i]);
+        };
+
+        if (arg == "--block")
+        {
+            opt.params.block = value();
+        }
+        else if (arg == "--levels")
+        {
+            opt.params.levels = value();
+        }
+        else if (arg == "--region")
+        {
+            opt.params.region = value();
+        }
+        else if (arg == "--directions")
+        {
+            opt.params.directions = value();
+        }
+        else if (arg == "--offset-x")
+        {
+            opt.params.offset_x = value();
+        }
+        else if (arg == "--offset-y")
+        {
+            opt.params.offset_y = value();
+        }
+        else if (arg == "--band-rows")
+        {
+            opt.band_rows = value();
+        }
+        else if (arg == "--index")
+        {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            opt.index = argv[++i];
+        }
+        else if (arg == "--blocks")
+        {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            opt.blocks.clear();
+            for (const char *p = argv[++i]; *p;)
+            {
+                char *end;
+                long block = std::strtol(p, &end, 10);
+                if (end == p || (*end && *end != ','))
+                {
+                    throw std::runtime_error("bad --blocks list");
+                }
+                opt.blocks.push_back(static_cast<int>(block));
+                p = *end ? end + 1 : end;
+            }
+        }
+        else if (arg == "--threads")
+        {
+            opt.threads = value();
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            throw std::runtime_error("unknown option " + arg);
+        }
+        else
+        {
+            opt.positional.push_back(arg);
+        }
+    }
+
+    return opt;
+}
+
+double ms_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - t0)
+        .count();
+}
+
+int cmd_transport(const Options &opt)
+{
+    if (opt.positional.size() != 3)
+    {
+        usage();
+        return 2;
+    }
+
+    ps::Image src = ps::read_ppm(opt.positional[0]);
+    ps::Image tgt = ps::read_ppm(opt.positional[1]);
+
+    if (src.width != tgt.width || src.height != tgt.height)
+    {
+        throw std::runtime_error("source and target sizes differ "
+                                 "(resize the source first)");
+    }
+
+    ps::Image out;
+    out.width = tgt.width;
+    out.height = tgt.height;
+    out.rgb.resize(tgt.rgb.size());
+
+    ps_index_t *idx = nullptr;
+    if (!opt.index.empty())
+    {
+        idx = ps_index_open(opt.index.c_str(), tgt.rgb.data(), tgt.width,
+                            tgt.height, &opt.params);
+        if (!idx)
+        {
+            throw std::runtime_error("index " + opt.index +
+                                     " is missing or does not match");
+        }
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    int rc = idx ? ps_transport_indexed(src.rgb.data(), idx, out.rgb.data())
+                 : ps_transport_ex(src.rgb.data(), tgt.rgb.data(), out.rgb.data(),
+                                   out.width, out.height, &opt.params);
+    double elapsed = ms_since(t0);
+    ps_index_close(idx);
+
+    if (rc != PS_OK)
+    {
+        std::fprintf(stderr, "[ERROR] transport failed: %d\n", rc);
+        return 1;
+    }
+
+    ps::write_ppm(opt.positional[2], out);
+
+    std::printf("[OT] %dx%d block=%d levels=%d region=%d directions=%d "
+                "threads=%d: %.2f ms\n",
+                out.width, out.height, opt.params.block, opt.params.levels,
+                opt.params.region, opt.params.directions, ps_get_threads(),
+                elapsed);
+    return 0;
+}
+
+int cmd_ssim(const Options &opt)
+{
+    if (opt.positional.size() != 2)
+    {
+        usage();
+        return 2;
+    }
+
+    ps::Image img = ps::read_ppm(opt.positional[0]);
+    ps::Image tgt = ps::read_ppm(opt.positional[1]);
+
+    if (img.width != tgt.width || img.height != tgt.height)
+    {
+        throw std::runtime_error("image sizes differ");
+    }
+
+    ps_index_t *idx = nullptr;
+    if (!opt.index.empty())
+    {
+        idx = ps_index_open(opt.index.c_str(), tgt.rgb.data(), tgt.width,
+                            tgt.height, nullptr);
+        if (!idx)
+        {
+            throw std::runtime_error("index " + opt.index +
+                                     " is missing or does not match");
+        }
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    double score;
+    if (idx)
+    {
+        ps_ssim_t *ctx = ps_ssim_create_indexed(idx);
+        score = ps_ssim_score(ctx, img.rgb.data());
+        ps_ssim_destroy(ctx);
+        ps_index_close(idx);
+    }
+    else
+    {
+        score = ps_ssim(img.rgb.data(), tgt.rgb.data(), img.width, img.height);
+    }
+    double elapsed = ms_since(t0);
+
+    std::printf("[SSIM] Score = %.6f (%.2f ms)\n", score, elapsed);
+    return 0;
+}
+
+int cmd_index(const Options &opt)
+{
+    if (opt.positional.size() != 2)
+    {
+        usage();
+        return 2;
+    }
+
+    ps::Image tgt = ps::read_ppm(opt.positional[0]);
+
+    auto t0 = std::chrono::steady_clock::now();
+    int rc = ps_index_build(tgt.rgb.data(), tgt.width, tgt.height, &opt.params,
+                            opt.positional[1].c_str());
+    double elapsed = ms_since(t0);
+
+    if (rc != PS_OK)
+    {
+        std::fprintf(stderr, "[ERROR] index build failed: %d\n", rc);
+        return 1;
+    }
+
+    std::printf("[INDEX] %s: %dx%d block=%d offset=%d/%d (%.2f ms)\n",
+                opt.positional[1].c_str(), tgt.width, tgt.height,
+                opt.params.block, opt.params.offset_x, opt.params.offset_y,
+                elapsed);
+    return 0;
+}
+
+int cmd_stream(const Options &opt)
+{
+    if (opt.positional.size() != 3)
+    {
+        usage();
+        return 2;
+    }
+
+    ps_stream_stats_t st;
+    int rc = ps_stream_transport(opt.positional[0].c_str(), opt.positional[1].c_str(),
+                                 opt.positional[2].c_str(), &opt.params,
+                                 opt.band_rows, nullptr, nullptr, &st);
+    if (rc != PS_OK)
+    {
+        std::fprintf(stderr, "[ERROR] stream failed: %d\n", rc);
+        return 1;
+    }
+
+    std::printf("[STREAM] %dx%d in %d bands, peak %.1f MiB, threads=%d: "
+                "read %.1f ms, transport %.1f ms, write+ssim %.1f ms, "
+                "total %.1f ms\n",
+                st.width, st.height, st.bands, st.peak_bytes / 1048576.0,
+                ps_get_threads(), st.read_ms, st.transport_ms, st.write_ms,
+                st.total_ms);
+    std::printf("[SSIM] Score = %.6f\n", st.ssim);
+    return 0;
+}
+
+int cmd_tune(const Options &opt)
+{
+    if (opt.positional.size() != 2)
+    {
+        usage();
+        return 2;
+    }
+
+    ps::Image src = ps::read_ppm(opt.positional[0]);
+    ps::Image tgt = ps::read_ppm(opt.positional[1]);
+
+    if (src.width != tgt.width || src.height != tgt.height)
+    {
+        throw std::runtime_error("source and target sizes differ "
+                                 "(resize the source first)");
+    }
+
+    // Rec.709, Rec.601, equal weights; grid aligned and shifted by half
+    static const int kWeights[][3] = {
+        {2126, 7152, 722}, {2990, 5870, 1140}, {3333, 3334, 3333}};
+
+    std::vector<ps_params_t> cands;
+    for (int block : opt.blocks)
+    {
+        for (const auto &w : kWeights)
+        {
+            for (int off : {0, block / 2})
+            {
+                ps_params_t p = ps_default_params();
+                p.block = block;
+                p.weights[0] = w[0];
+                p.weights[1] = w[1];
+                p.weights[2] = w[2];
+                p.offset_x = p.offset_y = off;
+                cands.push_back(p);
+            }
+        }
+    }
+
+    std::vector<ps_tune_result_t> res(cands.size());
+
+    auto t0 = std::chrono::steady_clock::now();
+    int best = ps_tune(src.rgb.data(), tgt.rgb.data(), src.width, src.height,
+                       cands.data(), static_cast<int>(cands.size()), res.data());
+    double elapsed = ms_since(t0);
+
+    if (best < 0)
+    {
+        std::fprintf(stderr, "[ERROR] tune failed: %d\n", best);
+        return 1;
+    }
+
+    std::printf("block weights          offset  ssim     pruned@row  transport_ms  ssim_ms  total_ms\n");
+    for (size_t i = 0; i < cands.size(); i++)
+    {
+        const ps_params_t &p = cands[i];
+        const ps_tune_result_t &r = res[i];
+        std::printf("%5d %4d/%4d/%4d  %6d  %.4f%s  %10s  %12.1f  %7.1f  %8.1f\n",
+                    p.block, p.weights[0], p.weights[1], p.weights[2], p.offset_x,
+                    r.ssim, r.pruned ? "<" : " ",
+                    r.pruned ? std::to_string(r.rows_done).c_str() : "-",
+                    r.transport_ms, r.ssim_ms, r.total_ms);
+    }
+
+    const ps_params_t &b = cands[best];
+    std::printf("[TUNE] best: block=%d weights=%d/%d/%d offset=%d ssim=%.4f "
+                "(%zu candidates, %d threads, %.1f ms)\n",
+                b.block, b.weights[0], b.weights[1], b.weights[2], b.offset_x,
+                res[best].ssim, cands.size(), ps_get_threads(), elapsed);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage();
+        return 2;
+    }
+
+    try
+    {
+        Options opt = parse(argc, argv, 2);
+        ps_set_threads(opt.threads);
+
+        if (std::strcmp(argv[1], "transport") == 0)
+        {
+            return cmd_transport(opt);
+        }
+        if (std::strcmp(argv[1], "stream") == 0)
+        {
+            return cmd_stream(opt);
+        }
+        if (std::strcmp(argv[1], "index") == 0)
+        {
+            return cmd_index(opt);
+        }
+        if (std::strcmp(argv[1], "tune") == 0)
+        {
+            return cmd_tune(opt);
+        }
+        if (std::strcmp(argv[1], "ssim") == 0)
+        {
+            return cmd_ssim(opt);
+        }
+
+        usage();
+        return 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "[ERROR] %s\n", e.what());
+        return 1;
+    }
+}
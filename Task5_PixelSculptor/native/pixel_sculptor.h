@@ -0,0 +1,191 @@
+#pragma once
+
+// PixelSculptor native engine ---------------------------------------------- //
+//
+// C ABI so task5.py can load the shared library with ctypes. All images are
+// tightly packed 8-bit RGB, row-major, width * height * 3 bytes.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PS_OK 0
+#define PS_ERR_ARG -1
+#define PS_ERR_NO_MEM -2
+#define PS_ERR_IO -3
+
+// Luminance weights, integer-scaled Rec.709 (0.2126, 0.7152, 0.0722).
+// Keys fit in 22 bits, which is what makes a radix sort practical.
+#define PS_LUM_WR 2126
+#define PS_LUM_WG 7152
+#define PS_LUM_WB 722
+
+// Worker threads used by every parallel call. 0 = hardware concurrency.
+void ps_set_threads(int threads);
+int ps_get_threads(void);
+
+// Block-wise luminance-rank transport: inside every block x block tile the
+// i-th darkest source pixel is written where the i-th darkest target pixel
+// is. Ties keep scan order, same as np.argsort(kind="stable").
+int ps_transport(const uint8_t *src, const uint8_t *tgt, uint8_t *out,
+                 int width, int height, int block);
+
+// Multi-scale / sliced transport ------------------------------------------- //
+
+#define PS_MAX_DIRECTIONS 12
+
+typedef struct
+{
+    // Final per-pixel tile size (the old BLOCK_SIZE)
+    int block;
+
+    // Coarse-to-fine pyramid levels, 0 = off. Level l works on cells of
+    // block << (l - 1) pixels: within every region of region x region cells,
+    // whole cells are rank-matched by mean luminance against the target's
+    // downsampled pyramid, so pixels can leave their final tile.
+    int levels;
+    int region;
+
+    // RGB projections tried per tile, 1 = luminance only. With more, each
+    // tile is rank-matched along every direction and the assignment with
+    // the lowest full-color squared error is kept.
+    int directions;
+
+    // Luminance weights, {0, 0, 0} = PS_LUM_*. Non-negative, sum <= 16384
+    // so keys stay within the radix sorter's 22 bits.
+    int weights[3];
+
+    // Final tile grid shift in [0, block): the first tile row/column is
+    // block - offset pixels tall/wide.
+    int offset_x;
+    int offset_y;
+} ps_params_t;
+
+// block = 8, levels = 0, region = 4, directions = 1, default weights,
+// no offset (== ps_transport)
+ps_params_t ps_default_params(void);
+
+int ps_transport_ex(const uint8_t *src, const uint8_t *tgt, uint8_t *out,
+                    int width, int height, const ps_params_t *params);
+
+// Auto-tuner ------------------------------------------------------------------ //
+
+typedef struct
+{
+    double ssim;          // final score, or the partial bound if pruned
+    int pruned;           // stopped early: could not beat the best
+    int rows_done;        // image rows transported before stopping
+    double transport_ms;  // time in luminance + tile transport
+    double ssim_ms;       // time in gray conversion + SSIM windows
+    double total_ms;
+} ps_tune_result_t;
+
+// Evaluates block-mode candidates (levels = 0) in parallel, one candidate
+// per worker. Each candidate is transported and scored band by band and is
+// abandoned as soon as its partial SSIM plus a perfect score for every
+// remaining window cannot beat the best finished candidate. Returns the
+// index of the best candidate, or a PS_ERR_* code.
+int ps_tune(const uint8_t *src, const uint8_t *tgt, int width, int height,
+            const ps_params_t *candidates, int count,
+            ps_tune_result_t *results);
+
+// SSIM ------------------------------------------------------------------------ //
+//
+// Same value as compute_ssim() in task5.py (OpenCV RGB2GRAY, then skimage
+// structural_similarity defaults). All functions return NaN on error or if
+// the image is smaller than the 7x7 window.
+
+typedef struct ps_ssim ps_ssim_t;
+
+// One-shot SSIM(a, b), b being the reference.
+double ps_ssim(const uint8_t *a, const uint8_t *b, int width, int height);
+
+// Reusable context: target statistics are computed once in create().
+ps_ssim_t *ps_ssim_create(const uint8_t *target_rgb, int width, int height);
+void ps_ssim_destroy(ps_ssim_t *ctx);
+
+// Scores a full image and remembers its per-window values.
+double ps_ssim_score(ps_ssim_t *ctx, const uint8_t *rgb);
+
+// After changing only the x, y, w, h rectangle of the image last passed to
+// ps_ssim_score(), re-scores just the windows that overlap it.
+double ps_ssim_update(ps_ssim_t *ctx, const uint8_t *rgb,
+                      int x, int y, int w, int h);
+
+// Target index ---------------------------------------------------------------- //
+//
+// Everything that depends only on the target: the per-tile sort orders for
+// one block-mode parameter set, the grayscale plane and the SSIM window
+// sums. Built once, then mapped read-only so every later source image only
+// pays for source-side work.
+
+#define PS_INDEX_VERSION 1
+
+typedef struct ps_index ps_index_t;
+
+// Writes the index for target_rgb and params (levels = 0, directions = 1)
+// to path, replacing it atomically. Returns PS_OK or a PS_ERR_* code.
+int ps_index_build(const uint8_t *target_rgb, int width, int height,
+                   const ps_params_t *params, const char *path);
+
+// Maps an index. Returns NULL if the file is missing, truncated, from
+// another PS_INDEX_VERSION, or does not match the given target pixels /
+// params (either may be NULL to skip that check).
+ps_index_t *ps_index_open(const char *path, const uint8_t *target_rgb,
+                          int width, int height, const ps_params_t *params);
+void ps_index_close(ps_index_t *idx);
+
+// Size and block-mode params the index was built for.
+void ps_index_info(const ps_index_t *idx, int *width, int *height,
+                   ps_params_t *params);
+
+// ps_transport_ex() with the index's params, target side read from the index.
+int ps_transport_indexed(const uint8_t *src, const ps_index_t *idx, uint8_t *out);
+
+// ps_ssim_create() from the index's gray plane and window sums. The index
+// must stay open until the context is destroyed.
+ps_ssim_t *ps_ssim_create_indexed(const ps_index_t *idx);
+
+// Streaming mode ---------------------------------------------------------------- //
+//
+// Transports images that do not fit in memory: source and target are read
+// from binary PPM files in bands of whole tile rows, the source is resized
+// to the target size on the fly (same pixels as PIL Image.BILINEAR), and
+// each finished band is written out and scored before the next is kept.
+// Reading, transport and writing/SSIM run on separate threads, so memory
+// is a few bands no matter how tall the image is.
+
+typedef struct
+{
+    int width;            // output (= target) size
+    int height;
+    int bands;
+    double ssim;          // same value as ps_ssim() on the whole output
+    double read_ms;       // busy time per stage; they overlap, so the
+    double transport_ms;  // sum is larger than total_ms
+    double write_ms;
+    double total_ms;
+    int64_t peak_bytes;   // band buffers alive at the same time
+} ps_stream_stats_t;
+
+// Called from the writer thread for every finished band, in order.
+typedef void (*ps_band_fn)(void *user, int y0, int rows, int width,
+                           const uint8_t *rgb);
+
+// levels must be 0 (pyramid levels need the whole image). out_path and
+// on_band may each be NULL; band_rows is the band height in tile rows
+// (0 = 8). Returns PS_OK, PS_ERR_ARG, PS_ERR_NO_MEM or PS_ERR_IO (missing,
+// malformed or truncated PPM, write failure).
+int ps_stream_transport(const char *src_path, const char *tgt_path,
+                        const char *out_path, const ps_params_t *params,
+                        int band_rows, ps_band_fn on_band, void *user,
+                        ps_stream_stats_t *stats);
+
+// Fills keys[width * height] with PS_LUM_* weighted luminance.
+void ps_luminance(const uint8_t *rgb, uint32_t *keys, int64_t pixels);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,133 @@
+#include "ppm.h"
+
+#include <cctype>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+namespace ps
+{
+
+namespace
+{
+
+File open_file(const std::string &path, const char *mode)
+{
+    File f(std::fopen(path.c_str(), mode), &std::fclose);
+    if (!f)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    return f;
+}
+
+// Next header integer, skipping whitespace and '#' comments
+int read_header_int(FILE *f)
+{
+    int c = std::fgetc(f);
+    for (;;)
+    {
+        while (c != EOF && std::isspace(c))
+        {
+            c = std::fgetc(f);
+        }
+        if (c != '#')
+        {
+            break;
+        }
+        while (c != EOF && c != '\n')
+        {
+            c = std::fgetc(f);
+        }
+    }
+
+    int value = 0;
+    bool any = false;
+    while (c != EOF && std::isdigit(c))
+    {
+        value = value * 10 + (c - '0');
+        any = true;
+        c = std::fgetc(f);
+    }
+
+    if (!any)
+    {
+        throw std::runtime_error("malformed PPM header");
+    }
+    return value;
+}
+
+} // namespace
+
+PpmReader::PpmReader(const std::string &path)
+    : path_(path), file_(open_file(path, "rb"))
+{
+    char magic[2];
+    if (std::fread(magic, 1, 2, file_.get()) != 2 || magic[0] != 'P' || magic[1] != '6')
+    {
+        throw std::runtime_error(path + ": not a binary PPM (P6)");
+    }
+
+    width_ = read_header_int(file_.get());
+    height_ = read_header_int(file_.get());
+    int maxval = read_header_int(file_.get());
+
+    if (width_ <= 0 || height_ <= 0 || maxval != 255)
+    {
+        throw std::runtime_error(path + ": unsupported PPM geometry/maxval");
+    }
+}
+
+void PpmReader::read_rows(uint8_t *dst, int rows)
+{
+    size_t bytes = static_cast<size_t>(rows) * width_ * 3;
+    if (std::fread(dst, 1, bytes, file_.get()) != bytes)
+    {
+        throw std::runtime_error(path_ + ": truncated pixel data");
+    }
+}
+
+PpmWriter::PpmWriter(const std::string &path, int width, int height)
+    : path_(path), file_(open_file(path, "wb")), width_(width)
+{
+    std::fprintf(file_.get(), "P6\n%d %d\n255\n", width, height);
+}
+
+void PpmWriter::write_rows(const uint8_t *src, int rows)
+{
+    size_t bytes = static_cast<size_t>(rows) * width_ * 3;
+    if (std::fwrite(src, 1, bytes, file_.get()) != bytes)
+    {
+        throw std::runtime_error("write failed: " + path_);
+    }
+}
+
+void PpmWriter::close()
+{
+    FILE *f = file_.release();
+    if (f && std::fclose(f) != 0)
+    {
+        throw std::runtime_error("write failed: " + path_);
+    }
+}
+
+Image read_ppm(const std::string &path)
+{
+    PpmReader reader(path);
+
+    Image img;
+    img.width = reader.width();
+    img.height = reader.height();
+    img.rgb.resize(static_cast<size_t>(img.width) * img.height * 3);
+    reader.read_rows(img.rgb.data(), img.height);
+    return img;
+}
+
+void write_ppm(const std::string &path, const Image &img)
+{
+    PpmWriter writer(path, img.width, img.height);
+    writer.write_rows(img.rgb.data(), img.height);
+    writer.close();
+}
+
+} // namespace ps
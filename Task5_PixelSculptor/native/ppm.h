@@ -0,0 +1,67 @@
+#pragma once
+
+// Binary PPM (P6, maxval 255) I/O for the CLI and streaming mode ---------- //
+//
+// PPM keeps the engine free of image codec dependencies; convert with
+// PIL (Image.save("x.ppm")) or any image tool. Its raw row layout is also
+// what makes band-by-band reading and writing trivial.
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ps
+{
+
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb;
+};
+
+// Throws std::runtime_error on I/O or format errors.
+Image read_ppm(const std::string &path);
+void write_ppm(const std::string &path, const Image &img);
+
+using File = std::unique_ptr<FILE, int (*)(FILE *)>;
+
+// Row-sequential reader: parses the header on open, then hands out rows in
+// order without ever holding more than the caller asks for.
+class PpmReader
+{
+public:
+    explicit PpmReader(const std::string &path);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Next `rows` rows into dst (rows * width * 3 bytes).
+    void read_rows(uint8_t *dst, int rows);
+
+private:
+    std::string path_;
+    File file_;
+    int width_ = 0, height_ = 0;
+};
+
+// Row-sequential writer; the header is written up front.
+class PpmWriter
+{
+public:
+    PpmWriter(const std::string &path, int width, int height);
+
+    void write_rows(const uint8_t *src, int rows);
+
+    // Flushes and checks for deferred write errors.
+    void close();
+
+private:
+    std::string path_;
+    File file_;
+    int width_;
+};
+
+} // namespace ps
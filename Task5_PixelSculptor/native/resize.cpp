@@ -0,0 +1,142 @@
+#include "resize.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ps
+{
+
+namespace
+{
+
+// PIL: 32 bits - 8 bits of input - 2 bits of headroom
+constexpr int kPrecisionBits = 32 - 8 - 2;
+
+double bilinear(double x)
+{
+    x = std::fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+uint8_t clip8(int32_t v)
+{
+    v >>= kPrecisionBits;
+    return static_cast<uint8_t>(std::min(255, std::max(0, v)));
+}
+
+} // namespace
+
+ResampleCoeffs bilinear_coeffs(int in_size, int out_size)
+{
+    // Mirrors precompute_coeffs() + normalize_coeffs_8bpc() in PIL's
+    // Resample.c, including the int truncations
+    const double scale = static_cast<double>(in_size) / out_size;
+    const double filterscale = std::max(scale, 1.0);
+    const double support = 1.0 * filterscale;
+
+    ResampleCoeffs c;
+    c.ksize = static_cast<int>(std::ceil(support)) * 2 + 1;
+    c.start.resize(out_size);
+    c.count.resize(out_size);
+    c.weights.assign(static_cast<size_t>(out_size) * c.ksize, 0);
+
+    std::vector<double> k(c.ksize);
+    for (int i = 0; i < out_size; i++)
+    {
+        double center = (i + 0.5) * scale;
+        int xmin = std::max(0, static_cast<int>(center - support + 0.5));
+        int xmax = std::min(in_size, static_cast<int>(center + support + 0.5)) - xmin;
+
+        double ww = 0.0;
+        for (int x = 0; x < xmax; x++)
+        {
+            k[x] = bilinear((x + xmin - center + 0.5) / filterscale);
+            ww += k[x];
+        }
+
+        for (int x = 0; x < xmax; x++)
+        {
+            double w = ww != 0.0 ? k[x] / ww : k[x];
+            double fixed = w * (1 << kPrecisionBits);
+            c.weights[static_cast<size_t>(i) * c.ksize + x] =
+                static_cast<int32_t>(w < 0 ? -0.5 + fixed : 0.5 + fixed);
+        }
+        c.start[i] = xmin;
+        c.count[i] = xmax;
+    }
+
+    return c;
+}
+
+StreamResizer::StreamResizer(PpmReader &src, int out_width, int out_height)
+    : src_(src), out_w_(out_width), out_h_(out_height),
+      hc_(bilinear_coeffs(src.width(), out_width)),
+      vc_(bilinear_coeffs(src.height(), out_height)),
+      line_(static_cast<size_t>(src.width()) * 3)
+{
+}
+
+void StreamResizer::horizontal(const uint8_t *in, uint8_t *out) const
+{
+    for (int x = 0; x < out_w_; x++)
+    {
+        const int32_t *k = &hc_.weights[static_cast<size_t>(x) * hc_.ksize];
+        const uint8_t *p = in + 3 * hc_.start[x];
+        int32_t r = 1 << (kPrecisionBits - 1), g = r, b = r;
+        for (int i = 0; i < hc_.count[x]; i++, p += 3)
+        {
+            r += p[0] * k[i];
+            g += p[1] * k[i];
+            b += p[2] * k[i];
+        }
+        out[3 * x] = clip8(r);
+        out[3 * x + 1] = clip8(g);
+        out[3 * x + 2] = clip8(b);
+    }
+}
+
+void StreamResizer::read_rows(uint8_t *dst, int rows)
+{
+    const size_t stride = static_cast<size_t>(out_w_) * 3;
+
+    for (int n = 0; n < rows; n++, next_out_++, dst += stride)
+    {
+        const int y0 = vc_.start[next_out_], taps = vc_.count[next_out_];
+
+        // Window starts never move backwards: drop rows behind it, pull
+        // source rows until it is complete (rows no window uses are read
+        // and skipped)
+        while (!rows_.empty() && first_row_ < y0)
+        {
+            rows_.pop_front();
+            first_row_++;
+        }
+        for (; next_src_ < y0 + taps; next_src_++)
+        {
+            src_.read_rows(line_.data(), 1);
+            if (next_src_ < y0)
+            {
+                continue;
+            }
+            if (rows_.empty())
+            {
+                first_row_ = next_src_;
+            }
+            rows_.emplace_back(out_w_ * 3);
+            horizontal(line_.data(), rows_.back().data());
+        }
+
+        const int32_t *k = &vc_.weights[static_cast<size_t>(next_out_) * vc_.ksize];
+        for (size_t i = 0; i < stride; i++)
+        {
+            int32_t v = 1 << (kPrecisionBits - 1);
+            for (int t = 0; t < taps; t++)
+            {
+                v += rows_[t][i] * k[t];
+            }
+            dst[i] = clip8(v);
+        }
+    }
+}
+
+} // namespace ps
@@ -0,0 +1,56 @@
+#pragma once
+
+// Streaming bilinear resize --------------------------------------------------- //
+//
+// Bit-exact with PIL's Image.resize(size, Image.BILINEAR) for RGB: the
+// same scale-dependent filter support, coefficients rounded to 22-bit fixed
+// point, a horizontal pass into 8-bit rows, then a vertical pass. Source
+// rows are pulled from the reader only as the vertical window reaches them,
+// so memory is a few rows regardless of image height.
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "ppm.h"
+
+namespace ps
+{
+
+// One separable pass: for output i, taps [start[i], start[i] + count[i])
+// with weights[i * ksize ...].
+struct ResampleCoeffs
+{
+    int ksize = 0;
+    std::vector<int> start, count;
+    std::vector<int32_t> weights;
+};
+
+ResampleCoeffs bilinear_coeffs(int in_size, int out_size);
+
+class StreamResizer
+{
+public:
+    StreamResizer(PpmReader &src, int out_width, int out_height);
+
+    int width() const { return out_w_; }
+    int height() const { return out_h_; }
+
+    // Next `rows` output rows into dst (rows * width() * 3 bytes).
+    void read_rows(uint8_t *dst, int rows);
+
+private:
+    void horizontal(const uint8_t *in, uint8_t *out) const;
+
+    PpmReader &src_;
+    int out_w_, out_h_;
+    ResampleCoeffs hc_, vc_;
+
+    int next_out_ = 0;         // next output row
+    int next_src_ = 0;         // next source row to read
+    int first_row_ = 0;        // source row held in rows_.front()
+    std::deque<std::vector<uint8_t>> rows_;  // horizontally resampled rows
+    std::vector<uint8_t> line_;              // one raw source row
+};
+
+} // namespace ps
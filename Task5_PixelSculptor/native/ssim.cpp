@@ -0,0 +1,374 @@
+#include "ssim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <new>
+
+#include "index.h"
+#include "pixel_sculptor.h"
+#include "thread_pool.h"
+#include "transport.h"
+
+namespace ps
+{
+
+namespace
+{
+
+constexpr int kN = Ssim::kWin * Ssim::kWin;
+constexpr double kCovNorm = kN / (kN - 1.0);
+constexpr double kC1 = (0.01 * 255) * (0.01 * 255);
+constexpr double kC2 = (0.03 * 255) * (0.03 * 255);
+
+// Center rows handed to one worker by score()
+constexpr int kRowsPerJob = 32;
+
+// 7-tap running sums of a and a*a over columns [c0, c0 + n + 6) for the
+// window-center rows [r0, r1); calls emit(r, sum[], sq[]) per center row
+// with n horizontal window sums.
+template <typename Emit>
+void box_sums(const uint8_t *a, int width, int r0, int r1, int c0, int n,
+              Emit emit)
+{
+    const int cols = n + Ssim::kWin - 1;
+    std::vector<int32_t> vs(cols, 0), vq(cols, 0), hs(n), hq(n);
+
+    for (int dy = 0; dy < Ssim::kWin; dy++)
+    {
+        const uint8_t *row = a + static_cast<size_t>(r0 + dy) * width + c0;
+        for (int i = 0; i < cols; i++)
+        {
+            vs[i] += row[i];
+            vq[i] += row[i] * row[i];
+        }
+    }
+
+    for (int r = r0; r < r1; r++)
+    {
+        int32_t s = 0, q = 0;
+        for (int i = 0; i < Ssim::kWin - 1; i++)
+        {
+            s += vs[i];
+            q += vq[i];
+        }
+        for (int i = 0; i < n; i++)
+        {
+            s += vs[i + Ssim::kWin - 1];
+            q += vq[i + Ssim::kWin - 1];
+            hs[i] = s;
+            hq[i] = q;
+            s -= vs[i];
+            q -= vq[i];
+        }
+
+        emit(r, hs.data(), hq.data());
+
+        if (r + 1 < r1)
+        {
+            const uint8_t *out = a + static_cast<size_t>(r) * width + c0;
+            const uint8_t *in = a + static_cast<size_t>(r + Ssim::kWin) * width + c0;
+            // Plain column loops: GCC vectorizes these at -O2 and above
+            for (int i = 0; i < cols; i++)
+            {
+                vs[i] += in[i] - out[i];
+                vq[i] += in[i] * in[i] - out[i] * out[i];
+            }
+        }
+    }
+}
+
+} // namespace
+
+void gray_plane(const uint8_t *rgb, uint8_t *gray, int64_t n)
+{
+    // OpenCV's fixed-point RGB2GRAY: 15-bit weights, round half up
+    // (checked against cv2.cvtColor for all 2^24 colors)
+    const int64_t chunk = 4096;
+    uint32_t acc[chunk];
+
+    for (int64_t i = 0; i < n; i += chunk)
+    {
+        int64_t m = std::min(chunk, n - i);
+        weighted_sum(rgb + 3 * i, acc, m, 9798, 19235, 3735);
+        for (int64_t j = 0; j < m; j++)
+        {
+            gray[i + j] = static_cast<uint8_t>((acc[j] + (1 << 14)) >> 15);
+        }
+    }
+}
+
+void Ssim::target_sums(const uint8_t *target_gray, int width, int height,
+                       int32_t *sum, int32_t *sq, bool parallel)
+{
+    const int cx = std::max(0, width - kWin + 1);
+    const int cy = std::max(0, height - kWin + 1);
+    if (cx == 0 || cy == 0)
+    {
+        return;
+    }
+
+    int64_t jobs = (cy + kRowsPerJob - 1) / kRowsPerJob;
+    for_each(jobs, parallel, [&](int64_t j) {
+        int r0 = static_cast<int>(j) * kRowsPerJob;
+        int r1 = std::min(cy, r0 + kRowsPerJob);
+        box_sums(target_gray, width, r0, r1, 0, cx,
+                 [&](int r, const int32_t *s, const int32_t *q) {
+                     std::copy(s, s + cx, sum + static_cast<size_t>(r) * cx);
+                     std::copy(q, q + cx, sq + static_cast<size_t>(r) * cx);
+                 });
+    });
+}
+
+Ssim::Ssim(const uint8_t *target_gray, int width, int height, bool parallel)
+    : width_(width), height_(height),
+      cx_(std::max(0, width - kWin + 1)), cy_(std::max(0, height - kWin + 1)),
+      tgt_(target_gray), own_sum_(windows()), own_sq_(windows()),
+      tgt_sum_(own_sum_.data()), tgt_sq_(own_sq_.data()), map_(windows(), 0.0)
+{
+    target_sums(target_gray, width, height, own_sum_.data(), own_sq_.data(),
+                parallel);
+}
+
+Ssim::Ssim(const uint8_t *target_gray, int width, int height,
+           const int32_t *target_sum, const int32_t *target_sq)
+    : width_(width), height_(height),
+      cx_(std::max(0, width - kWin + 1)), cy_(std::max(0, height - kWin + 1)),
+      tgt_(target_gray), tgt_sum_(target_sum), tgt_sq_(target_sq),
+      map_(windows(), 0.0)
+{
+}
+
+double Ssim::compute(const uint8_t *gray, int r0, int r1, int c0, int c1,
+                     double *map) const
+{
+    const int n = c1 - c0;
+    if (n <= 0 || r1 <= r0)
+    {
+        return 0.0;
+    }
+
+    // Cross term sum(x * y) gets its own running sums
+    const int cols = n + kWin - 1;
+    std::vector<int32_t> vxy(cols, 0);
+    for (int dy = 0; dy < kWin; dy++)
+    {
+        size_t off = static_cast<size_t>(r0 + dy) * width_ + c0;
+        for (int i = 0; i < cols; i++)
+        {
+            vxy[i] += gray[off + i] * tgt_[off + i];
+        }
+    }
+
+    double total = 0.0;
+
+    box_sums(gray, width_, r0, r1, c0, n,
+             [&](int r, const int32_t *sx, const int32_t *sxx) {
+                 const int32_t *sy = &tgt_sum_[static_cast<size_t>(r) * cx_ + c0];
+                 const int32_t *syy = &tgt_sq_[static_cast<size_t>(r) * cx_ + c0];
+                 double *m = map ? map + static_cast<size_t>(r) * cx_ + c0 : nullptr;
+
+                 int32_t sxy = 0;
+                 for (int i = 0; i < kWin - 1; i++)
+                 {
+                     sxy += vxy[i];
+                 }
+
+                 for (int i = 0; i < n; i++)
+                 {
+                     sxy += vxy[i + kWin - 1];
+
+                     double ux = sx[i] / double(kN), uy = sy[i] / double(kN);
+                     double vx = kCovNorm * (sxx[i] / double(kN) - ux * ux);
+                     double vy = kCovNorm * (syy[i] / double(kN) - uy * uy);
+                     double vxy_ = kCovNorm * (sxy / double(kN) - ux * uy);
+
+                     double s = ((2 * ux * uy + kC1) * (2 * vxy_ + kC2)) /
+                                ((ux * ux + uy * uy + kC1) * (vx + vy + kC2));
+                     if (m)
+                     {
+                         m[i] = s;
+                     }
+                     total += s;
+
+                     sxy -= vxy[i];
+                 }
+
+                 if (r + 1 < r1)
+                 {
+                     size_t out = static_cast<size_t>(r) * width_ + c0;
+                     size_t in = static_cast<size_t>(r + kWin) * width_ + c0;
+                     for (int i = 0; i < cols; i++)
+                     {
+                         vxy[i] += gray[in + i] * tgt_[in + i] -
+                                   gray[out + i] * tgt_[out + i];
+                     }
+                 }
+             });
+
+    return total;
+}
+
+double Ssim::rows_sum(const uint8_t *gray, int r0, int r1) const
+{
+    r0 = std::max(r0, 0);
+    r1 = std::min(r1, cy_);
+    return compute(gray, r0, r1, 0, cx_, nullptr);
+}
+
+double Ssim::score(const uint8_t *gray)
+{
+    if (windows() == 0)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    int64_t jobs = (cy_ + kRowsPerJob - 1) / kRowsPerJob;
+    std::vector<double> partial(jobs, 0.0);
+
+    pool().parallel_for(jobs, [&](int64_t j) {
+        int r0 = static_cast<int>(j) * kRowsPerJob;
+        int r1 = std::min(cy_, r0 + kRowsPerJob);
+        partial[j] = compute(gray, r0, r1, 0, cx_, map_.data());
+    });
+
+    // Fixed summation order keeps the result independent of thread count
+    total_ = 0.0;
+    for (double p : partial)
+    {
+        total_ += p;
+    }
+    return total_ / windows();
+}
+
+double Ssim::update(const uint8_t *gray, int x, int y, int w, int h)
+{
+    if (windows() == 0)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // Window with top-left (c, r) covers columns [c, c + 7): it overlaps the
+    // rectangle when c in [x - 6, x + w) (same for rows).
+    int r0 = std::max(0, y - kWin + 1), r1 = std::min(cy_, y + h);
+    int c0 = std::max(0, x - kWin + 1), c1 = std::min(cx_, x + w);
+    if (r0 >= r1 || c0 >= c1)
+    {
+        return total_ / windows();
+    }
+
+    double old_sum = 0.0;
+    for (int r = r0; r < r1; r++)
+    {
+        const double *m = &map_[static_cast<size_t>(r) * cx_];
+        for (int c = c0; c < c1; c++)
+        {
+            old_sum += m[c];
+        }
+    }
+
+    double new_sum = compute(gray, r0, r1, c0, c1, map_.data());
+    total_ += new_sum - old_sum;
+    return total_ / windows();
+}
+
+} // namespace ps
+
+// C API --------------------------------------------------------------------- //
+
+struct ps_ssim
+{
+    std::vector<uint8_t> target_gray;  // empty when read from an index
+    std::vector<uint8_t> gray;
+    ps::Ssim ssim;
+
+    ps_ssim(std::vector<uint8_t> tg, int width, int height)
+        : target_gray(std::move(tg)),
+          gray(target_gray.size()),
+          ssim(target_gray.data(), width, height)
+    {
+    }
+
+    explicit ps_ssim(const ps_index_t &idx)
+        : gray(static_cast<size_t>(idx.header->width) * idx.header->height),
+          ssim(idx.gray, idx.header->width, idx.header->height, idx.sum, idx.sq)
+    {
+    }
+};
+
+extern "C" ps_ssim_t *ps_ssim_create(const uint8_t *target_rgb, int width, int height)
+{
+    if (!target_rgb || width <= 0 || height <= 0)
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        std::vector<uint8_t> tg(static_cast<size_t>(width) * height);
+        ps::gray_plane(target_rgb, tg.data(), static_cast<int64_t>(tg.size()));
+        return new ps_ssim_t(std::move(tg), width, height);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+extern "C" ps_ssim_t *ps_ssim_create_indexed(const ps_index_t *idx)
+{
+    if (!idx)
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        return new ps_ssim_t(*idx);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+extern "C" void ps_ssim_destroy(ps_ssim_t *ctx)
+{
+    delete ctx;
+}
+
+extern "C" double ps_ssim_score(ps_ssim_t *ctx, const uint8_t *rgb)
+{
+    ps::gray_plane(rgb, ctx->gray.data(), static_cast<int64_t>(ctx->gray.size()));
+    return ctx->ssim.score(ctx->gray.data());
+}
+
+extern "C" double ps_ssim_update(ps_ssim_t *ctx, const uint8_t *rgb,
+                                 int x, int y, int w, int h)
+{
+    const int width = ctx->ssim.width();
+    x = std::max(0, x);
+    y = std::max(0, y);
+    w = std::min(w, width - x);
+    h = std::min(h, ctx->ssim.height() - y);
+
+    for (int dy = 0; dy < h; dy++)
+    {
+        size_t off = static_cast<size_t>(y + dy) * width + x;
+        ps::gray_plane(rgb + 3 * off, ctx->gray.data() + off, w);
+    }
+    return ctx->ssim.update(ctx->gray.data(), x, y, w, h);
+}
+
+extern "C" double ps_ssim(const uint8_t *a, const uint8_t *b, int width, int height)
+{
+    ps_ssim_t *ctx = ps_ssim_create(b, width, height);
+    if (!ctx)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    double score = ps_ssim_score(ctx, a);
+    ps_ssim_destroy(ctx);
+    return score;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// SSIM kernel ----------------------------------------------------------------- //
+//
+// Reproduces skimage.metrics.structural_similarity on the grayscale images
+// compute_ssim() feeds it: 7x7 uniform window, sample covariance (49/48),
+// K1 = 0.01, K2 = 0.03, data_range = 255, mean over the windows that lie
+// fully inside the image (skimage crops the 3-pixel border).
+//
+// Window sums are exact integers from separable running sums, so the only
+// difference to skimage is floating-point summation order.
+
+#include <cstdint>
+#include <vector>
+
+namespace ps
+{
+
+// cv2.cvtColor(..., COLOR_RGB2GRAY) for 8-bit input, bit exact.
+void gray_plane(const uint8_t *rgb, uint8_t *gray, int64_t n);
+
+class Ssim
+{
+public:
+    static constexpr int kWin = 7;
+
+    // Precomputes the target-side window sums once. target_gray is not
+    // copied and must outlive the object. parallel = false keeps the work
+    // on the calling thread (see for_each()).
+    Ssim(const uint8_t *target_gray, int width, int height, bool parallel = true);
+
+    // Uses window sums precomputed by target_sums() (e.g. mapped from a
+    // target index); nothing is copied, all three must outlive the object.
+    Ssim(const uint8_t *target_gray, int width, int height,
+         const int32_t *target_sum, const int32_t *target_sq);
+
+    // Per-window sum and sum of squares of target_gray, row-major with
+    // centers_x() per row, as used by the second constructor.
+    static void target_sums(const uint8_t *target_gray, int width, int height,
+                            int32_t *sum, int32_t *sq, bool parallel = true);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Window centers per row/column and in total (0 if the image is < 7 px)
+    int centers_x() const { return cx_; }
+    int centers_y() const { return cy_; }
+    int64_t windows() const { return static_cast<int64_t>(cx_) * cy_; }
+
+    // Full score; also keeps the per-window map for update().
+    double score(const uint8_t *gray);
+
+    // Re-scores only the windows overlapping the changed rectangle of
+    // `gray` (same buffer layout as passed to score()).
+    double update(const uint8_t *gray, int x, int y, int w, int h);
+
+    // Sum of SSIM over window-center rows [r0, r1), stateless.
+    double rows_sum(const uint8_t *gray, int r0, int r1) const;
+
+private:
+    // Windows with centers in rows [r0, r1) x cols [c0, c1); writes each
+    // value to map (row stride cx_, may be null) and returns their sum.
+    double compute(const uint8_t *gray, int r0, int r1, int c0, int c1,
+                   double *map) const;
+
+    int width_, height_, cx_, cy_;
+    const uint8_t *tgt_;
+    std::vector<int32_t> own_sum_, own_sq_;
+    const int32_t *tgt_sum_, *tgt_sq_;
+    std::vector<double> map_;
+    double total_ = 0.0;
+};
+
+} // namespace ps
@@ -0,0 +1,365 @@
+// Streaming band pipeline: read/resize -> transport -> write/SSIM ----------- //
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "pixel_sculptor.h"
+#include "ppm.h"
+#include "resize.h"
+#include "ssim.h"
+#include "thread_pool.h"
+#include "transport.h"
+
+namespace ps
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+double ms(Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Bands handed between two stages; push() blocks while `capacity` are
+// waiting, which is what bounds memory.
+struct Band
+{
+    int index;
+    int y0, rows;
+    std::vector<uint8_t> src, tgt, out;
+};
+
+class BandQueue
+{
+public:
+    explicit BandQueue(size_t capacity) : capacity_(capacity) {}
+
+    // False if the queue was closed (a stage failed)
+    bool push(std::unique_ptr<Band> band)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_)
+        {
+            return false;
+        }
+        items_.push_back(std::move(band));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Null once the queue is closed and drained
+    std::unique_ptr<Band> pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty())
+        {
+            return nullptr;
+        }
+        std::unique_ptr<Band> band = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return band;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+    std::deque<std::unique_ptr<Band>> items_;
+    bool closed_ = false;
+};
+
+// SSIM over a stream of bands. Windows need 7 rows, so the last 6 gray rows
+// of both images are carried into the next band: every window is scored
+// exactly once, in the first band where all of its rows are present.
+class StreamSsim
+{
+public:
+    explicit StreamSsim(int width) : width_(width) {}
+
+    void add(const uint8_t *out_rgb, const uint8_t *tgt_rgb, int rows)
+    {
+        const size_t w = width_;
+        const size_t carry = out_.size() / w;
+        out_.resize((carry + rows) * w);
+        tgt_.resize((carry + rows) * w);
+        gray_plane(out_rgb, &out_[carry * w], static_cast<int64_t>(rows) * w);
+        gray_plane(tgt_rgb, &tgt_[carry * w], static_cast<int64_t>(rows) * w);
+
+        const int total = static_cast<int>(carry) + rows;
+        if (total >= Ssim::kWin)
+        {
+            Ssim ssim(tgt_.data(), width_, total, false);
+            sum_ += ssim.rows_sum(out_.data(), 0, ssim.centers_y());
+            windows_ += ssim.windows();
+
+            size_t keep = (Ssim::kWin - 1) * w;
+            out_.erase(out_.begin(), out_.end() - keep);
+            tgt_.erase(tgt_.begin(), tgt_.end() - keep);
+        }
+    }
+
+    double score() const
+    {
+        return windows_ ? sum_ / windows_
+                        : std::numeric_limits<double>::quiet_NaN();
+    }
+
+private:
+    int width_;
+    std::vector<uint8_t> out_, tgt_;
+    double sum_ = 0.0;
+    int64_t windows_ = 0;
+};
+
+// Pipeline depth between stages
+constexpr size_t kQueueDepth = 2;
+
+int stream_transport(const char *src_path, const char *tgt_path,
+                     const char *out_path, const ps_params_t &params,
+                     int band_rows, ps_band_fn on_band, void *user,
+                     ps_stream_stats_t &stats)
+{
+    const auto start = Clock::now();
+
+    PpmReader src_file(src_path);
+    PpmReader tgt_file(tgt_path);
+    const int width = tgt_file.width(), height = tgt_file.height();
+    StreamResizer src(src_file, width, height);
+
+    std::unique_ptr<PpmWriter> writer;
+    if (out_path)
+    {
+        writer.reset(new PpmWriter(out_path, width, height));
+    }
+
+    // Bands are whole tile rows of the final grid; the first band keeps
+    // the grid offset so tiles line up with ps_transport_ex()
+    const int total_rows = tile_rows(params, height);
+    const int bands = (total_rows + band_rows - 1) / band_rows;
+
+    std::atomic<int64_t> live_bytes{0}, peak_bytes{0};
+    auto track = [&](int64_t delta) {
+        int64_t now = live_bytes += delta;
+        int64_t peak = peak_bytes.load();
+        while (now > peak && !peak_bytes.compare_exchange_weak(peak, now))
+        {
+        }
+    };
+    auto band_bytes = [&](const Band &b) {
+        return static_cast<int64_t>(b.src.capacity() + b.tgt.capacity() +
+                                    b.out.capacity());
+    };
+
+    BandQueue to_transport(kQueueDepth), to_write(kQueueDepth);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto fail = [&](std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+            {
+                error = e;
+            }
+        }
+        to_transport.close();
+        to_write.close();
+    };
+
+    Clock::duration t_read{}, t_transport{}, t_write{};
+
+    std::thread reader([&] {
+        try
+        {
+            for (int b = 0; b < bands; b++)
+            {
+                auto t = Clock::now();
+                int y0, y1, last_y0;
+                tile_row_span(params, height, b * band_rows, &y0, &last_y0);
+                tile_row_span(params, height,
+                              std::min(total_rows, (b + 1) * band_rows) - 1,
+                              &last_y0, &y1);
+
+                std::unique_ptr<Band> band(new Band{b, y0, y1 - y0, {}, {}, {}});
+                size_t bytes = static_cast<size_t>(band->rows) * width * 3;
+                band->src.resize(bytes);
+                band->tgt.resize(bytes);
+                band->out.resize(bytes);
+                track(band_bytes(*band));
+
+                src.read_rows(band->src.data(), band->rows);
+                tgt_file.read_rows(band->tgt.data(), band->rows);
+                t_read += Clock::now() - t;
+
+                if (!to_transport.push(std::move(band)))
+                {
+                    return;
+                }
+            }
+            to_transport.close();
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    });
+
+    std::thread writer_thread([&] {
+        try
+        {
+            StreamSsim ssim(width);
+            while (std::unique_ptr<Band> band = to_write.pop())
+            {
+                auto t = Clock::now();
+                if (writer)
+                {
+                    writer->write_rows(band->out.data(), band->rows);
+                }
+                ssim.add(band->out.data(), band->tgt.data(), band->rows);
+                if (on_band)
+                {
+                    on_band(user, band->y0, band->rows, width, band->out.data());
+                }
+                track(-band_bytes(*band));
+                t_write += Clock::now() - t;
+            }
+            if (writer)
+            {
+                writer->close();
+            }
+            stats.ssim = ssim.score();
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    });
+
+    // Transport runs here so it can use the pool
+    try
+    {
+        int weights[3];
+        lum_weights(params, weights);
+
+        while (std::unique_ptr<Band> band = to_transport.pop())
+        {
+            auto t = Clock::now();
+
+            ps_params_t local = params;
+            if (band->index > 0)
+            {
+                local.offset_y = 0;
+            }
+
+            std::vector<uint32_t> src_lum =
+                luminance_plane(band->src.data(), width, band->rows, weights);
+            std::vector<uint32_t> tgt_lum =
+                luminance_plane(band->tgt.data(), width, band->rows, weights);
+
+            TileJob job = {band->src.data(), src_lum.data(), band->tgt.data(),
+                           tgt_lum.data(), band->out.data(), width,
+                           band->rows, local, nullptr};
+            for_each(tile_rows(local, band->rows), true, [&](int64_t row) {
+                thread_local TileScratch scratch;
+                thread_local SlicedScratch sliced;
+                transport_tile_row(job, static_cast<int>(row), scratch, sliced);
+            });
+
+            // The source copy is not needed downstream
+            track(-static_cast<int64_t>(band->src.capacity()));
+            std::vector<uint8_t>().swap(band->src);
+            t_transport += Clock::now() - t;
+
+            if (!to_write.push(std::move(band)))
+            {
+                break;
+            }
+        }
+        to_write.close();
+    }
+    catch (...)
+    {
+        fail(std::current_exception());
+    }
+
+    reader.join();
+    writer_thread.join();
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    stats.width = width;
+    stats.height = height;
+    stats.bands = bands;
+    stats.read_ms = ms(t_read);
+    stats.transport_ms = ms(t_transport);
+    stats.write_ms = ms(t_write);
+    stats.total_ms = ms(Clock::now() - start);
+    stats.peak_bytes = peak_bytes.load();
+    return PS_OK;
+}
+
+} // namespace
+
+} // namespace ps
+
+// C API --------------------------------------------------------------------- //
+
+extern "C" int ps_stream_transport(const char *src_path, const char *tgt_path,
+                                   const char *out_path, const ps_params_t *params,
+                                   int band_rows, ps_band_fn on_band, void *user,
+                                   ps_stream_stats_t *stats)
+{
+    if (!src_path || !tgt_path || !params || band_rows < 0 ||
+        !ps::valid_params(*params) || params->levels != 0)
+    {
+        return PS_ERR_ARG;
+    }
+
+    ps_stream_stats_t local = {};
+    try
+    {
+        int rc = ps::stream_transport(src_path, tgt_path, out_path, *params,
+                                      band_rows ? band_rows : 8, on_band, user,
+                                      local);
+        if (stats)
+        {
+            *stats = local;
+        }
+        return rc;
+    }
+    catch (const std::bad_alloc &)
+    {
+        return PS_ERR_NO_MEM;
+    }
+    catch (const std::exception &)
+    {
+        return PS_ERR_IO;
+    }
+}
@@ -0,0 +1,171 @@
+#include "thread_pool.h"
+
+#include <memory>
+
+#include "pixel_sculptor.h"
+
+namespace ps
+{
+
+ThreadPool::ThreadPool(int threads)
+{
+    for (int i = 1; i < threads; i++)
+    {
+        workers_.emplace_back([this] { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto &t : workers_)
+    {
+        t.join();
+    }
+}
+
+void ThreadPool::drain()
+{
+    for (;;)
+    {
+        int64_t i = next_.fetch_add(1, std::memory_order_relaxed);
+        if (i >= job_count_)
+        {
+            return;
+        }
+        try
+        {
+            (*job_)(i);
+        }
+        catch (...)
+        {
+            // Hand out no more indices; parallel_for rethrows
+            next_.store(job_count_, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_)
+            {
+                error_ = std::current_exception();
+            }
+            return;
+        }
+    }
+}
+
+void ThreadPool::worker_loop()
+{
+    uint64_t seen = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_)
+            {
+                return;
+            }
+            seen = generation_;
+        }
+
+        drain();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_--;
+        }
+        done_.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(int64_t count,
+                              const std::function<void(int64_t)> &fn)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    if (workers_.empty() || count == 1)
+    {
+        for (int64_t i = 0; i < count; i++)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    // One job at a time; concurrent callers (e.g. several Python threads)
+    // queue up here. Nested calls from inside fn are not supported.
+    std::lock_guard<std::mutex> run(run_mutex_);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        job_count_ = count;
+        next_.store(0, std::memory_order_relaxed);
+        pending_ = static_cast<int>(workers_.size());
+        generation_++;
+    }
+    wake_.notify_all();
+
+    drain();
+
+    // Every worker checks in once per generation, even if it woke too late
+    // to find work, so no straggler can touch the next job's counter.
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return pending_ == 0; });
+    job_ = nullptr;
+
+    if (error_)
+    {
+        std::exception_ptr error = std::move(error_);
+        error_ = nullptr;
+        lock.unlock();
+        std::rethrow_exception(error);
+    }
+}
+
+// Global pool -------------------------------------------------------------- //
+
+static std::mutex g_pool_mutex;
+static std::unique_ptr<ThreadPool> g_pool;
+static int g_threads = 0;
+
+static int resolve_threads(int threads)
+{
+    if (threads > 0)
+    {
+        return threads;
+    }
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw ? static_cast<int>(hw) : 1;
+}
+
+ThreadPool &pool()
+{
+    std::lock_guard<std::mutex> lock(g_pool_mutex);
+    if (!g_pool)
+    {
+        g_pool = std::make_unique<ThreadPool>(resolve_threads(g_threads));
+    }
+    return *g_pool;
+}
+
+} // namespace ps
+
+extern "C" void ps_set_threads(int threads)
+{
+    std::lock_guard<std::mutex> lock(ps::g_pool_mutex);
+    ps::g_threads = threads;
+    ps::g_pool.reset();
+}
+
+extern "C" int ps_get_threads(void)
+{
+    return ps::pool().size();
+}
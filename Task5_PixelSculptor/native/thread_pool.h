@@ -0,0 +1,74 @@
+#pragma once
+
+// Minimal persistent thread pool ------------------------------------------- //
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ps
+{
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Runs fn(i) for i in [0, count). Indices are handed out dynamically so
+    // uneven work (edge blocks, early-terminated candidates) balances out.
+    // The calling thread participates; returns when every index is done.
+    // If fn throws, no further indices are started and the first exception
+    // is rethrown here once every thread has left fn.
+    void parallel_for(int64_t count, const std::function<void(int64_t)> &fn);
+
+private:
+    void worker_loop();
+    void drain();
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+
+    const std::function<void(int64_t)> *job_ = nullptr;
+    int64_t job_count_ = 0;
+    std::atomic<int64_t> next_{0};
+    int pending_ = 0;
+    uint64_t generation_ = 0;
+    std::exception_ptr error_;
+    bool stop_ = false;
+};
+
+// Process-wide pool sized by ps_set_threads().
+ThreadPool &pool();
+
+// fn(i) for i in [0, count), on the pool or inline on the calling thread.
+// Work that already runs inside a pool job (e.g. one tuner candidate)
+// passes parallel = false, since the pool does not nest.
+inline void for_each(int64_t count, bool parallel,
+                     const std::function<void(int64_t)> &fn)
+{
+    if (parallel)
+    {
+        pool().parallel_for(count, fn);
+        return;
+    }
+    for (int64_t i = 0; i < count; i++)
+    {
+        fn(i);
+    }
+}
+
+} // namespace ps
@@ -0,0 +1,208 @@
+#include "transport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PS_X86 1
+#endif
+
+#include "pixel_sculptor.h"
+#include "thread_pool.h"
+
+namespace ps
+{
+
+// Luminance ----------------------------------------------------------------- //
+
+static void weighted_sum_scalar(const uint8_t *rgb, uint32_t *keys, int64_t n,
+                                int wr, int wg, int wb)
+{
+    for (int64_t i = 0; i < n; i++)
+    {
+        keys[i] = wr * rgb[3 * i] + wg * rgb[3 * i + 1] + wb * rgb[3 * i + 2];
+    }
+}
+
+#ifdef PS_X86
+// 4 pixels per step: pshufb spreads RGB into 16-bit [r g b 0] lanes, pmaddwd
+// forms (wr*r + wg*g, wb*b) pairs and phaddd folds each pair into a key.
+// Weights must fit in int16.
+__attribute__((target("ssse3"))) static void
+weighted_sum_ssse3(const uint8_t *rgb, uint32_t *keys, int64_t n,
+                   int wr, int wg, int wb)
+{
+    const __m128i lo = _mm_setr_epi8(0, -1, 1, -1, 2, -1, -1, -1,
+                                     3, -1, 4, -1, 5, -1, -1, -1);
+    const __m128i hi = _mm_setr_epi8(6, -1, 7, -1, 8, -1, -1, -1,
+                                     9, -1, 10, -1, 11, -1, -1, -1);
+    const __m128i w = _mm_setr_epi16(wr, wg, wb, 0, wr, wg, wb, 0);
+
+    int64_t i = 0;
+    // 16-byte loads read 4 bytes past the 4th pixel, so stop one pixel early
+    for (; i + 6 <= n; i += 4)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgb + 3 * i));
+        __m128i a = _mm_madd_epi16(_mm_shuffle_epi8(px, lo), w);
+        __m128i b = _mm_madd_epi16(_mm_shuffle_epi8(px, hi), w);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(keys + i), _mm_hadd_epi32(a, b));
+    }
+
+    weighted_sum_scalar(rgb + 3 * i, keys + i, n - i, wr, wg, wb);
+}
+#endif
+
+void weighted_sum(const uint8_t *rgb, uint32_t *keys, int64_t n,
+                  int wr, int wg, int wb)
+{
+#ifdef PS_X86
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    if (has_ssse3)
+    {
+        weighted_sum_ssse3(rgb, keys, n, wr, wg, wb);
+        return;
+    }
+#endif
+    weighted_sum_scalar(rgb, keys, n, wr, wg, wb);
+}
+
+std::vector<uint32_t> luminance_plane(const uint8_t *rgb, int width, int height,
+                                      const int weights[3], bool parallel)
+{
+    std::vector<uint32_t> keys(static_cast<size_t>(width) * height);
+
+    const int rows_per_job = 64;
+    int64_t jobs = (height + rows_per_job - 1) / rows_per_job;
+
+    for_each(jobs, parallel, [&](int64_t j) {
+        int y0 = static_cast<int>(j) * rows_per_job;
+        int y1 = std::min(height, y0 + rows_per_job);
+        size_t off = static_cast<size_t>(y0) * width;
+        weighted_sum(rgb + 3 * off, keys.data() + off,
+                     static_cast<int64_t>(y1 - y0) * width,
+                     weights[0], weights[1], weights[2]);
+    });
+
+    return keys;
+}
+
+// Radix sort ---------------------------------------------------------------- //
+
+void RadixSorter::sort(const uint32_t *keys, uint32_t n, uint32_t *order)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    // 22-bit keys -> three 8-bit digits. All three histograms are built in
+    // one pass, and a digit that is the same for every element is skipped
+    // (common for the top digit inside a flat block).
+    uint32_t hist[3][256] = {};
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t k = keys[i];
+        hist[0][k & 0xFF]++;
+        hist[1][(k >> 8) & 0xFF]++;
+        hist[2][k >> 16]++;
+    }
+
+    key_a_.assign(keys, keys + n);
+    key_b_.resize(n);
+    idx_b_.resize(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+
+    uint32_t *ka = key_a_.data(), *kb = key_b_.data();
+    uint32_t *ia = order, *ib = idx_b_.data();
+
+    for (int d = 0; d < 3; d++)
+    {
+        uint32_t *h = hist[d];
+        int shift = 8 * d;
+
+        if (h[(ka[0] >> shift) & 0xFF] == n)
+        {
+            continue;
+        }
+
+        uint32_t sum = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            uint32_t c = h[b];
+            h[b] = sum;
+            sum += c;
+        }
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint32_t dst = h[(ka[i] >> shift) & 0xFF]++;
+            kb[dst] = ka[i];
+            ib[dst] = ia[i];
+        }
+
+        std::swap(ka, kb);
+        std::swap(ia, ib);
+    }
+
+    if (ia != order)
+    {
+        std::memcpy(order, ia, n * sizeof(uint32_t));
+    }
+}
+
+// Tile transport ------------------------------------------------------------ //
+
+void transport_tile(const uint8_t *src, const uint32_t *src_lum,
+                    const uint32_t *tgt_lum, const uint32_t *tgt_order,
+                    uint8_t *out, int width,
+                    int x0, int y0, int w, int h, TileScratch &s)
+{
+    uint32_t n = static_cast<uint32_t>(w) * h;
+    s.src_keys.resize(n);
+    s.src_order.resize(n);
+
+    for (int dy = 0; dy < h; dy++)
+    {
+        size_t row = static_cast<size_t>(y0 + dy) * width + x0;
+        std::memcpy(&s.src_keys[dy * w], src_lum + row, w * sizeof(uint32_t));
+    }
+    s.sorter.sort(s.src_keys.data(), n, s.src_order.data());
+
+    if (!tgt_order)
+    {
+        s.tgt_keys.resize(n);
+        s.tgt_order.resize(n);
+        for (int dy = 0; dy < h; dy++)
+        {
+            size_t row = static_cast<size_t>(y0 + dy) * width + x0;
+            std::memcpy(&s.tgt_keys[dy * w], tgt_lum + row, w * sizeof(uint32_t));
+        }
+        s.sorter.sort(s.tgt_keys.data(), n, s.tgt_order.data());
+        tgt_order = s.tgt_order.data();
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t si = s.src_order[i], ti = tgt_order[i];
+        size_t sp = static_cast<size_t>(y0 + si / w) * width + x0 + si % w;
+        size_t tp = static_cast<size_t>(y0 + ti / w) * width + x0 + ti % w;
+
+        out[3 * tp] = src[3 * sp];
+        out[3 * tp + 1] = src[3 * sp + 1];
+        out[3 * tp + 2] = src[3 * sp + 2];
+    }
+}
+
+} // namespace ps
+
+// C API --------------------------------------------------------------------- //
+
+extern "C" void ps_luminance(const uint8_t *rgb, uint32_t *keys, int64_t pixels)
+{
+    ps::weighted_sum(rgb, keys, pixels, PS_LUM_WR, PS_LUM_WG, PS_LUM_WB);
+}
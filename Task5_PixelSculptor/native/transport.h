@@ -0,0 +1,121 @@
+#pragma once
+
+// Internal helpers shared by the transport modes ---------------------------- //
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pixel_sculptor.h"
+
+namespace ps
+{
+
+// Stable LSD radix sort of small index sets by 22-bit luminance key.
+// Owns its scratch space so a worker can reuse it for every block.
+class RadixSorter
+{
+public:
+    // Writes into order[0..n) the indices of keys[] in ascending key order,
+    // ties broken by index.
+    void sort(const uint32_t *keys, uint32_t n, uint32_t *order);
+
+private:
+    std::vector<uint32_t> key_a_, key_b_, idx_b_;
+};
+
+// keys[i] = wr * r + wg * g + wb * b (SSSE3 when available). Weights must
+// fit in int16.
+void weighted_sum(const uint8_t *rgb, uint32_t *keys, int64_t n,
+                  int wr, int wg, int wb);
+
+// Luminance keys for a whole image, computed in row bands.
+std::vector<uint32_t> luminance_plane(const uint8_t *rgb, int width, int height,
+                                      const int weights[3], bool parallel = true);
+
+// Rank-matches one rectangular tile: the i-th darkest source pixel goes to
+// the position of the i-th darkest target pixel. tgt_order, if not null, is
+// the target tile's precomputed sort order (tile-local indices) and tgt_lum
+// is not read.
+struct TileScratch
+{
+    RadixSorter sorter;
+    std::vector<uint32_t> src_keys, tgt_keys, src_order, tgt_order;
+};
+
+void transport_tile(const uint8_t *src, const uint32_t *src_lum,
+                    const uint32_t *tgt_lum, const uint32_t *tgt_order,
+                    uint8_t *out, int width,
+                    int x0, int y0, int w, int h, TileScratch &scratch);
+
+// Sliced variant: rank-match along each of the first `directions` RGB
+// projections (direction 0 is lum_weights) and keep the assignment with the
+// lowest RGB squared error against the target tile.
+struct SlicedScratch
+{
+    RadixSorter sorter;
+    std::vector<uint32_t> src_keys, tgt_keys, src_order, tgt_order;
+    std::vector<uint32_t> best_src, best_tgt;
+};
+
+void transport_tile_sliced(const uint8_t *src, const uint8_t *tgt,
+                           uint8_t *out, int width, int x0, int y0,
+                           int w, int h, int directions, const int lum_weights[3],
+                           SlicedScratch &scratch);
+
+// One coarse pyramid level: inside each region x region group of full
+// cell x cell tiles, moves whole source cells (rgb and lum together) so
+// their mean luminance ranks match the target cell means in tgt_sums
+// (row-major, width / cell per row).
+void permute_cells(std::vector<uint8_t> &rgb, std::vector<uint32_t> &lum,
+                   const std::vector<uint64_t> &tgt_sums, int width,
+                   int height, int cell, int region, bool parallel = true);
+
+// Per-cell luminance sums of full cell x cell tiles, row-major.
+std::vector<uint64_t> cell_sums(const uint32_t *lum, int width, int height,
+                                int cell, bool parallel = true);
+
+// Final per-tile pass ------------------------------------------------------- //
+
+bool valid_params(const ps_params_t &p);
+
+// Effective luminance weights ({0, 0, 0} -> PS_LUM_*)
+void lum_weights(const ps_params_t &p, int weights[3]);
+
+// Everything the per-tile pass needs; src/src_lum are the pyramid output
+// when levels > 0. tgt_orders, if set, holds every target tile's sort order
+// back to back at tile_offset() (block mode only).
+struct TileJob
+{
+    const uint8_t *src;
+    const uint32_t *src_lum;
+    const uint8_t *tgt;
+    const uint32_t *tgt_lum;
+    uint8_t *out;
+    int width;
+    int height;
+    ps_params_t params;
+    const uint32_t *tgt_orders;
+};
+
+// Number of tile rows, counting the partial first row of an offset grid
+int tile_rows(const ps_params_t &p, int height);
+
+// Image rows [y0, y1) covered by tile row `row`
+void tile_row_span(const ps_params_t &p, int height, int row, int *y0, int *y1);
+
+// Start of the tile at (x0, y0) in a tiles-back-to-back layout: all tiles of
+// a tile row have the same height, so the rows above contribute y0 * width.
+inline size_t tile_offset(int width, int x0, int y0, int h)
+{
+    return static_cast<size_t>(y0) * width + static_cast<size_t>(h) * x0;
+}
+
+void transport_tile_row(const TileJob &job, int row, TileScratch &scratch,
+                        SlicedScratch &sliced);
+
+// Whole pipeline (pyramid levels, then per-tile pass). Throws bad_alloc.
+void run_transport(const uint8_t *src, const uint8_t *tgt, uint8_t *out,
+                   int width, int height, const ps_params_t &p, bool parallel);
+
+} // namespace ps
@@ -0,0 +1,378 @@
+// Transport pipeline: pyramid levels, sliced tiles, per-tile pass --------- //
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <numeric>
+
+#include "pixel_sculptor.h"
+#include "thread_pool.h"
+#include "transport.h"
+
+namespace ps
+{
+
+// Sliced directions ---------------------------------------------------------- //
+
+// Integer RGB projections with sum(|w|) <= 10000, so offset keys stay under
+// 22 bits and the same radix sorter applies. Entry 0 is replaced by the
+// luminance weights, which makes directions = 1 identical to the plain
+// block transport.
+static const int kDirections[PS_MAX_DIRECTIONS][3] = {
+    {0, 0, 0},
+    {10000, 0, 0},
+    {0, 10000, 0},
+    {0, 0, 10000},
+    {3333, 3333, 3334},
+    {5000, -5000, 0},
+    {0, 5000, -5000},
+    {5000, 0, -5000},
+    {5000, -2500, -2500},
+    {-2500, 5000, -2500},
+    {-2500, -2500, 5000},
+    {4000, 4000, -2000},
+};
+
+static void project(const uint8_t *rgb, int width, int x0, int y0, int w, int h,
+                    const int *dir, uint32_t *keys)
+{
+    int offset = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        if (dir[c] < 0)
+        {
+            offset -= 255 * dir[c];
+        }
+    }
+
+    for (int dy = 0; dy < h; dy++)
+    {
+        const uint8_t *p = rgb + 3 * (static_cast<size_t>(y0 + dy) * width + x0);
+        for (int dx = 0; dx < w; dx++, p += 3)
+        {
+            keys[dy * w + dx] = static_cast<uint32_t>(
+                dir[0] * p[0] + dir[1] * p[1] + dir[2] * p[2] + offset);
+        }
+    }
+}
+
+static inline size_t tile_pixel(int width, int x0, int y0, int w, uint32_t i)
+{
+    return static_cast<size_t>(y0 + static_cast<int>(i) / w) * width +
+           x0 + static_cast<int>(i) % w;
+}
+
+void transport_tile_sliced(const uint8_t *src, const uint8_t *tgt,
+                           uint8_t *out, int width, int x0, int y0,
+                           int w, int h, int directions, const int lum_weights[3],
+                           SlicedScratch &s)
+{
+    uint32_t n = static_cast<uint32_t>(w) * h;
+    s.src_keys.resize(n);
+    s.tgt_keys.resize(n);
+    s.src_order.resize(n);
+    s.tgt_order.resize(n);
+    s.best_src.resize(n);
+    s.best_tgt.resize(n);
+
+    uint64_t best_cost = UINT64_MAX;
+
+    for (int d = 0; d < directions; d++)
+    {
+        const int *dir = d == 0 ? lum_weights : kDirections[d];
+        project(src, width, x0, y0, w, h, dir, s.src_keys.data());
+        project(tgt, width, x0, y0, w, h, dir, s.tgt_keys.data());
+
+        s.sorter.sort(s.src_keys.data(), n, s.src_order.data());
+        s.sorter.sort(s.tgt_keys.data(), n, s.tgt_order.data());
+
+        uint64_t cost = 0;
+        for (uint32_t i = 0; i < n && cost < best_cost; i++)
+        {
+            const uint8_t *a = src + 3 * tile_pixel(width, x0, y0, w, s.src_order[i]);
+            const uint8_t *b = tgt + 3 * tile_pixel(width, x0, y0, w, s.tgt_order[i]);
+            for (int c = 0; c < 3; c++)
+            {
+                int diff = a[c] - b[c];
+                cost += static_cast<uint64_t>(diff * diff);
+            }
+        }
+
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            s.best_src.swap(s.src_order);
+            s.best_tgt.swap(s.tgt_order);
+        }
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        size_t sp = tile_pixel(width, x0, y0, w, s.best_src[i]);
+        size_t tp = tile_pixel(width, x0, y0, w, s.best_tgt[i]);
+        std::memcpy(out + 3 * tp, src + 3 * sp, 3);
+    }
+}
+
+// Pyramid ------------------------------------------------------------------- //
+
+std::vector<uint64_t> cell_sums(const uint32_t *lum, int width, int height,
+                                int cell, bool parallel)
+{
+    int ncx = width / cell, ncy = height / cell;
+    std::vector<uint64_t> sums(static_cast<size_t>(ncx) * ncy, 0);
+
+    for_each(ncy, parallel, [&](int64_t cy) {
+        uint64_t *row_sums = &sums[static_cast<size_t>(cy) * ncx];
+        for (int dy = 0; dy < cell; dy++)
+        {
+            const uint32_t *row = lum + (cy * cell + dy) * static_cast<size_t>(width);
+            for (int cx = 0; cx < ncx; cx++)
+            {
+                uint64_t acc = 0;
+                for (int dx = 0; dx < cell; dx++)
+                {
+                    acc += row[cx * cell + dx];
+                }
+                row_sums[cx] += acc;
+            }
+        }
+    });
+
+    return sums;
+}
+
+void permute_cells(std::vector<uint8_t> &rgb, std::vector<uint32_t> &lum,
+                   const std::vector<uint64_t> &tgt_sums, int width,
+                   int height, int cell, int region, bool parallel)
+{
+    int ncx = width / cell, ncy = height / cell;
+    if (ncx == 0 || ncy == 0)
+    {
+        return;
+    }
+
+    std::vector<uint64_t> src_sums = cell_sums(lum.data(), width, height, cell,
+                                               parallel);
+
+    // Cells are read from the untouched copy and written into rgb/lum, so
+    // partial edge cells simply stay where they are.
+    const std::vector<uint8_t> rgb_in = rgb;
+    const std::vector<uint32_t> lum_in = lum;
+
+    int nry = (ncy + region - 1) / region;
+    int nrx = (ncx + region - 1) / region;
+
+    for_each(nry, parallel, [&](int64_t ry) {
+        std::vector<int> cells, src_order, tgt_order;
+
+        for (int rx = 0; rx < nrx; rx++)
+        {
+            cells.clear();
+            for (int cy = static_cast<int>(ry) * region;
+                 cy < std::min(ncy, static_cast<int>(ry + 1) * region); cy++)
+            {
+                for (int cx = rx * region; cx < std::min(ncx, (rx + 1) * region); cx++)
+                {
+                    cells.push_back(cy * ncx + cx);
+                }
+            }
+
+            src_order.resize(cells.size());
+            tgt_order.resize(cells.size());
+            std::iota(src_order.begin(), src_order.end(), 0);
+            std::iota(tgt_order.begin(), tgt_order.end(), 0);
+
+            // At most region^2 entries: a comparison sort is fine here
+            std::stable_sort(src_order.begin(), src_order.end(), [&](int a, int b) {
+                return src_sums[cells[a]] < src_sums[cells[b]];
+            });
+            std::stable_sort(tgt_order.begin(), tgt_order.end(), [&](int a, int b) {
+                return tgt_sums[cells[a]] < tgt_sums[cells[b]];
+            });
+
+            for (size_t i = 0; i < cells.size(); i++)
+            {
+                int from = cells[src_order[i]], to = cells[tgt_order[i]];
+                if (from == to)
+                {
+                    continue;
+                }
+
+                size_t fx = static_cast<size_t>(from % ncx) * cell;
+                size_t fy = static_cast<size_t>(from / ncx) * cell;
+                size_t tx = static_cast<size_t>(to % ncx) * cell;
+                size_t ty = static_cast<size_t>(to / ncx) * cell;
+
+                for (int dy = 0; dy < cell; dy++)
+                {
+                    size_t f = (fy + dy) * width + fx;
+                    size_t t = (ty + dy) * width + tx;
+                    std::memcpy(&rgb[3 * t], &rgb_in[3 * f], 3 * cell);
+                    std::memcpy(&lum[t], &lum_in[f], cell * sizeof(uint32_t));
+                }
+            }
+        }
+    });
+}
+
+// Per-tile pass ------------------------------------------------------------- //
+
+bool valid_params(const ps_params_t &p)
+{
+    if (p.block <= 0 || p.levels < 0 || p.region < 1 || p.directions < 1 ||
+        p.directions > PS_MAX_DIRECTIONS || p.offset_x < 0 ||
+        p.offset_x >= p.block || p.offset_y < 0 || p.offset_y >= p.block)
+    {
+        return false;
+    }
+
+    int sum = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        if (p.weights[c] < 0)
+        {
+            return false;
+        }
+        sum += p.weights[c];
+    }
+    return sum <= 16384;
+}
+
+void lum_weights(const ps_params_t &p, int weights[3])
+{
+    if (p.weights[0] == 0 && p.weights[1] == 0 && p.weights[2] == 0)
+    {
+        weights[0] = PS_LUM_WR;
+        weights[1] = PS_LUM_WG;
+        weights[2] = PS_LUM_WB;
+        return;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        weights[c] = p.weights[c];
+    }
+}
+
+int tile_rows(const ps_params_t &p, int height)
+{
+    return (height + p.offset_y + p.block - 1) / p.block;
+}
+
+void tile_row_span(const ps_params_t &p, int height, int row, int *y0, int *y1)
+{
+    int start = row * p.block - p.offset_y;
+    *y0 = std::max(0, start);
+    *y1 = std::min(height, start + p.block);
+}
+
+void transport_tile_row(const TileJob &job, int row, TileScratch &scratch,
+                        SlicedScratch &sliced)
+{
+    const ps_params_t &p = job.params;
+    int y0, y1;
+    tile_row_span(p, job.height, row, &y0, &y1);
+
+    int weights[3];
+    lum_weights(p, weights);
+
+    for (int start = -p.offset_x; start < job.width; start += p.block)
+    {
+        int x0 = std::max(0, start);
+        int w = std::min(job.width, start + p.block) - x0;
+
+        if (p.directions > 1)
+        {
+            transport_tile_sliced(job.src, job.tgt, job.out, job.width, x0, y0,
+                                  w, y1 - y0, p.directions, weights, sliced);
+        }
+        else
+        {
+            const uint32_t *order =
+                job.tgt_orders
+                    ? job.tgt_orders + tile_offset(job.width, x0, y0, y1 - y0)
+                    : nullptr;
+            transport_tile(job.src, job.src_lum, job.tgt_lum, order, job.out,
+                           job.width, x0, y0, w, y1 - y0, scratch);
+        }
+    }
+}
+
+void run_transport(const uint8_t *src, const uint8_t *tgt, uint8_t *out,
+                   int width, int height, const ps_params_t &p, bool parallel)
+{
+    int weights[3];
+    lum_weights(p, weights);
+
+    std::vector<uint32_t> src_lum = luminance_plane(src, width, height, weights, parallel);
+    std::vector<uint32_t> tgt_lum = luminance_plane(tgt, width, height, weights, parallel);
+
+    // Coarse to fine: the largest cells move first, each finer level
+    // refines inside the result of the previous one.
+    std::vector<uint8_t> cur;
+    if (p.levels > 0)
+    {
+        cur.assign(src, src + 3 * static_cast<size_t>(width) * height);
+        for (int level = p.levels; level >= 1; level--)
+        {
+            int cell = p.block << (level - 1);
+            std::vector<uint64_t> tgt_sums =
+                cell_sums(tgt_lum.data(), width, height, cell, parallel);
+            permute_cells(cur, src_lum, tgt_sums, width, height, cell, p.region,
+                          parallel);
+        }
+    }
+
+    TileJob job = {p.levels > 0 ? cur.data() : src, src_lum.data(),
+                   tgt, tgt_lum.data(), out, width, height, p, nullptr};
+
+    // One job per tile row; each worker keeps its scratch across tiles
+    for_each(tile_rows(p, height), parallel, [&](int64_t row) {
+        thread_local TileScratch scratch;
+        thread_local SlicedScratch sliced;
+        transport_tile_row(job, static_cast<int>(row), scratch, sliced);
+    });
+}
+
+} // namespace ps
+
+// C API --------------------------------------------------------------------- //
+
+extern "C" ps_params_t ps_default_params(void)
+{
+    ps_params_t p = {};
+    p.block = 8;
+    p.levels = 0;
+    p.region = 4;
+    p.directions = 1;
+    return p;
+}
+
+extern "C" int ps_transport_ex(const uint8_t *src, const uint8_t *tgt, uint8_t *out,
+                               int width, int height, const ps_params_t *params)
+{
+    if (!src || !tgt || !out || !params || width <= 0 || height <= 0 ||
+        !ps::valid_params(*params))
+    {
+        return PS_ERR_ARG;
+    }
+
+    try
+    {
+        ps::run_transport(src, tgt, out, width, height, *params, true);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return PS_ERR_NO_MEM;
+    }
+
+    return PS_OK;
+}
+
+extern "C" int ps_transport(const uint8_t *src, const uint8_t *tgt, uint8_t *out,
+                            int width, int height, int block)
+{
+    ps_params_t p = ps_default_params();
+    p.block = block;
+    return ps_transport_ex(src, tgt, out, width, height, &p);
+}
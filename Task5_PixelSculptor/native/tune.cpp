@@ -0,0 +1,166 @@
+// Parallel parameter auto-tuner --------------------------------------------- //
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <new>
+#include <vector>
+
+#include "pixel_sculptor.h"
+#include "ssim.h"
+#include "thread_pool.h"
+#include "transport.h"
+
+namespace ps
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+double ms(Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Raises best to score unless something better already finished
+void publish_best(std::atomic<double> &best, double score)
+{
+    double cur = best.load();
+    while (score > cur && !best.compare_exchange_weak(cur, score))
+    {
+    }
+}
+
+// Runs on one pool worker: everything below is serial.
+void evaluate(const uint8_t *src, const uint8_t *tgt, int width, int height,
+              const ps_params_t &p, const Ssim &ssim, std::atomic<double> &best,
+              ps_tune_result_t &res)
+{
+    const auto start = Clock::now();
+    Clock::duration t_transport{}, t_ssim{};
+
+    int weights[3];
+    lum_weights(p, weights);
+
+    auto t = Clock::now();
+    std::vector<uint32_t> src_lum = luminance_plane(src, width, height, weights, false);
+    std::vector<uint32_t> tgt_lum = luminance_plane(tgt, width, height, weights, false);
+    t_transport += Clock::now() - t;
+
+    std::vector<uint8_t> out(3 * static_cast<size_t>(width) * height);
+    std::vector<uint8_t> gray(static_cast<size_t>(width) * height);
+    TileJob job = {src, src_lum.data(), tgt, tgt_lum.data(), out.data(),
+                   width, height, p, nullptr};
+    TileScratch scratch;
+    SlicedScratch sliced;
+
+    const double windows = static_cast<double>(ssim.windows());
+    double partial = 0.0;
+    int centers_done = 0;
+    int rows_done = 0;
+    bool pruned = false;
+
+    for (int row = 0; row < tile_rows(p, height); row++)
+    {
+        int y0, y1;
+        tile_row_span(p, height, row, &y0, &y1);
+
+        t = Clock::now();
+        transport_tile_row(job, row, scratch, sliced);
+        t_transport += Clock::now() - t;
+        rows_done = y1;
+
+        // Score every window whose 7 rows are now final
+        t = Clock::now();
+        size_t off = static_cast<size_t>(y0) * width;
+        gray_plane(out.data() + 3 * off, gray.data() + off,
+                   static_cast<int64_t>(y1 - y0) * width);
+
+        int centers_end = std::min(ssim.centers_y(), y1 - Ssim::kWin + 1);
+        if (centers_end > centers_done)
+        {
+            partial += ssim.rows_sum(gray.data(), centers_done, centers_end);
+            centers_done = centers_end;
+        }
+        t_ssim += Clock::now() - t;
+
+        // Upper bound: every window not scored yet is a perfect 1.0
+        double remaining = windows - static_cast<double>(centers_done) * ssim.centers_x();
+        double bound = (partial + remaining) / windows;
+        if (centers_done < ssim.centers_y() && bound <= best.load())
+        {
+            res.ssim = bound;
+            pruned = true;
+            break;
+        }
+    }
+
+    if (!pruned)
+    {
+        res.ssim = partial / windows;
+        publish_best(best, res.ssim);
+    }
+
+    res.pruned = pruned;
+    res.rows_done = rows_done;
+    res.transport_ms = ms(t_transport);
+    res.ssim_ms = ms(t_ssim);
+    res.total_ms = ms(Clock::now() - start);
+}
+
+} // namespace
+
+} // namespace ps
+
+extern "C" int ps_tune(const uint8_t *src, const uint8_t *tgt, int width, int height,
+                       const ps_params_t *candidates, int count,
+                       ps_tune_result_t *results)
+{
+    if (!src || !tgt || !candidates || !results || count <= 0 ||
+        width < ps::Ssim::kWin || height < ps::Ssim::kWin)
+    {
+        return PS_ERR_ARG;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        // Pyramid levels permute the whole image up front, which defeats
+        // band-wise early termination; tune those separately.
+        if (!ps::valid_params(candidates[i]) || candidates[i].levels != 0)
+        {
+            return PS_ERR_ARG;
+        }
+    }
+
+    try
+    {
+        // Target-side SSIM statistics are shared by every candidate
+        std::vector<uint8_t> tgt_gray(static_cast<size_t>(width) * height);
+        ps::gray_plane(tgt, tgt_gray.data(), static_cast<int64_t>(tgt_gray.size()));
+        ps::Ssim ssim(tgt_gray.data(), width, height);
+
+        std::atomic<double> best{-std::numeric_limits<double>::infinity()};
+
+        ps::pool().parallel_for(count, [&](int64_t i) {
+            ps::evaluate(src, tgt, width, height, candidates[i], ssim, best,
+                         results[i]);
+        });
+    }
+    catch (const std::bad_alloc &)
+    {
+        return PS_ERR_NO_MEM;
+    }
+
+    int best_idx = -1;
+    for (int i = 0; i < count; i++)
+    {
+        if (!results[i].pruned &&
+            (best_idx < 0 || results[i].ssim > results[best_idx].ssim))
+        {
+            best_idx = i;
+        }
+    }
+    return best_idx;
+}
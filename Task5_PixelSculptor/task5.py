@@ -1,6 +1,16 @@
+import argparse
 import base64
+import ctypes
 import json
+import os
+import queue
+import re
+import struct
+import tempfile
+import threading
 import time
+import uuid
+import zlib
 from io import BytesIO
 
 import numpy as np
@@ -13,15 +23,56 @@ import paho.mqtt.client as mqtt
 BROKER = "broker.mqttdashboard.com"
 SOURCE_TOPIC = "coralcrib/img"
 
-# Publishing later (Phase 6)
+# Phase 6: the result is published as a PNG in sequenced base64 chunks
 PUBLISH_TOPIC = "shouryadippizzachor_shouryadipchakrabortypizzachor"
+PUBLISH_CHUNK_SIZE = 4096   # base64 characters per message
+PUBLISH_WINDOW = 8          # QoS 1 messages awaiting PUBACK
+PUBLISH_QUEUE_BANDS = 4     # finished bands waiting for the encoder
 
 TARGET_IMAGE_PATH = "CrabAndLobster.jpeg"
 MQTT_TIMEOUT_SEC = 30
 BLOCK_SIZE = 8   # OT block size (critical for SSIM)
 
+# Native engine (native/, build with cmake); falls back to numpy if missing
+NATIVE_LIB_PATH = os.environ.get(
+    "PIXELSCULPTOR_LIB",
+    os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                 "native", "build", "libpixelsculptor.so"))
+NATIVE_THREADS = 0   # 0 = all cores
+
+# Target-side preprocessing cache (block sort orders + SSIM window sums),
+# rebuilt whenever the target pixels or block-mode params change
+TARGET_INDEX_PATH = os.environ.get(
+    "PIXELSCULPTOR_INDEX",
+    os.path.join(os.path.dirname(NATIVE_LIB_PATH), "target.psidx"))
+
+# Transport modes (native engine only, see ps_params_t)
+#   block   : per-tile luminance rank matching (original behaviour)
+#   pyramid : coarse-to-fine cell moves, then per-tile matching
+#   sliced  : per-tile matching along the best of several RGB projections
+TRANSPORT_MODE = "block"
+TRANSPORT_MODES = {
+    "block":          dict(levels=0, region=4, directions=1),
+    "pyramid":        dict(levels=3, region=4, directions=1),
+    "sliced":         dict(levels=0, region=4, directions=8),
+    "pyramid+sliced": dict(levels=3, region=4, directions=8),
+}
+
+# Auto-tuner grid (--tune): every block size x weight set x grid offset is
+# transported and scored in parallel; losers are abandoned early.
+TUNE_BLOCKS = [4, 6, 8, 12, 16, 24, 32]
+TUNE_WEIGHTS = {
+    "rec709": (2126, 7152, 722),
+    "rec601": (2990, 5870, 1140),
+    "equal":  (3333, 3334, 3333),
+}
+
+# Integer-scaled Rec.709 luminance (matches PS_LUM_* in pixel_sculptor.h)
+LUM_WEIGHTS = np.array([2126, 7152, 722], dtype=np.int32)
+
 # --------------------------------------
 source_image = None
+source_received_at = None   # perf_counter() when the source arrived
 
 # ---------------- MQTT CALLBACKS ----------------
 def on_connect(client, userdata, flags, rc):
@@ -29,44 +80,50 @@ def on_connect(client, userdata, flags, rc):
     client.subscribe(SOURCE_TOPIC)
     print("[MQTT] Subscribed to", SOURCE_TOPIC)
 
+# Magic bytes of common image formats: these payloads skip the JSON and
+# base64 checks. Anything else that is not base64 text also goes to PIL.
+IMAGE_MAGIC = (b"\x89PNG\r\n\x1a\n", b"\xff\xd8\xff", b"GIF8", b"BM", b"RIFF",
+               b"II*\x00", b"MM\x00*")
+BASE64_TEXT = re.compile(rb"[A-Za-z0-9+/=\s]*")
+
+def decode_source_payload(payload):
+    """Sniffs the payload once instead of trying every decoder: raw image
+    bytes, JSON {"data"|"image"|"img": base64}, or plain base64. PIL decides
+    whether the bytes are an image. Returns (image, kind); raises ValueError
+    or OSError if the payload is none of them."""
+    if payload.startswith(IMAGE_MAGIC):
+        kind, img_bytes = "raw bytes", payload
+    elif payload.lstrip()[:1] == b"{":
+        data = json.loads(payload)
+        if not isinstance(data, dict):
+            raise ValueError("JSON payload is not an object")
+        b64 = data.get("data") or data.get("image") or data.get("img")
+        if not b64:
+            raise ValueError("JSON payload without data/image/img field")
+        if not isinstance(b64, (str, bytes)):
+            raise ValueError("JSON image field is not a base64 string")
+        kind, img_bytes = "JSON base64", base64.b64decode(b64)
+    elif BASE64_TEXT.fullmatch(payload):
+        kind, img_bytes = "plain base64", base64.b64decode(payload)
+    else:
+        kind, img_bytes = "raw bytes", payload
+
+    return Image.open(BytesIO(img_bytes)).convert("RGB"), kind
+
 def on_message(client, userdata, msg):
-    global source_image
+    global source_image, source_received_at
+    received = time.perf_counter()
     print("[MQTT] RX on", msg.topic)
 
-    payload = msg.payload
-
-    # Raw image bytes (PNG/JPEG)
     try:
-        img = Image.open(BytesIO(payload)).convert("RGB")
-        source_image = img
-        print("[MQTT] Source image loaded (raw bytes):", img.size)
+        img, kind = decode_source_payload(msg.payload)
+    except (ValueError, OSError) as e:   # binascii.Error is a ValueError
+        print("[ERROR] Failed to decode source image:", e)
         return
-    except Exception:
-        pass
 
-    # JSON-wrapped base64
-    try:
-        payload_str = payload.decode("utf-8", errors="ignore")
-        data = json.loads(payload_str)
-        b64 = data.get("data") or data.get("image") or data.get("img")
-        if b64:
-            img_bytes = base64.b64decode(b64)
-            img = Image.open(BytesIO(img_bytes)).convert("RGB")
-            source_image = img
-            print("[MQTT] Source image loaded (JSON base64):", img.size)
-            return
-    except Exception:
-        pass
-
-    # Plain base64
-    try:
-        img_bytes = base64.b64decode(payload, validate=False)
-        img = Image.open(BytesIO(img_bytes)).convert("RGB")
-        source_image = img
-        print("[MQTT] Source image loaded (plain base64):", img.size)
-        return
-    except Exception as e:
-        print("[ERROR] Failed to decode source image:", e)
+    source_received_at = received
+    source_image = img
+    print(f"[MQTT] Source image loaded ({kind}):", img.size)
 
 # ---------------- BLOCK-WISE OT ----------------
 def compute_transport(source_img, target_img, block=8):
@@ -89,49 +146,525 @@ def compute_transport(source_img, target_img, block=8):
             src_flat = src_blk.reshape(-1, 3)
             tgt_flat = tgt_blk.reshape(-1, 3)
 
-            # Perceptual luminance
-            src_lum = (
-                0.2126 * src_flat[:,0] +
-                0.7152 * src_flat[:,1] +
-                0.0722 * src_flat[:,2]
-            )
-            tgt_lum = (
-                0.2126 * tgt_flat[:,0] +
-                0.7152 * tgt_flat[:,1] +
-                0.0722 * tgt_flat[:,2]
-            )
-
-            src_idx = np.argsort(src_lum)
-            tgt_idx = np.argsort(tgt_lum)
+            # Perceptual luminance (integer keys, exact and tie-stable)
+            src_lum = src_flat.astype(np.int32) @ LUM_WEIGHTS
+            tgt_lum = tgt_flat.astype(np.int32) @ LUM_WEIGHTS
+
+            src_idx = np.argsort(src_lum, kind="stable")
+            tgt_idx = np.argsort(tgt_lum, kind="stable")
 
             mapped = np.zeros_like(src_flat)
-            for s, t in zip(src_idx, tgt_idx):
-                mapped[t] = src_flat[s]
+            mapped[tgt_idx] = src_flat[src_idx]
 
             out[y:y+block, x:x+block] = mapped.reshape(h, w, 3)
 
     return out
 
+# ---------------- NATIVE ENGINE ----------------
+class PSParams(ctypes.Structure):
+    _fields_ = [("block", ctypes.c_int),
+                ("levels", ctypes.c_int),
+                ("region", ctypes.c_int),
+                ("directions", ctypes.c_int),
+                ("weights", ctypes.c_int * 3),
+                ("offset_x", ctypes.c_int),
+                ("offset_y", ctypes.c_int)]
+
+class PSTuneResult(ctypes.Structure):
+    _fields_ = [("ssim", ctypes.c_double),
+                ("pruned", ctypes.c_int),
+                ("rows_done", ctypes.c_int),
+                ("transport_ms", ctypes.c_double),
+                ("ssim_ms", ctypes.c_double),
+                ("total_ms", ctypes.c_double)]
+
+class PSStreamStats(ctypes.Structure):
+    _fields_ = [("width", ctypes.c_int),
+                ("height", ctypes.c_int),
+                ("bands", ctypes.c_int),
+                ("ssim", ctypes.c_double),
+                ("read_ms", ctypes.c_double),
+                ("transport_ms", ctypes.c_double),
+                ("write_ms", ctypes.c_double),
+                ("total_ms", ctypes.c_double),
+                ("peak_bytes", ctypes.c_int64)]
+
+# void (*)(void *user, int y0, int rows, int width, const uint8_t *rgb)
+PS_BAND_FN = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_int, ctypes.c_int,
+                              ctypes.c_int, ctypes.POINTER(ctypes.c_uint8))
+
+def make_params(block=8, levels=0, region=4, directions=1,
+                weights=(0, 0, 0), offset_x=0, offset_y=0):
+    return PSParams(block, levels, region, directions,
+                    (ctypes.c_int * 3)(*weights), offset_x, offset_y)
+
+_native = None
+
+def load_native():
+    """Load libpixelsculptor once; returns None if it is not built."""
+    global _native
+    if _native is not None:
+        return _native or None
+
+    if not os.path.exists(NATIVE_LIB_PATH):
+        print("[NATIVE] Not built, using numpy path:", NATIVE_LIB_PATH)
+        _native = False
+        return None
+
+    lib = ctypes.CDLL(NATIVE_LIB_PATH)
+    u8 = np.ctypeslib.ndpointer(np.uint8, flags="C_CONTIGUOUS")
+
+    lib.ps_set_threads.argtypes = [ctypes.c_int]
+    lib.ps_set_threads.restype = None
+    lib.ps_transport.argtypes = [u8, u8, u8,
+                                 ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.ps_transport.restype = ctypes.c_int
+    lib.ps_transport_ex.argtypes = [u8, u8, u8, ctypes.c_int, ctypes.c_int,
+                                    ctypes.POINTER(PSParams)]
+    lib.ps_transport_ex.restype = ctypes.c_int
+    lib.ps_tune.argtypes = [u8, u8, ctypes.c_int, ctypes.c_int,
+                            ctypes.POINTER(PSParams), ctypes.c_int,
+                            ctypes.POINTER(PSTuneResult)]
+    lib.ps_tune.restype = ctypes.c_int
+
+    lib.ps_index_build.argtypes = [u8, ctypes.c_int, ctypes.c_int,
+                                   ctypes.POINTER(PSParams), ctypes.c_char_p]
+    lib.ps_index_build.restype = ctypes.c_int
+    lib.ps_index_open.argtypes = [ctypes.c_char_p, u8, ctypes.c_int,
+                                  ctypes.c_int, ctypes.POINTER(PSParams)]
+    lib.ps_index_open.restype = ctypes.c_void_p
+    lib.ps_index_close.argtypes = [ctypes.c_void_p]
+    lib.ps_index_close.restype = None
+    lib.ps_transport_indexed.argtypes = [u8, ctypes.c_void_p, u8]
+    lib.ps_transport_indexed.restype = ctypes.c_int
+    lib.ps_ssim_create_indexed.argtypes = [ctypes.c_void_p]
+    lib.ps_ssim_create_indexed.restype = ctypes.c_void_p
+
+    lib.ps_stream_transport.argtypes = [ctypes.c_char_p, ctypes.c_char_p,
+                                        ctypes.c_char_p, ctypes.POINTER(PSParams),
+                                        ctypes.c_int, PS_BAND_FN, ctypes.c_void_p,
+                                        ctypes.POINTER(PSStreamStats)]
+    lib.ps_stream_transport.restype = ctypes.c_int
+
+    lib.ps_ssim.argtypes = [u8, u8, ctypes.c_int, ctypes.c_int]
+    lib.ps_ssim.restype = ctypes.c_double
+    lib.ps_ssim_create.argtypes = [u8, ctypes.c_int, ctypes.c_int]
+    lib.ps_ssim_create.restype = ctypes.c_void_p
+    lib.ps_ssim_destroy.argtypes = [ctypes.c_void_p]
+    lib.ps_ssim_destroy.restype = None
+    lib.ps_ssim_score.argtypes = [ctypes.c_void_p, u8]
+    lib.ps_ssim_score.restype = ctypes.c_double
+    lib.ps_ssim_update.argtypes = [ctypes.c_void_p, u8, ctypes.c_int,
+                                   ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.ps_ssim_update.restype = ctypes.c_double
+
+    lib.ps_set_threads(NATIVE_THREADS)
+    _native = lib
+    return lib
+
+def compute_transport_native(source_img, target_img, block=8, levels=0,
+                             region=4, directions=1, weights=(0, 0, 0),
+                             offset_x=0, offset_y=0):
+    lib = load_native()
+    if lib is None:
+        if levels or directions != 1 or any(weights) or offset_x or offset_y:
+            raise RuntimeError("these transport options need the native engine")
+        return compute_transport(source_img, target_img, block)
+
+    src = np.ascontiguousarray(np.array(source_img), dtype=np.uint8)
+    tgt = np.ascontiguousarray(np.array(target_img), dtype=np.uint8)
+    out = np.empty_like(tgt)
+
+    H, W, _ = tgt.shape
+    params = make_params(block, levels, region, directions,
+                         weights, offset_x, offset_y)
+    rc = lib.ps_transport_ex(src, tgt, out, W, H, ctypes.byref(params))
+    if rc != 0:
+        raise RuntimeError(f"ps_transport_ex failed: {rc}")
+    return out
+
+class TargetIndex:
+    """Target-side work for one block-mode parameter set, mmapped from
+    TARGET_INDEX_PATH. Each source image then only pays for its own
+    luminance and sort."""
+
+    def __init__(self, target_img, path=TARGET_INDEX_PATH, **transport_args):
+        self.lib = load_native()
+        if self.lib is None:
+            raise RuntimeError("TargetIndex needs the native engine")
+
+        tgt = np.ascontiguousarray(np.array(target_img), dtype=np.uint8)
+        self.shape = tgt.shape
+        H, W, _ = tgt.shape
+        params = make_params(**transport_args)
+        path_b = os.fsencode(path)
+
+        self.handle = self.lib.ps_index_open(path_b, tgt, W, H,
+                                             ctypes.byref(params))
+        if not self.handle:
+            t0 = time.perf_counter()
+            rc = self.lib.ps_index_build(tgt, W, H, ctypes.byref(params), path_b)
+            if rc != 0:
+                raise RuntimeError(f"ps_index_build failed: {rc}")
+            print(f"[INDEX] Built {path} in "
+                  f"{(time.perf_counter() - t0) * 1000:.1f} ms")
+            self.handle = self.lib.ps_index_open(path_b, tgt, W, H,
+                                                 ctypes.byref(params))
+            if not self.handle:
+                raise RuntimeError(f"cannot open index {path}")
+
+    def transport(self, source_img):
+        src = np.ascontiguousarray(np.array(source_img), dtype=np.uint8)
+        if src.shape != self.shape:
+            raise ValueError("source must be resized to the target first")
+        out = np.empty_like(src)
+        rc = self.lib.ps_transport_indexed(src, self.handle, out)
+        if rc != 0:
+            raise RuntimeError(f"ps_transport_indexed failed: {rc}")
+        return out
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            self.lib.ps_index_close(self.handle)
+
+# ---------------- STREAMING ----------------
+STREAM_BAND_ROWS = 8   # band height in tile rows
+
+def as_ppm(path, tmpdir):
+    """The streaming engine reads binary PPM; anything else is converted
+    once (this step does load that image fully)."""
+    if path.lower().endswith((".ppm", ".pnm")):
+        return path
+    out = os.path.join(tmpdir, os.path.splitext(os.path.basename(path))[0] + ".ppm")
+    Image.open(path).convert("RGB").save(out)
+    return out
+
+def run_stream(source_path, target_path, out_path, on_band=None,
+               band_rows=STREAM_BAND_ROWS, **transport_args):
+    """Band-by-band transport: memory stays bounded by the band height.
+    on_band(y0, rows) gets each finished band as an HxWx3 array view that
+    is only valid during the call."""
+    lib = load_native()
+    if lib is None:
+        raise RuntimeError("streaming mode needs the native engine")
+    if transport_args.get("levels"):
+        raise RuntimeError("pyramid modes need the whole image; "
+                           "use block or sliced with --stream")
+
+    def band(_user, y0, rows, width, rgb):
+        if on_band:
+            arr = np.ctypeslib.as_array(rgb, shape=(rows, width, 3))
+            on_band(y0, arr)
+
+    callback = PS_BAND_FN(band)   # must outlive the call
+    params = make_params(**transport_args)
+    stats = PSStreamStats()
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        rc = lib.ps_stream_transport(
+            os.fsencode(as_ppm(source_path, tmpdir)),
+            os.fsencode(as_ppm(target_path, tmpdir)),
+            os.fsencode(out_path) if out_path else None,
+            ctypes.byref(params), band_rows, callback, None,
+            ctypes.byref(stats))
+    if rc != 0:
+        raise RuntimeError(f"ps_stream_transport failed: {rc}")
+
+    print(f"[STREAM] {stats.width}x{stats.height} in {stats.bands} bands, "
+          f"peak {stats.peak_bytes / 2**20:.1f} MiB: read {stats.read_ms:.1f} ms, "
+          f"transport {stats.transport_ms:.1f} ms, write+ssim "
+          f"{stats.write_ms:.1f} ms, total {stats.total_ms:.1f} ms")
+    return stats
+
+# ---------------- PUBLISH (Phase 6) ----------------
+class PngStreamEncoder:
+    """Writes a PNG band by band: the header goes out immediately and every
+    band becomes IDAT data as soon as zlib produces output, so encoding
+    overlaps with the transport of later bands. Rows use the Up filter,
+    carried across band edges."""
+
+    IDAT_MIN = 16384   # batch tiny zlib outputs into larger IDAT chunks
+
+    def __init__(self, width, height, sink):
+        self.sink = sink
+        self.width = width
+        self.prev = np.zeros(width * 3, dtype=np.uint8)
+        self.zlib = zlib.compressobj(6)
+        self.pending = bytearray()
+        sink(b"\x89PNG\r\n\x1a\n")
+        self._chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 2, 0, 0, 0))
+
+    def _chunk(self, tag, data):
+        crc = zlib.crc32(data, zlib.crc32(tag))
+        self.sink(struct.pack(">I", len(data)) + tag + data + struct.pack(">I", crc))
+
+    def add_rows(self, rows):
+        flat = rows.reshape(rows.shape[0], self.width * 3)
+        up = np.empty((flat.shape[0], flat.shape[1] + 1), dtype=np.uint8)
+        up[:, 0] = 2   # filter type Up
+        up[0, 1:] = flat[0] - self.prev
+        up[1:, 1:] = flat[1:] - flat[:-1]
+        self.prev = flat[-1].copy()
+
+        self.pending += self.zlib.compress(up.tobytes())
+        if len(self.pending) >= self.IDAT_MIN:
+            self._chunk(b"IDAT", bytes(self.pending))
+            self.pending.clear()
+
+    def finish(self):
+        self.pending += self.zlib.flush()
+        self._chunk(b"IDAT", bytes(self.pending))
+        self._chunk(b"IEND", b"")
+
+class ChunkPublisher:
+    """Base64-encodes a byte stream into fixed-size QoS 1 messages
+    {"request_id", "seq", "last", "data"} on PUBLISH_TOPIC. At most
+    PUBLISH_WINDOW messages wait for their PUBACK; write() blocks beyond
+    that, which pushes back on the encoder and the transport."""
+
+    def __init__(self, client, topic, request_id,
+                 chunk_size=PUBLISH_CHUNK_SIZE, window=PUBLISH_WINDOW):
+        self.client = client
+        self.topic = topic
+        self.request_id = request_id
+        self.raw_size = chunk_size // 4 * 3   # whole base64 quanta per chunk
+        self.slots = threading.Semaphore(window)
+        self.window = window
+        self.buffer = bytearray()
+        self.seq = 0
+        self.bytes = 0
+        self.first_at = None
+        self.lock = threading.Lock()
+        self.acked = 0
+        self.closed = False
+        self.all_acked = threading.Event()
+
+        client.on_publish = self._on_publish
+
+    def _on_publish(self, client, userdata, mid, *args):
+        with self.lock:
+            self.acked += 1
+            if self.acked == self.seq and self.closed:
+                self.all_acked.set()
+        self.slots.release()
+
+    def _send(self, raw, last):
+        if not self.slots.acquire(timeout=MQTT_TIMEOUT_SEC):
+            raise TimeoutError("broker stopped acknowledging chunks")
+        payload = json.dumps({"request_id": self.request_id, "seq": self.seq,
+                              "last": last,
+                              "data": base64.b64encode(raw).decode("ascii")})
+        with self.lock:
+            self.seq += 1
+            self.closed = last
+        info = self.client.publish(self.topic, payload, qos=1)
+        if info.rc != mqtt.MQTT_ERR_SUCCESS:
+            raise RuntimeError(f"publish failed: {mqtt.error_string(info.rc)}")
+        if self.first_at is None:
+            self.first_at = time.perf_counter()
+        self.bytes += len(payload)
+
+    def write(self, data):
+        self.buffer += data
+        while len(self.buffer) > self.raw_size:
+            self._send(bytes(self.buffer[:self.raw_size]), last=False)
+            del self.buffer[:self.raw_size]
+
+    def close(self, timeout=MQTT_TIMEOUT_SEC):
+        """Sends the final chunk and waits for every PUBACK."""
+        self._send(bytes(self.buffer), last=True)
+        self.buffer.clear()
+        with self.lock:
+            if self.acked == self.seq:
+                self.all_acked.set()
+        if not self.all_acked.wait(timeout):
+            raise TimeoutError(f"{self.seq - self.acked} chunks not acknowledged")
+        return time.perf_counter()
+
+def publish_pipeline(client, width, height, produce, received_at):
+    """Runs produce(on_band), which must call on_band(y0, rows) for every
+    finished band in order, while a second thread PNG-encodes and
+    publishes the bands already done. Reports latency from received_at."""
+    request_id = uuid.uuid4().hex[:12]
+    bands = queue.Queue(maxsize=PUBLISH_QUEUE_BANDS)
+    publisher = ChunkPublisher(client, PUBLISH_TOPIC, request_id)
+    result = {}
+
+    def encode():
+        rows = ()
+        try:
+            encoder = PngStreamEncoder(width, height, publisher.write)
+            while (rows := bands.get()) is not None:
+                encoder.add_rows(rows)
+            encoder.finish()
+            result["done_at"] = publisher.close()
+        except Exception as e:
+            result["error"] = e
+            while rows is not None:   # keep draining so the producer finishes
+                rows = bands.get()
+
+    worker = threading.Thread(target=encode, name="publish")
+    worker.start()
+    t0 = time.perf_counter()
+    try:
+        # The band view is only valid during the callback
+        produce(lambda y0, rows: bands.put(rows.copy()))
+    finally:
+        bands.put(None)
+        worker.join()
+    if "error" in result:
+        raise result["error"]
+
+    done = result["done_at"]
+    print(f"[PUB] {request_id}: {publisher.seq} chunks, {publisher.bytes} bytes "
+          f"to {PUBLISH_TOPIC}")
+    print(f"[PUB] Latency from source receipt: transport start "
+          f"{(t0 - received_at) * 1000:.1f} ms, first chunk "
+          f"{(publisher.first_at - received_at) * 1000:.1f} ms, last chunk acked "
+          f"{(done - received_at) * 1000:.1f} ms")
+    return done - received_at
+
 # ---------------- SSIM ----------------
 def compute_ssim(img1, img2):
+    lib = load_native()
+    if lib is not None:
+        a = np.ascontiguousarray(np.array(img1), dtype=np.uint8)
+        b = np.ascontiguousarray(np.array(img2), dtype=np.uint8)
+        return lib.ps_ssim(a, b, a.shape[1], a.shape[0])
+
     g1 = cv2.cvtColor(np.array(img1), cv2.COLOR_RGB2GRAY)
     g2 = cv2.cvtColor(np.array(img2), cv2.COLOR_RGB2GRAY)
     return ssim(g1, g2)
 
-# ---------------- MAIN ----------------
-def main():
-    global source_image
-
-    # Load target image
-    target_img = Image.open(TARGET_IMAGE_PATH).convert("RGB")
-    print("[+] Target image loaded:", target_img.size)
+class SsimScorer:
+    """Native SSIM against a fixed target with incremental re-scoring:
+    score() a full image once, then update() after changing one region.
+    With a TargetIndex the target statistics come from the index."""
+
+    def __init__(self, target_img, index=None):
+        self.lib = load_native()
+        if self.lib is None:
+            raise RuntimeError("SsimScorer needs the native engine")
+        self.index = index   # keeps the mapping alive
+        if index is not None:
+            self.ctx = self.lib.ps_ssim_create_indexed(index.handle)
+        else:
+            tgt = np.ascontiguousarray(np.array(target_img), dtype=np.uint8)
+            self.ctx = self.lib.ps_ssim_create(tgt, tgt.shape[1], tgt.shape[0])
+
+    def score(self, arr):
+        return self.lib.ps_ssim_score(self.ctx, arr)
+
+    def update(self, arr, x, y, w, h):
+        return self.lib.ps_ssim_update(self.ctx, arr, x, y, w, h)
+
+    def __del__(self):
+        if getattr(self, "ctx", None):
+            self.lib.ps_ssim_destroy(self.ctx)
+
+# ---------------- BENCHMARK ----------------
+# (mode, swept parameter, values) -> one SSIM-vs-runtime curve per mode
+BENCH_SWEEPS = [
+    ("block",          "block",      [4, 8, 16, 32]),
+    ("pyramid",        "levels",     [1, 2, 3, 4]),
+    ("sliced",         "directions", [2, 4, 8, 12]),
+    ("pyramid+sliced", "levels",     [1, 2, 3, 4]),
+]
+
+def run_benchmark(source_img, target_img, repeats=3):
+    print("\n[BENCH] mode,param,value,ms,ssim")
+    for mode, param, values in BENCH_SWEEPS:
+        for value in values:
+            kwargs = dict(TRANSPORT_MODES[mode], block=BLOCK_SIZE)
+            kwargs[param] = value
+
+            best_ms = float("inf")
+            for _ in range(repeats):
+                t0 = time.perf_counter()
+                arr = compute_transport_native(source_img, target_img, **kwargs)
+                best_ms = min(best_ms, (time.perf_counter() - t0) * 1000)
+
+            score = compute_ssim(Image.fromarray(arr), target_img)
+            print(f"{mode},{param},{value},{best_ms:.1f},{score:.4f}")
+
+# ---------------- AUTO-TUNE ----------------
+def run_tune(source_img, target_img, blocks=TUNE_BLOCKS):
+    """Scores the whole TUNE_* grid natively and returns the winning
+    compute_transport_native() kwargs."""
+    lib = load_native()
+    if lib is None:
+        raise RuntimeError("--tune needs the native engine")
+
+    src = np.ascontiguousarray(np.array(source_img), dtype=np.uint8)
+    tgt = np.ascontiguousarray(np.array(target_img), dtype=np.uint8)
+    H, W, _ = tgt.shape
+
+    cands = []
+    for block in blocks:
+        for name, weights in TUNE_WEIGHTS.items():
+            half = block // 2
+            for ox, oy in [(0, 0), (half, 0), (0, half), (half, half)]:
+                cands.append(dict(block=block, weights=weights,
+                                  offset_x=ox, offset_y=oy))
+
+    params = (PSParams * len(cands))(*[make_params(**c) for c in cands])
+    results = (PSTuneResult * len(cands))()
+
+    t0 = time.perf_counter()
+    best = lib.ps_tune(src, tgt, W, H, params, len(cands), results)
+    elapsed = (time.perf_counter() - t0) * 1000
+    if best < 0:
+        raise RuntimeError(f"ps_tune failed: {best}")
+
+    names = {w: n for n, w in TUNE_WEIGHTS.items()}
+    print("\n[TUNE] block,weights,offset,ssim,pruned_at_row,transport_ms,ssim_ms,total_ms")
+    for c, r in zip(cands, results):
+        pruned = str(r.rows_done) if r.pruned else "-"
+        print(f"{c['block']},{names[c['weights']]},{c['offset_x']}/{c['offset_y']},"
+              f"{r.ssim:.4f},{pruned},{r.transport_ms:.1f},{r.ssim_ms:.1f},"
+              f"{r.total_ms:.1f}")
+
+    c = cands[best]
+    print(f"[TUNE] Best of {len(cands)} in {elapsed:.0f} ms: block={c['block']} "
+          f"weights={names[c['weights']]} offset={c['offset_x']}/{c['offset_y']} "
+          f"ssim={results[best].ssim:.4f}")
+    return c
 
-    # MQTT setup
+# ---------------- MAIN ----------------
+def parse_args():
+    parser = argparse.ArgumentParser(description="Task 5 PixelSculptor")
+    parser.add_argument("--source", help="read the source image from a file "
+                        "instead of waiting on " + SOURCE_TOPIC)
+    parser.add_argument("--mode", choices=sorted(TRANSPORT_MODES),
+                        default=TRANSPORT_MODE)
+    parser.add_argument("--bench", action="store_true",
+                        help="print SSIM-vs-runtime curves for every mode")
+    parser.add_argument("--tune", action="store_true",
+                        help="pick block size, luminance weights and grid "
+                        "offset by SSIM before the transport")
+    parser.add_argument("--stream", metavar="OUT.ppm",
+                        help="tiled band-by-band mode for images too large "
+                        "for memory; writes the result to OUT.ppm")
+    parser.add_argument("--broker", default=BROKER)
+    parser.add_argument("--publish", action="store_true",
+                        help="publish the result to " + PUBLISH_TOPIC +
+                        " even when the source came from --source")
+    parser.add_argument("--no-publish", action="store_true")
+    parser.add_argument("--no-show", action="store_true")
+    return parser.parse_args()
+
+def connect_mqtt(broker, subscribe=True):
     client = mqtt.Client()
-    client.on_connect = on_connect
-    client.on_message = on_message
-    client.connect(BROKER, 1883, 60)
+    client.max_inflight_messages_set(PUBLISH_WINDOW)
+    if subscribe:
+        client.on_connect = on_connect
+        client.on_message = on_message
+    client.connect(broker, 1883, 60)
     client.loop_start()
+    return client
+
+def wait_for_source_image(broker=BROKER):
+    client = connect_mqtt(broker)
 
     # Wait for source image
     print("[*] Waiting for source image...")
@@ -141,21 +674,146 @@ def main():
             raise TimeoutError("No source image received via MQTT")
         time.sleep(0.2)
 
+    return client
+
+def publish_client(args, client):
+    """The MQTT client to publish with, or None: results are published
+    when the source came over MQTT or with --publish."""
+    if args.no_publish or (client is None and not args.publish):
+        return None
+    return client or connect_mqtt(args.broker, subscribe=False)
+
+def stream_and_publish(client, source_path, out_path, transport_args,
+                       received_at):
+    """Streaming transport whose finished bands are PNG-encoded and
+    published while later bands are still being transported."""
+    stats = {}
+
+    def produce(on_band):
+        stats["run"] = run_stream(source_path, TARGET_IMAGE_PATH, out_path,
+                                  on_band=on_band, **transport_args)
+
+    with Image.open(TARGET_IMAGE_PATH) as tgt:   # header only
+        width, height = tgt.size
+    publish_pipeline(client, width, height, produce, received_at)
+    return stats["run"]
+
+def publish_array(client, arr, received_at, band=64):
+    """Fallback for results computed in one piece (numpy path, pyramid)."""
+    def produce(on_band):
+        for y in range(0, arr.shape[0], band):
+            on_band(y, arr[y:y + band])
+
+    publish_pipeline(client, arr.shape[1], arr.shape[0], produce, received_at)
+
+def main_stream(args):
+    global source_image
+    client = None
+    with tempfile.TemporaryDirectory() as tmpdir:
+        source_path = args.source
+        received_at = time.perf_counter()
+        if not source_path:
+            client = wait_for_source_image(args.broker)
+            received_at = source_received_at
+            source_path = os.path.join(tmpdir, "source.ppm")
+            source_image.save(source_path)
+
+        transport_args = dict(TRANSPORT_MODES[args.mode], block=BLOCK_SIZE)
+        pub = publish_client(args, client)
+        if pub:
+            stats = stream_and_publish(pub, source_path, args.stream,
+                                       transport_args, received_at)
+        else:
+            stats = run_stream(source_path, TARGET_IMAGE_PATH, args.stream,
+                               **transport_args)
+    print(f"[SSIM] Score = {stats.ssim:.4f}")
+    print("[+] Wrote", args.stream)
+
+    if pub:
+        pub.loop_stop()
+        pub.disconnect()
+
+def main():
+    global source_image
+    args = parse_args()
+
+    if args.stream:
+        main_stream(args)
+        return
+
+    # Load target image
+    target_img = Image.open(TARGET_IMAGE_PATH).convert("RGB")
+    print("[+] Target image loaded:", target_img.size)
+
+    client = None
+    if args.source:
+        received_at = time.perf_counter()
+        source_image = Image.open(args.source).convert("RGB")
+        print("[+] Source image loaded from file:", source_image.size)
+    else:
+        client = wait_for_source_image(args.broker)
+        received_at = source_received_at
+
     # Resize source to match target
     if source_image.size != target_img.size:
         print("[!] Resizing source image to match target")
         source_image = source_image.resize(target_img.size, Image.BILINEAR)
 
+    if args.bench:
+        run_benchmark(source_image, target_img)
+        return
+
+    transport_args = dict(TRANSPORT_MODES[args.mode], block=BLOCK_SIZE)
+    if args.tune:
+        transport_args.update(run_tune(source_image, target_img))
+
+    pub = publish_client(args, client)
+
+    # Publishing with the native engine: transport band by band and publish
+    # each band as soon as it is done
+    if pub and load_native() is not None and transport_args["levels"] == 0:
+        with tempfile.TemporaryDirectory() as tmpdir:
+            source_path = os.path.join(tmpdir, "source.ppm")
+            out_path = None if args.no_show else os.path.join(tmpdir, "out.ppm")
+            source_image.save(source_path)
+            stats = stream_and_publish(pub, source_path, out_path,
+                                       transport_args, received_at)
+            print(f"[SSIM] Score = {stats.ssim:.4f}")
+            if stats.ssim < 0.70:
+                print("[WARN] SSIM below minimum threshold")
+            else:
+                print("[OK] SSIM acceptable")
+            if out_path:
+                Image.open(out_path).show(title="Transformed Image")
+        print("[*] Phase 2-6 complete")
+        pub.loop_stop()
+        pub.disconnect()
+        return
+
+    # Block mode reuses the cached target-side work when the engine is built
+    index = None
+    if (load_native() is not None and transport_args["levels"] == 0
+            and transport_args["directions"] == 1):
+        index = TargetIndex(target_img, **transport_args)
+
     # OT transform
-    transformed_arr = compute_transport(
-        source_image,
-        target_img,
-        block=BLOCK_SIZE
-    )
+    t0 = time.time()
+    if index is not None:
+        transformed_arr = index.transport(source_image)
+    else:
+        transformed_arr = compute_transport_native(
+            source_image,
+            target_img,
+            **transport_args
+        )
+    print(f"[OT] {args.mode} transport took {(time.time() - t0) * 1000:.1f} ms")
     transformed_img = Image.fromarray(transformed_arr)
 
     # SSIM validation
-    score = compute_ssim(transformed_img, target_img)
+    if index is not None:
+        score = SsimScorer(target_img, index).score(transformed_arr)
+    else:
+        score = compute_ssim(transformed_img, target_img)
     print(f"[SSIM] Score = {score:.4f}")
 
     if score < 0.70:
@@ -164,13 +822,18 @@ def main():
         print("[OK] SSIM acceptable")
 
     # Optional visualization
-    transformed_img.show(title="Transformed Image")
+    if not args.no_show:
+        transformed_img.show(title="Transformed Image")
 
-    # (Publishing happens in Phase 6)
-    print("[*] Phase 2-5 complete")
+    if pub:
+        publish_array(pub, transformed_arr, received_at)
+        print("[*] Phase 2-6 complete")
+    else:
+        print("[*] Phase 2-5 complete")
 
-    client.loop_stop()
-    client.disconnect()
+    if pub:
+        pub.loop_stop()
+        pub.disconnect()
 
 # ---------------- RUN ----------------
 if __name__ == "__main__":
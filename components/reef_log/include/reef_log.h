@@ -0,0 +1,194 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_log.h"
+
+// Tokenized logging for hot paths.
+//
+// REEF_LOGx(TAG, fmt, ...) takes the same arguments as ESP_LOGx. In
+// tokenized builds (the default; `idf.py -DREEF_LOG_TOKENIZED=OFF build`
+// for plain text) the format string never leaves flash: the call sends the
+// address of a per-site descriptor as its token, plus the raw arguments in
+// a compact binary frame. Frames are queued without blocking and printed by
+// a low-priority task as `$<base64>` lines between the normal log output.
+// tools/reef_detokenize.py rebuilds the text from the firmware's ELF.
+//
+// - Strings are cut to REEF_LOG_MAX_STR bytes on the wire.
+// - For `%.*s` on data that isn't NUL-terminated, pass
+//   REEF_LOG_BYTES(ptr, len) as the single argument.
+// - At most 8 arguments; not for use from ISRs.
+
+#define REEF_LOG_MAX_STR 48
+
+// Logs output rates (text vs tokenized bytes/s) every this many seconds
+#define REEF_LOG_STATS_PERIOD_S 10
+
+// Starts the drain task and the byte counters; call first in app_main
+void reef_log_init(void);
+
+#if REEF_LOG_TOKENIZED
+
+#define REEF_LOG_MAGIC 0x474f4c52 // "RLOG"
+
+// Per call site, in flash; its address is the token
+typedef struct
+{
+    uint32_t magic;
+    uint8_t level;
+    uint16_t line;
+    const char *const *tag;
+    const char *format;
+    const char *file;
+} reef_log_fmt_t;
+
+enum
+{
+    REEF_LOG_ARG_INT = 1, // zigzag varint
+    REEF_LOG_ARG_UINT,    // varint
+    REEF_LOG_ARG_FLOAT,   // float32
+    REEF_LOG_ARG_STR,     // varint length, varint bytes cut off, bytes
+    REEF_LOG_ARG_PTR,     // varint
+};
+
+typedef struct
+{
+    uint8_t type;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double f;
+        struct
+        {
+            const char *ptr;
+            size_t len;
+        } s;
+    };
+} reef_log_arg_t;
+
+void reef_log_emit(const reef_log_fmt_t *fmt, int argc, const reef_log_arg_t *argv);
+
+static inline reef_log_arg_t reef_log_arg_int(int64_t v)
+{
+    return (reef_log_arg_t){.type = REEF_LOG_ARG_INT, .i = v};
+}
+
+static inline reef_log_arg_t reef_log_arg_uint(uint64_t v)
+{
+    return (reef_log_arg_t){.type = REEF_LOG_ARG_UINT, .u = v};
+}
+
+static inline reef_log_arg_t reef_log_arg_float(double v)
+{
+    return (reef_log_arg_t){.type = REEF_LOG_ARG_FLOAT, .f = v};
+}
+
+static inline reef_log_arg_t reef_log_arg_str(const char *s)
+{
+    return (reef_log_arg_t){.type = REEF_LOG_ARG_STR, .s = {s, (size_t)-1}};
+}
+
+static inline reef_log_arg_t reef_log_arg_ptr(const void *p)
+{
+    return (reef_log_arg_t){.type = REEF_LOG_ARG_PTR, .u = (uintptr_t)p};
+}
+
+static inline reef_log_arg_t reef_log_arg_pass(reef_log_arg_t arg)
+{
+    return arg;
+}
+
+#define REEF_LOG_BYTES(ptr, len)                                   \
+    ((reef_log_arg_t){.type = REEF_LOG_ARG_STR,                    \
+                      .s = {(const char *)(ptr), (size_t)(len)}})
+
+// The C type picks the wire encoding
+#define REEF_LOG_ARG(x) _Generic((x),                              \
+    _Bool: reef_log_arg_int,                                       \
+    char: reef_log_arg_int,                                        \
+    signed char: reef_log_arg_int,                                 \
+    unsigned char: reef_log_arg_int,                               \
+    short: reef_log_arg_int,                                       \
+    unsigned short: reef_log_arg_int,                              \
+    int: reef_log_arg_int,                                         \
+    long: reef_log_arg_int,                                        \
+    long long: reef_log_arg_int,                                   \
+    unsigned int: reef_log_arg_uint,                               \
+    unsigned long: reef_log_arg_uint,                              \
+    unsigned long long: reef_log_arg_uint,                         \
+    float: reef_log_arg_float,                                     \
+    double: reef_log_arg_float,                                    \
+    char *: reef_log_arg_str,                                      \
+    const char *: reef_log_arg_str,                                \
+    reef_log_arg_t: reef_log_arg_pass,                             \
+    default: reef_log_arg_ptr)(x)
+
+#define REEF_LOG_CAT_(a, b) a##b
+#define REEF_LOG_CAT(a, b) REEF_LOG_CAT_(a, b)
+#define REEF_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define REEF_LOG_NARGS(...) \
+    REEF_LOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define REEF_LOG_A(x) REEF_LOG_ARG(x)
+#define REEF_LOG_ARGS_0() 0, NULL
+#define REEF_LOG_ARGS_1(a) 1, (const reef_log_arg_t[]){REEF_LOG_A(a)}
+#define REEF_LOG_ARGS_2(a, b) \
+    2, (const reef_log_arg_t[]){REEF_LOG_A(a), REEF_LOG_A(b)}
+#define REEF_LOG_ARGS_3(a, b, c) \
+    3, (const reef_log_arg_t[]){REEF_LOG_A(a), REEF_LOG_A(b), REEF_LOG_A(c)}
+#define REEF_LOG_ARGS_4(a, b, c, d)                                      \
+    4, (const reef_log_arg_t[]){REEF_LOG_A(a), REEF_LOG_A(b), REEF_LOG_A(c), \
+                                REEF_LOG_A(d)}
+#define REEF_LOG_ARGS_5(a, b, c, d, e)                                   \
+    5, (const reef_log_arg_t[]){REEF_LOG_A(a), REEF_LOG_A(b), REEF_LOG_A(c), \
+                                REEF_LOG_A(d), REEF_LOG_A(e)}
+#define REEF_LOG_ARGS_6(a, b, c, d, e, f)                                \
+    6, (const reef_log_arg_t[]){REEF_LOG_A(a), REEF_LOG_A(b), REEF_LOG_A(c), \
+                                REEF_LOG_A(d), REEF_LOG_A(e), REEF_LOG_A(f)}
+#define REEF_LOG_ARGS_7(a, b, c, d, e, f, g)                             \
+    7, (const reef_log_arg_t[]){REEF_LOG_A(a), REEF_LOG_A(b), REEF_LOG_A(c), \
+                                REEF_LOG_A(d), REEF_LOG_A(e), REEF_LOG_A(f), \
+                                REEF_LOG_A(g)}
+#define REEF_LOG_ARGS_8(a, b, c, d, e, f, g, h)                          \
+    8, (const reef_log_arg_t[]){REEF_LOG_A(a), REEF_LOG_A(b), REEF_LOG_A(c), \
+                                REEF_LOG_A(d), REEF_LOG_A(e), REEF_LOG_A(f), \
+                                REEF_LOG_A(g), REEF_LOG_A(h)}
+
+#define REEF_LOG_AT(lvl, tag_var, fmt, ...)                                  \
+    do                                                                       \
+    {                                                                        \
+        if (LOG_LOCAL_LEVEL >= (lvl))                                        \
+        {                                                                    \
+            static const reef_log_fmt_t reef_log_site                        \
+                __attribute__((section(".rodata.reef_log"), aligned(4))) = { \
+                    .magic = REEF_LOG_MAGIC,                                 \
+                    .level = (lvl),                                          \
+                    .line = __LINE__,                                        \
+                    .tag = &(tag_var),                                       \
+                    .format = (fmt),                                         \
+                    .file = __FILE__,                                        \
+            };                                                               \
+            reef_log_emit(&reef_log_site,                                    \
+                          REEF_LOG_CAT(REEF_LOG_ARGS_,                       \
+                                       REEF_LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)); \
+        }                                                                    \
+    } while (0)
+
+#define REEF_LOGE(tag, fmt, ...) REEF_LOG_AT(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define REEF_LOGW(tag, fmt, ...) REEF_LOG_AT(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define REEF_LOGI(tag, fmt, ...) REEF_LOG_AT(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define REEF_LOGD(tag, fmt, ...) REEF_LOG_AT(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+#else
+
+// Plain ESP_LOG, so the same call sites build either way
+#define REEF_LOG_BYTES(ptr, len) (int)(len), (const char *)(ptr)
+
+#define REEF_LOGE(tag, fmt, ...) ESP_LOGE(tag, fmt, ##__VA_ARGS__)
+#define REEF_LOGW(tag, fmt, ...) ESP_LOGW(tag, fmt, ##__VA_ARGS__)
+#define REEF_LOGI(tag, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#define REEF_LOGD(tag, fmt, ...) ESP_LOGD(tag, fmt, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,277 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "reef_log.h"
+#include "reef_mem.h"
+
+#if REEF_LOG_TOKENIZED
+#include "freertos/ringbuf.h"
+
+#include "esp_app_desc.h"
+#include "mbedtls/base64.h"
+#endif
+
+static const char *TAG = "REEF_LOG";
+
+// Output accounting ---------------------------------------------------------- //
+// Text = everything through esp_log; tokenized = the `$...` lines
+static vprintf_like_t text_vprintf;
+static uint32_t text_bytes = 0;
+static uint32_t token_bytes = 0;
+static uint32_t token_frames = 0;
+static uint32_t token_dropped = 0;
+
+static int counting_vprintf(const char *fmt, va_list args)
+{
+    int n = text_vprintf(fmt, args);
+    if (n > 0)
+    {
+        __atomic_fetch_add(&text_bytes, n, __ATOMIC_RELAXED);
+    }
+    return n;
+}
+
+static void report_rates(int64_t *last_us)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t ms = (now - *last_us) / 1000;
+    *last_us = now;
+    if (ms == 0)
+    {
+        return;
+    }
+
+    uint32_t text = __atomic_exchange_n(&text_bytes, 0, __ATOMIC_RELAXED);
+    uint32_t token = __atomic_exchange_n(&token_bytes, 0, __ATOMIC_RELAXED);
+    uint32_t frames = __atomic_exchange_n(&token_frames, 0, __ATOMIC_RELAXED);
+    uint32_t dropped = __atomic_exchange_n(&token_dropped, 0, __ATOMIC_RELAXED);
+
+    // Counted in the next window, like every other text line
+    ESP_LOGI(TAG, "log output: text %lu B/s, tokenized %lu B/s (%lu frames, %lu dropped)",
+             (unsigned long)(text * 1000ULL / ms), (unsigned long)(token * 1000ULL / ms),
+             (unsigned long)frames, (unsigned long)dropped);
+}
+
+#if REEF_LOG_TOKENIZED
+
+// Frames --------------------------------------------------------------------- //
+// <u32 token> <varint ms> <u8 argc | 0x80 if cut short> <args...>
+// Token 0 carries the first 8 bytes of the app ELF's SHA-256 instead.
+#define MAX_FRAME 160
+#define RING_BYTES 4096
+
+static RingbufHandle_t frames;
+
+#if REEF_STATIC_ALLOC
+REEF_ARENA_STORAGE(log_ring, RING_BYTES);
+static StaticRingbuffer_t ring_control;
+#endif
+
+REEF_TASK_STORAGE(log_drain, 3072);
+
+static uint8_t *put_varint(uint8_t *p, const uint8_t *end, uint64_t v)
+{
+    while (p < end)
+    {
+        uint8_t b = v & 0x7f;
+        v >>= 7;
+        *p++ = v ? (b | 0x80) : b;
+        if (!v)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static uint8_t *put_arg(uint8_t *p, const uint8_t *end, const reef_log_arg_t *arg)
+{
+    if (end - p < 1)
+    {
+        return NULL;
+    }
+    *p++ = arg->type;
+
+    switch (arg->type)
+    {
+    case REEF_LOG_ARG_INT:
+        // zigzag: small negatives stay short
+        return put_varint(p, end, ((uint64_t)arg->i << 1) ^ (uint64_t)(arg->i >> 63));
+
+    case REEF_LOG_ARG_UINT:
+    case REEF_LOG_ARG_PTR:
+        return put_varint(p, end, arg->u);
+
+    case REEF_LOG_ARG_FLOAT:
+    {
+        float f = arg->f;
+        if (end - p < (ptrdiff_t)sizeof(f))
+        {
+            return NULL;
+        }
+        memcpy(p, &f, sizeof(f));
+        return p + sizeof(f);
+    }
+
+    case REEF_LOG_ARG_STR:
+    {
+        const char *s = arg->s.ptr ? arg->s.ptr : "";
+        size_t len = arg->s.len == (size_t)-1 ? strnlen(s, 0xffff) : arg->s.len;
+        size_t keep = len < REEF_LOG_MAX_STR ? len : REEF_LOG_MAX_STR;
+
+        p = put_varint(p, end, keep);
+        p = p ? put_varint(p, end, len - keep) : NULL;
+        if (!p || (size_t)(end - p) < keep)
+        {
+            return NULL;
+        }
+        memcpy(p, s, keep);
+        return p + keep;
+    }
+
+    default:
+        return NULL;
+    }
+}
+
+void reef_log_emit(const reef_log_fmt_t *fmt, int argc, const reef_log_arg_t *argv)
+{
+    uint8_t frame[MAX_FRAME];
+    const uint8_t *end = frame + sizeof(frame);
+
+    uint32_t token = (uint32_t)(uintptr_t)fmt;
+    memcpy(frame, &token, sizeof(token));
+    uint8_t *p = put_varint(frame + sizeof(token), end, esp_log_timestamp());
+
+    uint8_t *count = p++;
+    *count = 0;
+
+    // Whatever fits; the host marks the line as cut
+    for (int i = 0; i < argc; i++)
+    {
+        uint8_t *next = put_arg(p, end, &argv[i]);
+        if (!next)
+        {
+            *count |= 0x80;
+            break;
+        }
+        p = next;
+        (*count)++;
+    }
+
+    if (!frames || xRingbufferSend(frames, frame, p - frame, 0) != pdTRUE)
+    {
+        __atomic_fetch_add(&token_dropped, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void write_frame(const uint8_t *frame, size_t len)
+{
+    char line[2 + (MAX_FRAME + 2) / 3 * 4 + 1];
+    size_t out = 0;
+
+    line[0] = '$';
+    mbedtls_base64_encode((unsigned char *)line + 1, sizeof(line) - 2, &out,
+                          frame, len);
+    line[1 + out] = '\n';
+
+    fwrite(line, 1, out + 2, stdout);
+    token_bytes += out + 2;
+    token_frames++;
+}
+
+static void send_build_id(void)
+{
+    uint8_t frame[sizeof(uint32_t) + 8] = {0};
+    memcpy(frame + sizeof(uint32_t), esp_app_get_description()->app_elf_sha256, 8);
+    write_frame(frame, sizeof(frame));
+}
+
+static void drain_task(void *arg)
+{
+    int64_t last_report = esp_timer_get_time();
+    TickType_t period = pdMS_TO_TICKS(REEF_LOG_STATS_PERIOD_S * 1000);
+    TickType_t next = xTaskGetTickCount() + period;
+
+    send_build_id();
+
+    while (1)
+    {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = (int32_t)(next - now) > 0 ? next - now : 0;
+
+        size_t len;
+        uint8_t *frame = xRingbufferReceive(frames, &len, wait);
+        if (frame)
+        {
+            write_frame(frame, len);
+            vRingbufferReturnItem(frames, frame);
+        }
+
+        if ((int32_t)(xTaskGetTickCount() - next) >= 0)
+        {
+            fflush(stdout);
+            report_rates(&last_report);
+            next += period;
+            send_build_id(); // lets a late-attached reader check its ELF
+        }
+    }
+}
+
+void reef_log_init(void)
+{
+    if (text_vprintf)
+    {
+        return;
+    }
+
+    text_vprintf = esp_log_set_vprintf(counting_vprintf);
+
+#if REEF_STATIC_ALLOC
+    frames = xRingbufferCreateStatic(RING_BYTES, RINGBUF_TYPE_NOSPLIT,
+                                     REEF_ARENA(log_ring), &ring_control);
+#else
+    frames = xRingbufferCreate(RING_BYTES, RINGBUF_TYPE_NOSPLIT);
+#endif
+    if (!frames)
+    {
+        ESP_LOGE(TAG, "No memory for the frame ring, tokenized lines dropped");
+        return;
+    }
+    REEF_TASK_CREATE(log_drain, drain_task, "reef_log", NULL, 1, REEF_CORE_BACKGROUND);
+}
+
+#else
+
+REEF_TASK_STORAGE(log_stats, 2048);
+
+static void stats_task(void *arg)
+{
+    int64_t last_report = esp_timer_get_time();
+
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(REEF_LOG_STATS_PERIOD_S * 1000));
+        report_rates(&last_report);
+    }
+}
+
+void reef_log_init(void)
+{
+    if (text_vprintf)
+    {
+        return;
+    }
+
+    text_vprintf = esp_log_set_vprintf(counting_vprintf);
+    REEF_TASK_CREATE(log_stats, stats_task, "reef_log", NULL, 1, REEF_CORE_BACKGROUND);
+}
+
+#endif
@@ -0,0 +1,299 @@
+"""Turn reef_log `$<base64>` lines back into text.
+
+    # from a saved console log
+    python3 reef_detokenize.py build/Task4_Steganography.elf < console.log
+
+    # straight from the board (needs pyserial)
+    python3 reef_detokenize.py build/Task4_Steganography.elf --port /dev/ttyUSB0
+
+    # every tokenized call site in the firmware
+    python3 reef_detokenize.py build/Task4_Steganography.elf --list
+
+Text lines pass through unchanged. On exit, the bytes read are compared
+with the bytes the same output would have taken as text.
+
+The token is the address of a reef_log_fmt_t descriptor in flash; its
+format string, tag and file are read from the ELF, so the ELF must be the
+one that is running (checked against the build ID frame when it arrives).
+"""
+import argparse
+import base64
+import binascii
+import hashlib
+import re
+import struct
+import sys
+
+LEVELS = {1: "E", 2: "W", 3: "I", 4: "D", 5: "V"}
+ARG_INT, ARG_UINT, ARG_FLOAT, ARG_STR, ARG_PTR = range(1, 6)
+MAGIC = 0x474F4C52
+DESCRIPTOR = struct.Struct("<IBxHIII")
+
+SPEC = re.compile(r"%(?P<flags>[-+ #0]*)(?P<width>\*|\d+)?(?:\.(?P<prec>\*|\d*))?"
+                  r"(?P<length>hh|h|ll|l|j|z|t|L)?(?P<conv>[diouxXeEfFgGcsp%])")
+
+
+# ELF ------------------------------------------------------------------------ #
+class Elf:
+    """Just enough ELF32 to read initialised memory by address"""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        self.sha256 = hashlib.sha256(self.data).digest()
+
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+            sys.exit(f"{path}: not a 32-bit ELF")
+
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            (_, sh_type, flags, addr, offset, size) = struct.unpack_from(
+                "<IIIIII", self.data, shoff + i * shentsize)
+            # PROGBITS with SHF_ALLOC: loaded and backed by file contents
+            if sh_type == 1 and flags & 0x2 and addr:
+                self.sections.append((addr, size, offset))
+
+    def read(self, addr, size):
+        for base, length, offset in self.sections:
+            if base <= addr and addr + size <= base + length:
+                start = offset + addr - base
+                return self.data[start:start + size]
+        return None
+
+    def cstring(self, addr, limit=512):
+        for base, length, offset in self.sections:
+            if base <= addr < base + length:
+                start = offset + addr - base
+                end = self.data.find(b"\0", start, offset + length)
+                end = end if end >= 0 else start + limit
+                return self.data[start:min(end, start + limit)].decode(errors="replace")
+        return None
+
+    def descriptor(self, token):
+        raw = self.read(token, DESCRIPTOR.size)
+        if not raw:
+            return None
+        magic, level, line, tag_ptr, fmt_ptr, file_ptr = DESCRIPTOR.unpack(raw)
+        if magic != MAGIC:
+            return None
+
+        tag_raw = self.read(tag_ptr, 4)
+        tag = self.cstring(struct.unpack("<I", tag_raw)[0]) if tag_raw else None
+        return {
+            "level": LEVELS.get(level, "?"),
+            "line": line,
+            "tag": tag or "?",
+            "format": self.cstring(fmt_ptr) or "",
+            "file": self.cstring(file_ptr) or "?",
+        }
+
+    def descriptors(self):
+        for base, length, offset in self.sections:
+            blob = self.data[offset:offset + length]
+            for pos in range(0, length - DESCRIPTOR.size + 1, 4):
+                if struct.unpack_from("<I", blob, pos)[0] == MAGIC:
+                    d = self.descriptor(base + pos)
+                    if d:
+                        yield base + pos, d
+
+
+# Frames --------------------------------------------------------------------- #
+def varint(buf, pos):
+    value = shift = 0
+    while True:
+        b = buf[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def parse_frame(frame):
+    token, = struct.unpack_from("<I", frame, 0)
+    if token == 0:
+        return token, 0, frame[4:12], False
+
+    ms, pos = varint(frame, 4)
+    count = frame[pos]
+    pos += 1
+    args = []
+    for _ in range(count & 0x7F):
+        kind = frame[pos]
+        pos += 1
+        if kind == ARG_INT:
+            v, pos = varint(frame, pos)
+            args.append((kind, (v >> 1) ^ -(v & 1)))
+        elif kind in (ARG_UINT, ARG_PTR):
+            v, pos = varint(frame, pos)
+            args.append((kind, v))
+        elif kind == ARG_FLOAT:
+            args.append((kind, struct.unpack_from("<f", frame, pos)[0]))
+            pos += 4
+        elif kind == ARG_STR:
+            keep, pos = varint(frame, pos)
+            cut, pos = varint(frame, pos)
+            args.append((kind, (frame[pos:pos + keep].decode(errors="replace"), cut)))
+            pos += keep
+        else:
+            raise ValueError(f"unknown argument type {kind}")
+    return token, ms, args, bool(count & 0x80)
+
+
+def render(fmt, args, cut_short):
+    """printf over typed arguments, tolerant of size mismatches"""
+    args = list(args)
+
+    def take():
+        return args.pop(0) if args else None
+
+    def number(arg):
+        if arg is None:
+            return 0
+        kind, v = arg
+        if kind == ARG_STR:
+            return 0
+        return v
+
+    def expand(m):
+        if m.group("conv") == "%":
+            return "%"
+
+        flags, conv = m.group("flags"), m.group("conv")
+        width, prec = m.group("width"), m.group("prec")
+
+        if width == "*":
+            width = str(number(take()))
+
+        # %.*s with REEF_LOG_BYTES: one string argument covers both
+        if prec == "*":
+            if conv == "s" and args and args[0][0] == ARG_STR:
+                prec = None
+            else:
+                prec = str(number(take()))
+
+        arg = take()
+        if arg is None:
+            return "<?>"
+        kind, value = arg
+
+        spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+        if conv == "s":
+            text, cut = value if kind == ARG_STR else (str(value), 0)
+            out = (spec + "s") % text
+            return out + (f"...(+{cut})" if cut else "")
+        if conv == "p":
+            return "0x%08x" % value
+        if conv == "c":
+            return chr(value & 0xFF)
+        if conv in "eEfFgG":
+            return (spec + conv) % float(value)
+        if conv in "di":
+            return (spec + "d") % int(value)
+        if conv == "u":
+            return (spec + "d") % (int(value) & 0xFFFFFFFFFFFFFFFF)
+        return (spec + conv) % (int(value) & 0xFFFFFFFFFFFFFFFF)
+
+    try:
+        text = SPEC.sub(expand, fmt)
+    except (TypeError, ValueError) as err:
+        text = f"{fmt} <bad args: {err}>"
+    return text + (" <cut>" if cut_short else "")
+
+
+class Detokenizer:
+    def __init__(self, elf):
+        self.elf = elf
+        self.cache = {}
+        self.bytes_in = 0
+        self.bytes_text = 0
+        self.frames = 0
+        self.unknown = 0
+
+    def line(self, raw):
+        self.bytes_in += len(raw) + 1
+        if not raw.startswith("$"):
+            self.bytes_text += len(raw) + 1
+            return raw
+
+        try:
+            frame = base64.b64decode(raw[1:], validate=True)
+            token, ms, args, cut = parse_frame(frame)
+        except (binascii.Error, ValueError, IndexError, struct.error):
+            self.bytes_text += len(raw) + 1
+            return raw
+
+        if token == 0:
+            if args != self.elf.sha256[:8]:
+                print("reef_detokenize: build ID does not match this ELF", file=sys.stderr)
+            return None
+
+        if token not in self.cache:
+            self.cache[token] = self.elf.descriptor(token)
+        d = self.cache[token]
+        if d is None:
+            self.unknown += 1
+            return f"? ({ms}) token {token:#010x}: {args}"
+
+        self.frames += 1
+        text = f"{d['level']} ({ms}) {d['tag']}: {render(d['format'], args, cut)}"
+        # As text, the cut-off bytes would have been printed instead of the marker
+        cuts = [v[1] for kind, v in args if kind == ARG_STR and v[1]]
+        self.bytes_text += len(text) + 1 + sum(n - len(f"...(+{n})") for n in cuts)
+        return text
+
+    def summary(self):
+        if not self.bytes_in:
+            return
+        saved = 100.0 * (1 - self.bytes_in / self.bytes_text) if self.bytes_text else 0
+        print(f"reef_detokenize: {self.frames} tokenized lines, {self.bytes_in} bytes read, "
+              f"{self.bytes_text} bytes as text ({saved:.0f}% saved), "
+              f"{self.unknown} unknown tokens", file=sys.stderr)
+
+
+def lines(args):
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baud, timeout=1) as port:
+            while True:
+                raw = port.readline()
+                if raw:
+                    yield raw.decode(errors="replace").rstrip("\r\n")
+    else:
+        for raw in sys.stdin:
+            yield raw.rstrip("\r\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("elf")
+    ap.add_argument("--port", help="serial port instead of stdin")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--list", action="store_true", help="print the string table")
+    args = ap.parse_args()
+
+    elf = Elf(args.elf)
+
+    if args.list:
+        for token, d in sorted(elf.descriptors()):
+            print(f"{token:#010x} {d['level']} {d['tag']:<20} "
+                  f"{d['file'].rsplit('/', 1)[-1]}:{d['line']}  {d['format']!r}")
+        return
+
+    detok = Detokenizer(elf)
+    try:
+        for raw in lines(args):
+            text = detok.line(raw)
+            if text is not None:
+                print(text, flush=True)
+    except KeyboardInterrupt:
+        pass
+    detok.summary()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+#include "reef_profile.h"
+
+// Kernel objects with storage fixed at build time.
+//
+// Declare each object's storage once at file scope, then create it with the
+// matching macro. With `idf.py -DREEF_STATIC_ALLOC=ON build` the storage is
+// a static array and the ...Static API is used, so stacks and queues are in
+// .bss, show up in the build's memory budget (tools/mem_budget.py) and can't
+// fail at runtime. Otherwise the same lines allocate from the heap as before.
+//
+//     REEF_TASK_STORAGE(blink, BLINK_STACK);
+//     REEF_QUEUE_STORAGE(events, 8, sizeof(event_t));
+//     ...
+//     events_queue = REEF_QUEUE_CREATE(events);
+//     REEF_TASK_CREATE(blink, blink_task, "blink", NULL, 5, REEF_CORE_CRITICAL);
+//
+// Stack depths are in the port's StackType_t units, as for xTaskCreate
+// (bytes on the ESP32). The core is a REEF_CORE_* from reef_profile.h or
+// tskNO_AFFINITY. Every task created here is listed in the stack report
+// (reef_mem_report_start).
+
+// Logs stack size and high-water mark per task every this many seconds
+#define REEF_MEM_REPORT_PERIOD_S 30
+
+// Tasks tracked for the stack report
+#define REEF_MEM_MAX_TASKS 16
+
+// Records a task for the stack report; returns `task`
+TaskHandle_t reef_mem_track(TaskHandle_t task, uint32_t depth);
+
+// Logs the stack table now, then every REEF_MEM_REPORT_PERIOD_S
+void reef_mem_report_start(void);
+
+#if REEF_STATIC_ALLOC
+
+#define REEF_TASK_STORAGE(id, depth)                                \
+    static StackType_t reef_mem_stack_##id[(depth)];                \
+    static StaticTask_t reef_mem_tcb_##id
+
+#define REEF_TASK_DEPTH(id) (sizeof(reef_mem_stack_##id) / sizeof(StackType_t))
+
+#define REEF_TASK_CREATE(id, fn, name, arg, prio, core)                      \
+    reef_mem_track(xTaskCreateStaticPinnedToCore((fn), (name),               \
+                                                 REEF_TASK_DEPTH(id),        \
+                                                 (arg), (prio),              \
+                                                 reef_mem_stack_##id,        \
+                                                 &reef_mem_tcb_##id, (core)), \
+                   REEF_TASK_DEPTH(id))
+
+#define REEF_QUEUE_STORAGE(id, length, item_size)                   \
+    enum                                                            \
+    {                                                               \
+        reef_mem_qlen_##id = (length),                              \
+        reef_mem_qitem_##id = (item_size),                          \
+    };                                                              \
+    static uint8_t reef_mem_queue_##id[(length) * (item_size)];     \
+    static StaticQueue_t reef_mem_qcb_##id
+
+#define REEF_QUEUE_CREATE(id)                                       \
+    xQueueCreateStatic(reef_mem_qlen_##id, reef_mem_qitem_##id,     \
+                       reef_mem_queue_##id, &reef_mem_qcb_##id)
+
+#define REEF_MUTEX_STORAGE(id) static StaticSemaphore_t reef_mem_mutex_##id
+#define REEF_MUTEX_CREATE(id) xSemaphoreCreateMutexStatic(&reef_mem_mutex_##id)
+
+#define REEF_EVENT_GROUP_STORAGE(id) static StaticEventGroup_t reef_mem_events_##id
+#define REEF_EVENT_GROUP_CREATE(id) xEventGroupCreateStatic(&reef_mem_events_##id)
+
+// Fixed buffer replacing a heap allocation; listed under "buffers" in the
+// memory budget. Only exists in static builds.
+#define REEF_ARENA_STORAGE(id, bytes) \
+    static uint8_t reef_mem_arena_##id[(bytes)] __attribute__((aligned(4)))
+#define REEF_ARENA(id) reef_mem_arena_##id
+
+#else
+
+#define REEF_TASK_STORAGE(id, depth)  \
+    enum                              \
+    {                                 \
+        reef_mem_depth_##id = (depth) \
+    }
+
+static inline TaskHandle_t reef_mem_task_create(TaskFunction_t fn, const char *name,
+                                                uint32_t depth, void *arg,
+                                                UBaseType_t prio, BaseType_t core)
+{
+    TaskHandle_t task = NULL;
+    if (xTaskCreatePinnedToCore(fn, name, depth, arg, prio, &task, core) != pdPASS)
+    {
+        return NULL;
+    }
+    return reef_mem_track(task, depth);
+}
+
+#define REEF_TASK_CREATE(id, fn, name, arg, prio, core) \
+    reef_mem_task_create((fn), (name), reef_mem_depth_##id, (arg), (prio), (core))
+
+#define REEF_QUEUE_STORAGE(id, length, item_size) \
+    enum                                          \
+    {                                             \
+        reef_mem_qlen_##id = (length),            \
+        reef_mem_qitem_##id = (item_size),        \
+    }
+
+#define REEF_QUEUE_CREATE(id) xQueueCreate(reef_mem_qlen_##id, reef_mem_qitem_##id)
+
+#define REEF_MUTEX_STORAGE(id) enum { reef_mem_mutex_##id }
+#define REEF_MUTEX_CREATE(id) xSemaphoreCreateMutex()
+
+#define REEF_EVENT_GROUP_STORAGE(id) enum { reef_mem_events_##id }
+#define REEF_EVENT_GROUP_CREATE(id) xEventGroupCreate()
+
+#endif
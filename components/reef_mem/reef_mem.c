@@ -0,0 +1,108 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_system.h"
+
+#include "reef_mem.h"
+
+static const char *TAG = "REEF_MEM";
+
+// Tracked tasks -------------------------------------------------------------- //
+typedef struct
+{
+    TaskHandle_t task;
+    uint32_t depth;
+} tracked_task_t;
+
+static tracked_task_t tracked[REEF_MEM_MAX_TASKS];
+static int n_tracked = 0;
+
+TaskHandle_t reef_mem_track(TaskHandle_t task, uint32_t depth)
+{
+    if (!task)
+    {
+        ESP_LOGE(TAG, "Task creation failed (%lu stack)", (unsigned long)depth);
+        return NULL;
+    }
+
+    // Tasks may be created from several tasks at once; a slot is readable
+    // once its handle is set
+    int slot = __atomic_fetch_add(&n_tracked, 1, __ATOMIC_RELAXED);
+    if (slot < REEF_MEM_MAX_TASKS)
+    {
+        tracked[slot].depth = depth;
+        __atomic_store_n(&tracked[slot].task, task, __ATOMIC_RELEASE);
+    }
+    return task;
+}
+
+// Report --------------------------------------------------------------------- //
+// Suggested size: the deepest use seen plus a quarter, rounded up to 256
+// bytes. Only as good as the paths exercised so far.
+static uint32_t suggest(uint32_t used)
+{
+    return (used + used / 4 + 255) & ~255u;
+}
+
+static void report(void)
+{
+    ESP_LOGI(TAG, "%-16s %7s %7s %7s %9s", "task", "stack", "used", "free", "suggest");
+
+    int n = __atomic_load_n(&n_tracked, __ATOMIC_RELAXED);
+    if (n > REEF_MEM_MAX_TASKS)
+    {
+        ESP_LOGW(TAG, "%d tasks not tracked, raise REEF_MEM_MAX_TASKS",
+                 n - REEF_MEM_MAX_TASKS);
+        n = REEF_MEM_MAX_TASKS;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        TaskHandle_t task = __atomic_load_n(&tracked[i].task, __ATOMIC_ACQUIRE);
+        if (!task)
+        {
+            continue;
+        }
+
+        uint32_t size = tracked[i].depth * sizeof(StackType_t);
+        uint32_t headroom = uxTaskGetStackHighWaterMark(task) * sizeof(StackType_t);
+        uint32_t used = size > headroom ? size - headroom : 0;
+
+        ESP_LOGI(TAG, "%-16s %7lu %7lu %7lu %9lu%s",
+                 pcTaskGetName(task), (unsigned long)size,
+                 (unsigned long)used, (unsigned long)headroom,
+                 (unsigned long)suggest(used),
+                 headroom < size / 8 ? "  <- low" : "");
+    }
+
+    ESP_LOGI(TAG, "heap free %lu, min free %lu",
+             (unsigned long)esp_get_free_heap_size(),
+             (unsigned long)esp_get_minimum_free_heap_size());
+}
+
+REEF_TASK_STORAGE(report, 3072);
+
+static void report_task(void *arg)
+{
+    while (1)
+    {
+        report();
+        vTaskDelay(pdMS_TO_TICKS(REEF_MEM_REPORT_PERIOD_S * 1000));
+    }
+}
+
+void reef_mem_report_start(void)
+{
+    static bool started = false;
+    if (started)
+    {
+        return;
+    }
+    started = true;
+
+    REEF_TASK_CREATE(report, report_task, "reef_mem", NULL, 1, REEF_CORE_BACKGROUND);
+}
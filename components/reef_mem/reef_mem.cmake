@@ -0,0 +1,27 @@
+# Compile-time switch for static allocation: idf.py -DREEF_STATIC_ALLOC=ON build
+#
+# Included from a project CMakeLists between project.cmake and project(),
+# like reef_trace.cmake. Call reef_mem_budget() after project() to print
+# the memory budget after each static build.
+option(REEF_STATIC_ALLOC "Static stacks, queues and buffers sized from config.h" OFF)
+
+set(REEF_MEM_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+if(REEF_STATIC_ALLOC)
+    idf_build_set_property(COMPILE_DEFINITIONS "REEF_STATIC_ALLOC=1" APPEND)
+endif()
+
+function(reef_mem_budget)
+    if(NOT REEF_STATIC_ALLOC)
+        return()
+    endif()
+
+    idf_build_get_property(elf EXECUTABLE)
+    idf_build_get_property(python PYTHON)
+    idf_build_get_property(build_dir BUILD_DIR)
+
+    add_custom_command(TARGET ${elf} POST_BUILD
+        COMMAND ${python} ${REEF_MEM_DIR}/tools/mem_budget.py $<TARGET_FILE:${elf}>
+                --memory-ld ${build_dir}/esp-idf/esp_system/ld/memory.ld
+        VERBATIM)
+endfunction()
@@ -0,0 +1,212 @@
+"""Memory budget of a REEF_STATIC_ALLOC firmware, read from its ELF.
+
+    python3 mem_budget.py build/Task2_PriorityGuardian.elf \\
+        --memory-ld build/esp-idf/esp_system/ld/memory.ld
+
+Runs after every static build (reef_mem_budget() in the project
+CMakeLists). Lists the storage declared with the REEF_*_STORAGE macros:
+stacks with their TCBs, queues, other kernel objects and arenas. Also
+lists any other static object of --min-other bytes or more, and compares
+all static data against the DRAM segment.
+
+The DRAM segment comes from the linker's memory.ld; without it, --dram
+(the ESP32 default) is assumed. Whatever static data leaves of the segment
+is the start of the heap; the ESP32 adds further heap-only regions on top.
+"""
+import argparse
+import re
+import struct
+import sys
+
+ESP32_DRAM = 0x2C200
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+STT_OBJECT = 1
+STT_FILE = 4
+
+PREFIXES = [
+    ("reef_mem_stack_", "stack"),
+    ("reef_mem_tcb_", "tcb"),
+    ("reef_mem_queue_", "queue"),
+    ("reef_mem_qcb_", "qcb"),
+    ("reef_mem_mutex_", "mutex"),
+    ("reef_mem_events_", "events"),
+    ("reef_mem_arena_", "arena"),
+]
+
+
+# ELF ------------------------------------------------------------------------ #
+def read_elf(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF" or data[4] != 1:
+        sys.exit(f"{path}: not a 32-bit ELF")
+
+    shoff, = struct.unpack_from("<I", data, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+
+    raw = [struct.unpack_from("<IIIIIIIIII", data, shoff + i * shentsize)
+           for i in range(shnum)]
+    strtab_off = raw[shstrndx][4]
+
+    def name_at(table_off, off):
+        end = data.index(b"\0", table_off + off)
+        return data[table_off + off:end].decode(errors="replace")
+
+    sections = []
+    for (name, sh_type, flags, addr, offset, size, link, _, _, entsize) in raw:
+        sections.append({"name": name_at(strtab_off, name), "type": sh_type,
+                         "flags": flags, "addr": addr, "offset": offset,
+                         "size": size, "link": link, "entsize": entsize})
+
+    symbols = []
+    for sec in sections:
+        if sec["type"] != SHT_SYMTAB:
+            continue
+        names = sections[sec["link"]]["offset"]
+        source = "?"
+        for i in range(sec["size"] // 16):
+            name, value, size, info, _, shndx = struct.unpack_from(
+                "<IIIBBH", data, sec["offset"] + i * 16)
+            kind = info & 0xF
+            if kind == STT_FILE:
+                source = name_at(names, name)
+            elif kind == STT_OBJECT and size and 0 < shndx < len(sections):
+                symbols.append({"name": name_at(names, name), "addr": value,
+                                "size": size, "file": source,
+                                "section": sections[shndx]["name"]})
+    return sections, symbols
+
+
+def dram_segment(memory_ld):
+    """(org, len) of dram0_0_seg from IDF's preprocessed memory.ld"""
+    with open(memory_ld) as f:
+        text = f.read()
+    m = re.search(r"dram0_0_seg\s*\([^)]*\)\s*:\s*org\s*=\s*([^,]+),\s*len\s*=\s*([^\n]+)", text)
+    if not m:
+        return None
+
+    def value(expr):
+        expr = expr.strip().rstrip(",")
+        if not re.fullmatch(r"[0-9a-fA-FxX+\-*/() ]+", expr):
+            raise ValueError(expr)
+        return int(eval(expr, {"__builtins__": {}}))
+
+    return value(m.group(1)), value(m.group(2))
+
+
+# Report --------------------------------------------------------------------- #
+def classify(symbols):
+    objects = {}
+    other = []
+    for sym in symbols:
+        for prefix, kind in PREFIXES:
+            if sym["name"].startswith(prefix):
+                ident = sym["name"][len(prefix):]
+                objects.setdefault((kind, ident), sym)
+                break
+        else:
+            other.append(sym)
+    return objects, other
+
+
+def row(label, size, note=""):
+    print(f"  {label:<32} {size:>8}  {note}".rstrip())
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("elf")
+    ap.add_argument("--memory-ld", help="IDF's generated memory.ld for the DRAM segment")
+    ap.add_argument("--dram", type=lambda v: int(v, 0), default=ESP32_DRAM,
+                    help="DRAM segment size when memory.ld is not given (default: ESP32)")
+    ap.add_argument("--min-other", type=int, default=1024,
+                    help="list other static objects from this size up")
+    args = ap.parse_args()
+
+    sections, symbols = read_elf(args.elf)
+    objects, other = classify(symbols)
+
+    segment = None
+    if args.memory_ld:
+        try:
+            segment = dram_segment(args.memory_ld)
+        except (OSError, ValueError) as err:
+            print(f"mem_budget: {args.memory_ld}: {err}", file=sys.stderr)
+
+    def in_dram(sec):
+        if segment:
+            org, length = segment
+            return org <= sec["addr"] < org + length
+        return sec["name"].startswith((".dram0", ".noinit"))
+
+    dram_sections = [s for s in sections if s["flags"] & SHF_ALLOC and s["size"] and in_dram(s)]
+    dram_total = segment[1] if segment else args.dram
+    static_total = sum(s["size"] for s in dram_sections)
+
+    def get(kind, ident):
+        sym = objects.get((kind, ident))
+        return sym["size"] if sym else 0
+
+    total = 0
+    print(f"Memory budget: {args.elf.rsplit('/', 1)[-1]}")
+
+    stacks = sorted(ident for kind, ident in objects if kind == "stack")
+    if stacks:
+        print("\nstacks (+ TCB)")
+        for ident in stacks:
+            size, tcb = get("stack", ident), get("tcb", ident)
+            row(ident, size + tcb, f"{size} + {tcb}")
+            total += size + tcb
+
+    queues = sorted(ident for kind, ident in objects if kind == "queue")
+    if queues:
+        print("\nqueues (+ control block)")
+        for ident in queues:
+            size, qcb = get("queue", ident), get("qcb", ident)
+            row(ident, size + qcb, f"{size} + {qcb}")
+            total += size + qcb
+
+    kernel = sorted((kind, ident) for kind, ident in objects if kind in ("mutex", "events"))
+    if kernel:
+        print("\nmutexes / event groups")
+        for kind, ident in kernel:
+            row(f"{ident} ({kind})", get(kind, ident))
+            total += get(kind, ident)
+
+    arenas = sorted(ident for kind, ident in objects if kind == "arena")
+    if arenas:
+        print("\nbuffers")
+        for ident in arenas:
+            row(ident, get("arena", ident))
+            total += get("arena", ident)
+
+    dram_names = {s["name"] for s in dram_sections}
+    big = sorted((s for s in other
+                  if s["size"] >= args.min_other and s["section"] in dram_names),
+                 key=lambda s: -s["size"])
+    if big:
+        print(f"\nother static objects >= {args.min_other} B")
+        for sym in big:
+            row(f"{sym['name']} ({sym['file']})", sym["size"])
+
+    print()
+    row("REEF_*_STORAGE total", total)
+    row("static DRAM (.data/.bss/...)", static_total,
+        " + ".join(f"{s['name']} {s['size']}" for s in dram_sections))
+    left = dram_total - static_total
+    pct = 100.0 * static_total / dram_total
+    source = "memory.ld" if segment else "assumed"
+    row(f"DRAM segment ({source})", dram_total,
+        f"{pct:.0f}% used, {left} B left as heap in this segment")
+
+    if pct > 90:
+        print("mem_budget: warning: static data takes over 90% of DRAM; "
+              "Wi-Fi and MQTT need heap", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "mqtt_client.h"
+
+#include "freertos/FreeRTOS.h"
+
+// Shared Wi-Fi + MQTT bring-up for every task firmware.
+//
+// - The AP's BSSID/channel (and optionally the DHCP lease) are cached in NVS,
+//   so later boots associate without a full scan and skip DHCP.
+// - MQTT is started from the GOT_IP event, not after app_main notices it.
+// - Wi-Fi and MQTT reconnects use capped exponential backoff with jitter.
+// - Each boot phase is timestamped and reported once the first subscription
+//   is acknowledged.
+
+// Boot phases ---------------------------------------------------------------- //
+typedef enum
+{
+    REEF_BOOT_NVS,        // NVS ready
+    REEF_BOOT_NETIF,      // netif + Wi-Fi driver initialised
+    REEF_BOOT_ASSOC,      // associated with the AP
+    REEF_BOOT_DHCP,       // IP address (leased or cached)
+    REEF_BOOT_MQTT,       // CONNACK
+    REEF_BOOT_SUBSCRIBE,  // first SUBACK
+    REEF_BOOT_PHASES
+} reef_boot_phase_t;
+
+// Config --------------------------------------------------------------------- //
+typedef struct
+{
+    const char *ssid;
+    const char *password;
+    bool wifi_ps_none;  // disable modem sleep
+
+    // Reuse the cached DHCP lease as a static IP. Falls back to DHCP if the
+    // broker is unreachable with it.
+    bool static_ip;
+
+    const char *broker_uri;
+    int keepalive_s;    // 0 = client default
+
+    // Registered before the client starts, so CONNECTED is never missed
+    esp_event_handler_t mqtt_handler;
+    void *mqtt_handler_arg;
+} reef_net_config_t;
+
+// Brings up NVS, Wi-Fi and the MQTT client; returns without waiting.
+// Replaces nvs_flash_init() in app_main.
+esp_err_t reef_net_start(const reef_net_config_t *cfg,
+                         esp_mqtt_client_handle_t *out_client);
+
+// Blocks until the station has an IP (false on timeout)
+bool reef_net_wait_ip(TickType_t timeout);
+
+// Blocks until MQTT is connected (false on timeout)
+bool reef_net_wait_mqtt(TickType_t timeout);
+
+// Microseconds since boot at which each phase was first reached, 0 if not yet
+int64_t reef_net_boot_time(reef_boot_phase_t phase);
+
+// Logs the boot phase table
+void reef_net_boot_report(void);
+
+// Drops the cached AP/lease so the next boot does a full scan + DHCP
+void reef_net_forget(void);
@@ -0,0 +1,535 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "reef_mem.h"
+#include "reef_net.h"
+#include "reef_trace.h"
+
+static const char *TAG = "REEF_NET";
+
+// Backoff -------------------------------------------------------------------- //
+#define BACKOFF_BASE_MS 250
+#define BACKOFF_MAX_MS 30000
+
+// Consecutive MQTT failures with a cached static IP before falling back to DHCP
+#define STATIC_IP_MAX_FAILS 2
+
+// NVS cache ------------------------------------------------------------------ //
+#define CACHE_NAMESPACE "reef_net"
+#define CACHE_KEY "ap"
+#define CACHE_VERSION 1
+
+typedef struct
+{
+    uint32_t version;
+    uint32_t ssid_hash; // cache only applies to the SSID it was made for
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t has_lease;
+    uint32_t ip, netmask, gw, dns;
+} ap_cache_t;
+
+// State ---------------------------------------------------------------------- //
+#define NET_IP_BIT BIT0
+#define NET_MQTT_BIT BIT1
+
+static reef_net_config_t net_cfg;
+static EventGroupHandle_t net_events;
+REEF_EVENT_GROUP_STORAGE(net);
+static esp_netif_t *sta_netif;
+static esp_mqtt_client_handle_t mqtt_client;
+
+static esp_timer_handle_t wifi_retry_timer;
+static esp_timer_handle_t mqtt_retry_timer;
+static int wifi_attempts = 0;
+static int mqtt_attempts = 0;
+static bool mqtt_started = false;
+
+static ap_cache_t cache;
+static bool cached_ap = false;   // associating via the cached BSSID/channel
+static bool cached_ip = false;   // running on the cached lease, DHCP off
+
+static int64_t boot_us[REEF_BOOT_PHASES];
+
+static const char *phase_names[REEF_BOOT_PHASES] = {
+    "nvs", "netif", "associate", "dhcp", "mqtt connack", "first subscribe"};
+
+// ---------------------------------------------------------------------------- //
+
+static void mark(reef_boot_phase_t phase)
+{
+    if (boot_us[phase] == 0)
+    {
+        boot_us[phase] = esp_timer_get_time();
+    }
+}
+
+static uint32_t ssid_hash(const char *ssid)
+{
+    uint32_t h = 2166136261u;
+    while (*ssid)
+    {
+        h = (h ^ (uint8_t)*ssid++) * 16777619u;
+    }
+    return h;
+}
+
+// Exponential with "equal jitter": somewhere in [d/2, d], so boards that lost
+// the AP together do not hammer it in lockstep
+static uint64_t backoff_us(int attempt)
+{
+    uint32_t d = BACKOFF_BASE_MS << (attempt < 7 ? attempt : 7);
+    if (d > BACKOFF_MAX_MS)
+    {
+        d = BACKOFF_MAX_MS;
+    }
+    d = d / 2 + esp_random() % (d / 2 + 1);
+    return (uint64_t)d * 1000;
+}
+
+// Cache ---------------------------------------------------------------------- //
+static bool cache_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return false;
+    }
+
+    size_t len = sizeof(cache);
+    esp_err_t err = nvs_get_blob(nvs, CACHE_KEY, &cache, &len);
+    nvs_close(nvs);
+
+    return err == ESP_OK && len == sizeof(cache) &&
+           cache.version == CACHE_VERSION &&
+           cache.ssid_hash == ssid_hash(net_cfg.ssid) && cache.channel != 0;
+}
+
+static void cache_store(const ap_cache_t *next)
+{
+    // Skip the flash write when nothing changed, i.e. on most boots
+    if (memcmp(next, &cache, sizeof(cache)) == 0)
+    {
+        return;
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(CACHE_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_set_blob(nvs, CACHE_KEY, next, sizeof(*next)) == ESP_OK &&
+        nvs_commit(nvs) == ESP_OK)
+    {
+        cache = *next;
+    }
+    nvs_close(nvs);
+}
+
+void reef_net_forget(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(CACHE_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        nvs_erase_key(nvs, CACHE_KEY);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    memset(&cache, 0, sizeof(cache));
+}
+
+// Called on GOT_IP: remember what just worked
+static void cache_update(void)
+{
+    ap_cache_t next = cache;
+    next.version = CACHE_VERSION;
+    next.ssid_hash = ssid_hash(net_cfg.ssid);
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+    {
+        memcpy(next.bssid, ap.bssid, sizeof(next.bssid));
+        next.channel = ap.primary;
+    }
+
+    esp_netif_ip_info_t info;
+    esp_netif_dns_info_t dns;
+    if (!cached_ip && esp_netif_get_ip_info(sta_netif, &info) == ESP_OK &&
+        esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK)
+    {
+        next.has_lease = 1;
+        next.ip = info.ip.addr;
+        next.netmask = info.netmask.addr;
+        next.gw = info.gw.addr;
+        next.dns = dns.ip.u_addr.ip4.addr;
+    }
+
+    cache_store(&next);
+}
+
+// Cached AP failed to associate: scan normally from now on
+static void drop_cached_ap(void)
+{
+    ESP_LOGW(TAG, "Cached AP unreachable, falling back to full scan");
+    cached_ap = false;
+
+    wifi_config_t wifi_config;
+    esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+    wifi_config.sta.bssid_set = false;
+    wifi_config.sta.channel = 0;
+    wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+    // A lease from the cache may belong to another network now
+    if (cached_ip)
+    {
+        cached_ip = false;
+        esp_netif_dhcpc_start(sta_netif);
+    }
+
+    reef_net_forget();
+}
+
+// Cached lease did not get us to the broker: ask DHCP
+static void drop_cached_ip(void)
+{
+    ESP_LOGW(TAG, "Cached IP not working, falling back to DHCP");
+    cached_ip = false;
+
+    ap_cache_t next = cache;
+    next.has_lease = 0;
+    cache_store(&next);
+
+    esp_netif_dhcpc_start(sta_netif);
+}
+
+// Timers --------------------------------------------------------------------- //
+static void wifi_retry(void *arg)
+{
+    esp_wifi_connect();
+}
+
+static void mqtt_retry(void *arg)
+{
+    if (xEventGroupGetBits(net_events) & NET_IP_BIT)
+    {
+        esp_mqtt_client_reconnect(mqtt_client);
+    }
+}
+
+static void schedule(esp_timer_handle_t timer, int *attempts, const char *what)
+{
+    uint64_t delay = backoff_us((*attempts)++);
+    ESP_LOGI(TAG, "%s retry %d in %llu ms", what, *attempts,
+             (unsigned long long)(delay / 1000));
+
+    esp_timer_stop(timer);
+    esp_timer_start_once(timer, delay);
+}
+
+// Events --------------------------------------------------------------------- //
+static void wifi_event_handler(void *arg,
+                               esp_event_base_t base,
+                               int32_t id,
+                               void *data)
+{
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START)
+    {
+        esp_wifi_connect();
+    }
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED)
+    {
+        mark(REEF_BOOT_ASSOC);
+    }
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        xEventGroupClearBits(net_events, NET_IP_BIT | NET_MQTT_BIT);
+
+        if (cached_ap && boot_us[REEF_BOOT_DHCP] == 0)
+        {
+            drop_cached_ap();
+        }
+        schedule(wifi_retry_timer, &wifi_attempts, "WiFi");
+    }
+    else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP)
+    {
+        mark(REEF_BOOT_DHCP);
+        wifi_attempts = 0;
+        xEventGroupSetBits(net_events, NET_IP_BIT);
+
+        // MQTT goes first, the cache write can wait behind it
+        if (!mqtt_started)
+        {
+            mqtt_started = true;
+            esp_mqtt_client_start(mqtt_client);
+        }
+        else
+        {
+            esp_timer_stop(mqtt_retry_timer);
+            esp_mqtt_client_reconnect(mqtt_client);
+        }
+
+        cache_update();
+    }
+    else if (base == IP_EVENT && id == IP_EVENT_STA_LOST_IP)
+    {
+        xEventGroupClearBits(net_events, NET_IP_BIT);
+    }
+}
+
+static void mqtt_event_handler(void *arg,
+                               esp_event_base_t base,
+                               int32_t id,
+                               void *data)
+{
+    switch (id)
+    {
+    case MQTT_EVENT_CONNECTED:
+        mark(REEF_BOOT_MQTT);
+        mqtt_attempts = 0;
+        xEventGroupSetBits(net_events, NET_MQTT_BIT);
+        break;
+
+    case MQTT_EVENT_SUBSCRIBED:
+        if (boot_us[REEF_BOOT_SUBSCRIBE] == 0)
+        {
+            mark(REEF_BOOT_SUBSCRIBE);
+            reef_net_boot_report();
+        }
+        break;
+
+    case MQTT_EVENT_DISCONNECTED:
+        xEventGroupClearBits(net_events, NET_MQTT_BIT);
+
+        // Without an IP, GOT_IP reconnects instead
+        if (!(xEventGroupGetBits(net_events) & NET_IP_BIT))
+        {
+            break;
+        }
+
+        if (cached_ip && boot_us[REEF_BOOT_MQTT] == 0 &&
+            mqtt_attempts >= STATIC_IP_MAX_FAILS)
+        {
+            drop_cached_ip();
+            break;
+        }
+        schedule(mqtt_retry_timer, &mqtt_attempts, "MQTT");
+        break;
+
+    default:
+        break;
+    }
+}
+
+#if REEF_TRACE
+// Times the app's handler for the metrics snapshot
+static void traced_app_handler(void *arg,
+                               esp_event_base_t base,
+                               int32_t id,
+                               void *data)
+{
+    uint32_t t_enter = reef_trace_mqtt_enter(id);
+    net_cfg.mqtt_handler(arg, base, id, data);
+    reef_trace_mqtt_exit(id, t_enter);
+}
+#endif
+
+// Init ----------------------------------------------------------------------- //
+static esp_err_t nvs_init(void)
+{
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_RETURN_ON_ERROR(nvs_flash_erase(), TAG, "nvs erase");
+        err = nvs_flash_init();
+    }
+    return err;
+}
+
+static esp_err_t wifi_init(void)
+{
+    ESP_RETURN_ON_ERROR(esp_netif_init(), TAG, "netif");
+    ESP_RETURN_ON_ERROR(esp_event_loop_create_default(), TAG, "event loop");
+    sta_netif = esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t init = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_wifi_init(&init), TAG, "wifi init");
+
+    // The cache lives in NVS already, no need for the driver's copy
+    ESP_RETURN_ON_ERROR(esp_wifi_set_storage(WIFI_STORAGE_RAM), TAG, "storage");
+
+    ESP_RETURN_ON_ERROR(esp_event_handler_register(
+        WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL), TAG, "wifi evt");
+    ESP_RETURN_ON_ERROR(esp_event_handler_register(
+        IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL), TAG, "ip evt");
+    ESP_RETURN_ON_ERROR(esp_event_handler_register(
+        IP_EVENT, IP_EVENT_STA_LOST_IP, &wifi_event_handler, NULL), TAG, "ip evt");
+
+    wifi_config_t wifi_config = {0};
+    strlcpy((char *)wifi_config.sta.ssid, net_cfg.ssid,
+            sizeof(wifi_config.sta.ssid));
+    strlcpy((char *)wifi_config.sta.password, net_cfg.password,
+            sizeof(wifi_config.sta.password));
+
+    if (cache_load())
+    {
+        // Known AP: go straight to its channel instead of sweeping all 13
+        cached_ap = true;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, cache.bssid, sizeof(cache.bssid));
+        wifi_config.sta.channel = cache.channel;
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+
+        if (net_cfg.static_ip && cache.has_lease)
+        {
+            esp_netif_ip_info_t info = {
+                .ip.addr = cache.ip,
+                .netmask.addr = cache.netmask,
+                .gw.addr = cache.gw,
+            };
+            esp_netif_dns_info_t dns = {
+                .ip.type = ESP_IPADDR_TYPE_V4,
+                .ip.u_addr.ip4.addr = cache.dns,
+            };
+
+            esp_netif_dhcpc_stop(sta_netif);
+            if (esp_netif_set_ip_info(sta_netif, &info) == ESP_OK)
+            {
+                esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+                cached_ip = true;
+            }
+            else
+            {
+                esp_netif_dhcpc_start(sta_netif);
+            }
+        }
+
+        ESP_LOGI(TAG, "Cached AP " MACSTR " ch %d%s", MAC2STR(cache.bssid),
+                 cache.channel, cached_ip ? ", cached IP" : "");
+    }
+    else
+    {
+        memset(&cache, 0, sizeof(cache));
+    }
+
+    ESP_RETURN_ON_ERROR(esp_wifi_set_mode(WIFI_MODE_STA), TAG, "mode");
+    ESP_RETURN_ON_ERROR(esp_wifi_set_config(WIFI_IF_STA, &wifi_config), TAG, "config");
+    mark(REEF_BOOT_NETIF);
+
+    ESP_RETURN_ON_ERROR(esp_wifi_start(), TAG, "start");
+
+    if (net_cfg.wifi_ps_none)
+    {
+        ESP_RETURN_ON_ERROR(esp_wifi_set_ps(WIFI_PS_NONE), TAG, "ps");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t mqtt_init(void)
+{
+    esp_mqtt_client_config_t cfg = {
+        .broker.address.uri = net_cfg.broker_uri,
+        .session.keepalive = net_cfg.keepalive_s,
+        // Reconnects are driven from here, with backoff and IP awareness
+        .network.disable_auto_reconnect = true,
+    };
+
+    mqtt_client = esp_mqtt_client_init(&cfg);
+    ESP_RETURN_ON_FALSE(mqtt_client, ESP_ERR_NO_MEM, TAG, "mqtt init");
+
+    // Ours first, so boot marks are taken before the app reacts
+    esp_mqtt_client_register_event(
+        mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    if (net_cfg.mqtt_handler)
+    {
+#if REEF_TRACE
+        esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID,
+                                       traced_app_handler,
+                                       net_cfg.mqtt_handler_arg);
+#else
+        esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID,
+                                       net_cfg.mqtt_handler,
+                                       net_cfg.mqtt_handler_arg);
+#endif
+    }
+    return ESP_OK;
+}
+
+esp_err_t reef_net_start(const reef_net_config_t *cfg,
+                         esp_mqtt_client_handle_t *out_client)
+{
+    ESP_RETURN_ON_FALSE(cfg && cfg->ssid && cfg->broker_uri,
+                        ESP_ERR_INVALID_ARG, TAG, "config");
+
+    net_cfg = *cfg;
+    net_events = REEF_EVENT_GROUP_CREATE(net);
+    ESP_RETURN_ON_FALSE(net_events, ESP_ERR_NO_MEM, TAG, "event group");
+
+    ESP_RETURN_ON_ERROR(nvs_init(), TAG, "nvs");
+    mark(REEF_BOOT_NVS);
+
+    const esp_timer_create_args_t wifi_timer = {
+        .callback = wifi_retry, .name = "wifi_retry"};
+    const esp_timer_create_args_t mqtt_timer = {
+        .callback = mqtt_retry, .name = "mqtt_retry"};
+    ESP_RETURN_ON_ERROR(esp_timer_create(&wifi_timer, &wifi_retry_timer), TAG, "timer");
+    ESP_RETURN_ON_ERROR(esp_timer_create(&mqtt_timer, &mqtt_retry_timer), TAG, "timer");
+
+    // The client exists before Wi-Fi starts so GOT_IP can start it directly
+    ESP_RETURN_ON_ERROR(mqtt_init(), TAG, "mqtt");
+    if (out_client)
+    {
+        *out_client = mqtt_client;
+    }
+
+    ESP_RETURN_ON_ERROR(wifi_init(), TAG, "wifi");
+    return ESP_OK;
+}
+
+bool reef_net_wait_ip(TickType_t timeout)
+{
+    return xEventGroupWaitBits(net_events, NET_IP_BIT, false, true, timeout) &
+           NET_IP_BIT;
+}
+
+bool reef_net_wait_mqtt(TickType_t timeout)
+{
+    return xEventGroupWaitBits(net_events, NET_MQTT_BIT, false, true, timeout) &
+           NET_MQTT_BIT;
+}
+
+int64_t reef_net_boot_time(reef_boot_phase_t phase)
+{
+    return phase < REEF_BOOT_PHASES ? boot_us[phase] : 0;
+}
+
+void reef_net_boot_report(void)
+{
+    ESP_LOGI(TAG, "Boot phases (%s AP, %s IP):",
+             cached_ap ? "cached" : "scanned", cached_ip ? "cached" : "DHCP");
+
+    int64_t prev = 0;
+    for (int i = 0; i < REEF_BOOT_PHASES; i++)
+    {
+        if (boot_us[i] == 0)
+        {
+            ESP_LOGI(TAG, "  %-16s      -", phase_names[i]);
+            continue;
+        }
+        ESP_LOGI(TAG, "  %-16s %6lld ms  (+%lld ms)", phase_names[i],
+                 (long long)(boot_us[i] / 1000), (long long)((boot_us[i] - prev) / 1000));
+        prev = boot_us[i];
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Task placement profiles, chosen at build time:
+//
+//     idf.py -DREEF_PROFILE=pinned build
+//
+// - float:     no affinity, base priorities (the scheduler places tasks)
+// - pinned:    latency-critical tasks on APP_CPU; Wi-Fi, LwIP, the MQTT
+//              client and background tasks on PRO_CPU
+// - pinned_rt: pinned, and critical tasks get their raised priority
+//
+// Each project's config.h picks a core and priority per task with the
+// macros below; reef_mem's REEF_TASK_CREATE applies them.
+
+#define REEF_PROFILE_FLOAT 0
+#define REEF_PROFILE_PINNED 1
+#define REEF_PROFILE_PINNED_RT 2
+
+#ifndef REEF_PROFILE
+#define REEF_PROFILE REEF_PROFILE_FLOAT
+#endif
+
+#define REEF_CORE_PRO 0
+#define REEF_CORE_APP (portNUM_PROCESSORS > 1 ? 1 : 0)
+
+#if REEF_PROFILE == REEF_PROFILE_FLOAT
+#define REEF_CORE_CRITICAL tskNO_AFFINITY
+#define REEF_CORE_BACKGROUND tskNO_AFFINITY
+#else
+#define REEF_CORE_CRITICAL REEF_CORE_APP
+#define REEF_CORE_BACKGROUND REEF_CORE_PRO
+#endif
+
+// `base` normally, `rt` under pinned_rt
+#if REEF_PROFILE == REEF_PROFILE_PINNED_RT
+#define REEF_PRIO(base, rt) (rt)
+#else
+#define REEF_PRIO(base, rt) (base)
+#endif
+
+#if REEF_PROFILE == REEF_PROFILE_FLOAT
+#define REEF_PROFILE_NAME "float"
+#elif REEF_PROFILE == REEF_PROFILE_PINNED
+#define REEF_PROFILE_NAME "pinned"
+#else
+#define REEF_PROFILE_NAME "pinned_rt"
+#endif
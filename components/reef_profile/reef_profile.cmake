@@ -0,0 +1,34 @@
+# Build-time task placement: idf.py -DREEF_PROFILE=pinned build
+# Latency histograms for the critical paths: idf.py -DREEF_BENCH=ON build
+#
+# Included from a project CMakeLists between project.cmake and project(),
+# like reef_trace.cmake. Switching profiles changes sdkconfig defaults, so
+# use one build directory (and sdkconfig) per profile; tools/profile_bench.py
+# does.
+set(REEF_PROFILE "float" CACHE STRING "Task placement profile: float, pinned, pinned_rt")
+set_property(CACHE REEF_PROFILE PROPERTY STRINGS float pinned pinned_rt)
+
+option(REEF_BENCH "Record and log latency histograms of the critical paths" OFF)
+
+if(REEF_PROFILE STREQUAL "float")
+    set(reef_profile_id 0)
+elseif(REEF_PROFILE STREQUAL "pinned")
+    set(reef_profile_id 1)
+elseif(REEF_PROFILE STREQUAL "pinned_rt")
+    set(reef_profile_id 2)
+else()
+    message(FATAL_ERROR "REEF_PROFILE must be float, pinned or pinned_rt, not '${REEF_PROFILE}'")
+endif()
+
+idf_build_set_property(COMPILE_DEFINITIONS "REEF_PROFILE=${reef_profile_id}" APPEND)
+
+if(NOT REEF_PROFILE STREQUAL "float")
+    if(NOT DEFINED SDKCONFIG_DEFAULTS AND EXISTS ${CMAKE_SOURCE_DIR}/sdkconfig.defaults)
+        set(SDKCONFIG_DEFAULTS ${CMAKE_SOURCE_DIR}/sdkconfig.defaults)
+    endif()
+    list(APPEND SDKCONFIG_DEFAULTS ${CMAKE_CURRENT_LIST_DIR}/sdkconfig.pinned)
+endif()
+
+if(REEF_BENCH)
+    idf_build_set_property(COMPILE_DEFINITIONS "REEF_BENCH=1" APPEND)
+endif()
@@ -0,0 +1,195 @@
+"""Compare latency distributions across task placement profiles.
+
+Builds one firmware per profile with REEF_BENCH on, runs it, collects the
+BENCH lines reef_bench logs every 10 s and prints the percentiles of each
+histogram side by side.
+
+On a board (one build directory per profile, flashed in turn; the stimulus
+comes from the reef or from a load you run meanwhile):
+
+    python3 profile_bench.py 2 --port /dev/ttyUSB0 --seconds 60
+
+In the host simulation (host_sim/tools/load.py plays the stimulus; only
+priorities differ there, the POSIX port has one core):
+
+    python3 profile_bench.py 2 --sim -- --count 500 --rate 50
+
+Arguments after `--` go to load.py. --no-build reuses existing builds.
+"""
+import argparse
+import os
+import re
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.normpath(os.path.join(HERE, "..", "..", ".."))
+
+PROFILES = ["float", "pinned", "pinned_rt"]
+
+TASK_DIRS = {
+    1: "Task1_TimingKeeper",
+    2: "Task2_PriorityGuardian",
+    3: "Task3_WindowSync",
+}
+
+# Same layout as reef_bench.c: exact below 16 us, then 4 per power of two
+BUCKETS = 128
+REPORT_PERIOD_S = 10
+
+BENCH_RE = re.compile(r"BENCH (\S+) (\S+) n=(\d+) .*max=(\d+) \|((?: \d+:\d+)*)")
+
+
+def bucket_top(i):
+    if i < 16:
+        return i
+    octave = 4 + (i - 16) // 4
+    sub = (i - 16) % 4
+    return ((4 + sub + 1) << (octave - 2)) - 1
+
+
+def percentile(buckets, per_mille):
+    count = sum(buckets.values())
+    rank = -(-count * per_mille // 1000)
+    seen = 0
+    for i in sorted(buckets):
+        seen += buckets[i]
+        if seen >= rank:
+            return bucket_top(i)
+    return bucket_top(BUCKETS - 1)
+
+
+def parse(lines):
+    """{name: (buckets, max)} from the last BENCH line per histogram
+
+    The firmware's histograms are cumulative, so the last line has it all.
+    """
+    result = {}
+    for line in lines:
+        m = BENCH_RE.search(line)
+        if not m:
+            continue
+        buckets = {}
+        for pair in m.group(5).split():
+            i, n = pair.split(":")
+            buckets[int(i)] = int(n)
+        result[m.group(2)] = (buckets, int(m.group(4)))
+    return result
+
+
+# Runs ----------------------------------------------------------------------- #
+def run(cmd, **kwargs):
+    print("+ " + " ".join(cmd), file=sys.stderr)
+    subprocess.run(cmd, check=True, **kwargs)
+
+
+def board(args, profile):
+    project = os.path.join(REPO, TASK_DIRS[args.task])
+    build = os.path.join(project, f"build_{profile}")
+    if not args.no_build:
+        run(["idf.py", "-B", build, "-D", f"SDKCONFIG={build}/sdkconfig",
+             f"-DREEF_PROFILE={profile}", "-DREEF_BENCH=ON",
+             "-p", args.port, "build", "flash"], cwd=project)
+
+    import serial
+
+    lines = []
+    with serial.Serial(args.port, args.baud, timeout=0.5) as port:
+        # Reset, so every profile is measured from boot
+        port.dtr = False
+        port.rts = True
+        time.sleep(0.1)
+        port.rts = False
+
+        deadline = time.time() + args.seconds
+        while time.time() < deadline:
+            line = port.readline().decode(errors="replace")
+            if line:
+                lines.append(line)
+                if args.verbose:
+                    sys.stdout.write(line)
+    return lines
+
+
+def sim(args, profile):
+    build = os.path.join(REPO, "host_sim", f"build_{profile}")
+    if not args.no_build:
+        run(["cmake", "-S", os.path.join(REPO, "host_sim"), "-B", build,
+             f"-DREEF_PROFILE={profile}", "-DREEF_BENCH=ON"])
+        run(["cmake", "--build", build, "-j", "--target", f"task{args.task}_sim"])
+
+    # Answers must be in before the last report; drain past one period
+    cmd = [sys.executable, os.path.join(REPO, "host_sim", "tools", "load.py"),
+           str(args.task), "--sim", os.path.join(build, f"task{args.task}_sim"),
+           "--drain", str(REPORT_PERIOD_S + 1)] + args.load_args
+    print("+ " + " ".join(cmd), file=sys.stderr)
+    out = subprocess.run(cmd, check=True, stdout=subprocess.PIPE, text=True,
+                         errors="replace").stdout
+    if args.verbose:
+        sys.stdout.write(out)
+    return out.splitlines()
+
+
+# Report --------------------------------------------------------------------- #
+def report(results):
+    names = sorted({name for r in results.values() for name in r})
+    if not names:
+        sys.exit("profile_bench: no BENCH lines; was the build made with REEF_BENCH=ON "
+                 "and did the run exceed 10 s with stimulus?")
+
+    cols = ("n", "p50", "p90", "p99", "p99.9", "max")
+    print(f"\n{'histogram':<24} {'profile':<10}" + "".join(f"{c:>9}" for c in cols)
+          + "   (us, bucket upper bounds)")
+    for name in names:
+        for profile, r in results.items():
+            if name not in r:
+                continue
+            buckets, top = r[name]
+            values = (sum(buckets.values()), percentile(buckets, 500),
+                      percentile(buckets, 900), percentile(buckets, 990),
+                      percentile(buckets, 999), top)
+            print(f"{name:<24} {profile:<10}" + "".join(f"{v:>9}" for v in values))
+        print()
+
+
+def main():
+    argv = sys.argv[1:]
+    load_args = []
+    if "--" in argv:
+        cut = argv.index("--")
+        argv, load_args = argv[:cut], argv[cut + 1:]
+
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("task", type=int, choices=sorted(TASK_DIRS))
+    ap.add_argument("--profiles", default=",".join(PROFILES),
+                    help="comma-separated subset of " + ", ".join(PROFILES))
+    ap.add_argument("--sim", action="store_true", help="run the host simulation")
+    ap.add_argument("--port", help="serial port of the board")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--seconds", type=float, default=60.0,
+                    help="board: how long to collect per profile")
+    ap.add_argument("--no-build", action="store_true", help="reuse build_<profile>")
+    ap.add_argument("-v", "--verbose", action="store_true", help="echo the console")
+    args = ap.parse_args(argv)
+    args.load_args = load_args
+
+    profiles = args.profiles.split(",")
+    for profile in profiles:
+        if profile not in PROFILES:
+            ap.error(f"unknown profile {profile}")
+    if not args.sim and not args.port:
+        ap.error("--port or --sim is required")
+    if not args.sim and args.seconds <= REPORT_PERIOD_S:
+        ap.error(f"--seconds must exceed the {REPORT_PERIOD_S} s report period")
+
+    results = {}
+    for profile in profiles:
+        lines = sim(args, profile) if args.sim else board(args, profile)
+        results[profile] = parse(lines)
+    report(results)
+
+
+if __name__ == "__main__":
+    main()
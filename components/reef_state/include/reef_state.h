@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// App state kept across resets.
+//
+// An app declares a section per piece of state, restores it before Wi-Fi
+// comes up, and hands over a copy whenever the state changes:
+//
+//     REEF_STATE_DEFINE(patterns_state, "patterns", 1, led_patterns_t);
+//     ...
+//     reef_state_restore(&patterns_state, &patterns);   // app_main, first
+//     reef_state_start();
+//     ...
+//     reef_state_put(&patterns_state, &patterns);       // any task
+//
+// reef_state_put() only copies into the section's staging buffer; it never
+// waits or touches flash. A low-priority task writes changed sections to
+// RTC slow memory every REEF_STATE_RTC_PERIOD_MS, and to NVS every
+// REEF_STATE_NVS_PERIOD_MS. RTC memory survives software, watchdog and
+// panic resets; NVS also survives power loss. Every record carries the
+// section's version and a CRC, and RTC memory holds two records per
+// section, so a reset in the middle of a write leaves the previous one.
+// Bump a section's version when its layout changes; old records are then
+// ignored.
+//
+// reef_state_first_output() reports the time from boot to the app's first
+// useful output, and where its state came from. Build with
+// `idf.py -DREEF_STATE_RESTORE=OFF build` to keep writing snapshots but
+// always start cold, for the comparison.
+
+// RTC slow memory reserved for records (two per section)
+#define REEF_STATE_RTC_BYTES 2048
+
+// Largest section
+#define REEF_STATE_SECTION_MAX 512
+
+#define REEF_STATE_MAX_SECTIONS 8
+
+#define REEF_STATE_RTC_PERIOD_MS 100
+#define REEF_STATE_NVS_PERIOD_MS 30000
+
+typedef struct reef_state
+{
+    const char *name; // also the NVS key, at most 15 characters
+    uint16_t version;
+    uint16_t size;
+    uint8_t *staging;
+
+    // Written by reef_state_put(): odd while a copy is in progress
+    uint32_t seq;
+
+    // Writer task only
+    uint32_t rtc_seq;
+    uint32_t nvs_seq;
+    uint32_t gen;
+    uint32_t rtc_offset;
+    uint8_t rtc_slot;
+} reef_state_t;
+
+#define REEF_STATE_DEFINE(var, key, ver, type)                                 \
+    static uint8_t reef_state_buf_##var[sizeof(type)] __attribute__((aligned(4))); \
+    _Static_assert(sizeof(type) <= REEF_STATE_SECTION_MAX, key " too large");  \
+    static reef_state_t var = {                                                \
+        .name = (key),                                                         \
+        .version = (ver),                                                      \
+        .size = sizeof(type),                                                  \
+        .staging = reef_state_buf_##var,                                       \
+    }
+
+// Registers the section and fills `dst` from RTC memory, else NVS. Returns
+// false, leaving `dst` alone, when neither holds a valid record. Call once
+// per section, in the same order on every boot, before reef_state_start().
+bool reef_state_restore(reef_state_t *state, void *dst);
+
+// Hands over the current state. Callers of one section must not put
+// concurrently (hold the lock that guards the state anyway).
+void reef_state_put(reef_state_t *state, const void *src);
+
+// Starts the writer task
+void reef_state_start(void);
+
+// Logs the time since boot the first time it is called, with the restore
+// source ("rtc", "nvs", "cold") and the reset reason
+void reef_state_first_output(const char *what);
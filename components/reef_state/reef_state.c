@@ -0,0 +1,389 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "reef_mem.h"
+#include "reef_state.h"
+
+#ifndef REEF_STATE_RESTORE
+#define REEF_STATE_RESTORE 1
+#endif
+
+static const char *TAG = "REEF_STATE";
+
+#define NVS_NAMESPACE "reef_state"
+#define RECORD_MAGIC 0x52535431 // "RST1"
+#define NO_RTC UINT32_MAX
+
+// Records -------------------------------------------------------------------- //
+typedef struct
+{
+    uint32_t magic;
+    uint32_t name_hash;
+    uint16_t version;
+    uint16_t size;
+    uint32_t gen;
+    uint32_t crc; // of the fields above and the data
+} record_t;
+
+#define ALIGN4(n) (((n) + 3) & ~3u)
+#define RECORD_BYTES(size) (sizeof(record_t) + ALIGN4(size))
+
+static RTC_NOINIT_ATTR uint32_t rtc_area[REEF_STATE_RTC_BYTES / 4];
+static uint32_t rtc_used = 0;
+
+static reef_state_t *sections[REEF_STATE_MAX_SECTIONS];
+static int n_sections = 0;
+
+static int restored_rtc = 0;
+static int restored_nvs = 0;
+static bool nvs_ready = false;
+
+static uint32_t name_hash(const char *name)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    while (*name)
+    {
+        h = (h ^ (uint8_t)*name++) * 16777619u;
+    }
+    return h;
+}
+
+static uint32_t record_crc(const record_t *rec)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)rec, offsetof(record_t, crc));
+    return esp_rom_crc32_le(crc, (const uint8_t *)(rec + 1), rec->size);
+}
+
+static bool record_valid(const reef_state_t *state, const record_t *rec)
+{
+    return rec->magic == RECORD_MAGIC &&
+           rec->name_hash == name_hash(state->name) &&
+           rec->version == state->version &&
+           rec->size == state->size &&
+           rec->crc == record_crc(rec);
+}
+
+static record_t *rtc_record(const reef_state_t *state, int slot)
+{
+    uint8_t *base = (uint8_t *)rtc_area + state->rtc_offset;
+    return (record_t *)(base + slot * RECORD_BYTES(state->size));
+}
+
+// Restore -------------------------------------------------------------------- //
+static void nvs_open_once(void)
+{
+    static bool tried = false;
+    if (tried)
+    {
+        return;
+    }
+    tried = true;
+
+    // reef_net initializes NVS again later and erases it if it has to;
+    // here a partition that needs erasing just means no NVS records
+    esp_err_t err = nvs_flash_init();
+    nvs_ready = err == ESP_OK;
+    if (!nvs_ready)
+    {
+        ESP_LOGW(TAG, "NVS not usable yet: %s", esp_err_to_name(err));
+    }
+}
+
+// Newer of the two RTC records, or NULL
+static const record_t *restore_rtc(const reef_state_t *state)
+{
+    if (state->rtc_offset == NO_RTC)
+    {
+        return NULL;
+    }
+
+    const record_t *a = rtc_record(state, 0);
+    const record_t *b = rtc_record(state, 1);
+    bool a_ok = record_valid(state, a);
+    bool b_ok = record_valid(state, b);
+
+    if (a_ok && b_ok)
+    {
+        return (int32_t)(a->gen - b->gen) > 0 ? a : b;
+    }
+    return a_ok ? a : b_ok ? b : NULL;
+}
+
+static bool restore_nvs(const reef_state_t *state, record_t *rec)
+{
+    nvs_open_once();
+    if (!nvs_ready)
+    {
+        return false;
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return false;
+    }
+
+    size_t len = RECORD_BYTES(state->size);
+    esp_err_t err = nvs_get_blob(nvs, state->name, rec, &len);
+    nvs_close(nvs);
+
+    return err == ESP_OK && len == RECORD_BYTES(state->size) && record_valid(state, rec);
+}
+
+bool reef_state_restore(reef_state_t *state, void *dst)
+{
+    if (n_sections == REEF_STATE_MAX_SECTIONS)
+    {
+        ESP_LOGE(TAG, "%s: too many sections, raise REEF_STATE_MAX_SECTIONS", state->name);
+        return false;
+    }
+    sections[n_sections++] = state;
+
+    // Two records per section, laid out in registration order
+    uint32_t bytes = 2 * RECORD_BYTES(state->size);
+    if (rtc_used + bytes <= sizeof(rtc_area))
+    {
+        state->rtc_offset = rtc_used;
+        rtc_used += bytes;
+    }
+    else
+    {
+        state->rtc_offset = NO_RTC;
+        ESP_LOGW(TAG, "%s: RTC area full (%u B), NVS only", state->name,
+                 (unsigned)sizeof(rtc_area));
+    }
+
+#if REEF_STATE_RESTORE
+    static uint32_t scratch[(sizeof(record_t) + REEF_STATE_SECTION_MAX) / 4];
+    record_t *nvs_rec = (record_t *)scratch;
+
+    const record_t *rec = restore_rtc(state);
+    const char *source = "rtc";
+    if (!rec && restore_nvs(state, nvs_rec))
+    {
+        rec = nvs_rec;
+        source = "nvs";
+    }
+
+    if (!rec)
+    {
+        ESP_LOGI(TAG, "%s: no snapshot, starting cold", state->name);
+        return false;
+    }
+
+    memcpy(dst, rec + 1, state->size);
+    memcpy(state->staging, rec + 1, state->size);
+    state->gen = rec->gen;
+    state->rtc_slot = rec == rtc_record(state, 0) ? 1 : 0;
+
+    // The writer task brings the other copy up to date
+    if (rec == nvs_rec)
+    {
+        state->rtc_seq = UINT32_MAX;
+        restored_nvs++;
+    }
+    else
+    {
+        state->nvs_seq = UINT32_MAX;
+        restored_rtc++;
+    }
+
+    ESP_LOGI(TAG, "%s: restored from %s (gen %lu, %u B)", state->name, source,
+             (unsigned long)rec->gen, state->size);
+    return true;
+#else
+    (void)dst;
+    ESP_LOGI(TAG, "%s: restore disabled (REEF_STATE_RESTORE=OFF)", state->name);
+    return false;
+#endif
+}
+
+// Put ------------------------------------------------------------------------ //
+void reef_state_put(reef_state_t *state, const void *src)
+{
+    // Seqlock: the writer task retries if the sequence moved under it
+    uint32_t seq = state->seq;
+    __atomic_store_n(&state->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(state->staging, src, state->size);
+    __atomic_store_n(&state->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Writer --------------------------------------------------------------------- //
+// A stable copy of the staging buffer into rec's data; false if puts kept
+// coming
+static bool snapshot(reef_state_t *state, record_t *rec, uint32_t *seq_out)
+{
+    for (int tries = 0; tries < 4; tries++)
+    {
+        uint32_t seq = __atomic_load_n(&state->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+        {
+            vTaskDelay(1);
+            continue;
+        }
+
+        memcpy(rec + 1, state->staging, state->size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&state->seq, __ATOMIC_RELAXED) == seq)
+        {
+            *seq_out = seq;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void write_nvs(reef_state_t *state, const record_t *rec)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        return;
+    }
+
+    esp_err_t err = nvs_set_blob(nvs, state->name, rec, RECORD_BYTES(state->size));
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "%s: NVS write failed: %s", state->name, esp_err_to_name(err));
+    }
+}
+
+static void write_section(reef_state_t *state, bool nvs_due)
+{
+    uint32_t seq = __atomic_load_n(&state->seq, __ATOMIC_ACQUIRE);
+    bool rtc = seq != state->rtc_seq && state->rtc_offset != NO_RTC;
+    bool nvs = nvs_due && seq != state->nvs_seq;
+    if (!rtc && !nvs)
+    {
+        return;
+    }
+
+    static uint32_t scratch[(sizeof(record_t) + REEF_STATE_SECTION_MAX) / 4];
+    record_t *rec = (record_t *)scratch;
+    if (!snapshot(state, rec, &seq))
+    {
+        return;
+    }
+
+    rec->magic = RECORD_MAGIC;
+    rec->name_hash = name_hash(state->name);
+    rec->version = state->version;
+    rec->size = state->size;
+    rec->gen = ++state->gen;
+    rec->crc = record_crc(rec);
+
+    if (rtc)
+    {
+        // Overwrite the older record; the newer one stays valid meanwhile
+        memcpy(rtc_record(state, state->rtc_slot), rec, RECORD_BYTES(state->size));
+        state->rtc_slot ^= 1;
+        state->rtc_seq = seq;
+    }
+    if (nvs)
+    {
+        write_nvs(state, rec);
+        state->nvs_seq = seq;
+    }
+}
+
+REEF_TASK_STORAGE(state_writer, 4096);
+
+static void writer_task(void *arg)
+{
+    int64_t next_nvs_ms = esp_timer_get_time() / 1000 + REEF_STATE_NVS_PERIOD_MS;
+
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(REEF_STATE_RTC_PERIOD_MS));
+
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        bool nvs_due = now_ms >= next_nvs_ms;
+        if (nvs_due)
+        {
+            next_nvs_ms = now_ms + REEF_STATE_NVS_PERIOD_MS;
+        }
+
+        for (int i = 0; i < n_sections; i++)
+        {
+            write_section(sections[i], nvs_due);
+        }
+    }
+}
+
+void reef_state_start(void)
+{
+    static bool started = false;
+    if (started)
+    {
+        return;
+    }
+    started = true;
+
+    ESP_LOGI(TAG, "%d sections, %lu/%u B of RTC memory", n_sections,
+             (unsigned long)rtc_used, (unsigned)sizeof(rtc_area));
+    REEF_TASK_CREATE(state_writer, writer_task, "reef_state", NULL, 1,
+                     REEF_CORE_BACKGROUND);
+}
+
+// Report --------------------------------------------------------------------- //
+static const char *reset_name(esp_reset_reason_t reason)
+{
+    switch (reason)
+    {
+    case ESP_RST_POWERON:
+        return "power-on";
+    case ESP_RST_SW:
+        return "software";
+    case ESP_RST_PANIC:
+        return "panic";
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+        return "watchdog";
+    case ESP_RST_BROWNOUT:
+        return "brownout";
+    case ESP_RST_DEEPSLEEP:
+        return "deep sleep";
+    default:
+        return "other";
+    }
+}
+
+void reef_state_first_output(const char *what)
+{
+    static bool reported = false;
+    if (__atomic_exchange_n(&reported, true, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    const char *source = restored_rtc && restored_nvs ? "rtc+nvs"
+                         : restored_rtc               ? "rtc"
+                         : restored_nvs               ? "nvs"
+                                                      : "cold";
+
+    ESP_LOGI(TAG, "First useful output (%s) %lld ms after boot, state: %s, reset: %s",
+             what, (long long)(esp_timer_get_time() / 1000), source,
+             reset_name(esp_reset_reason()));
+}
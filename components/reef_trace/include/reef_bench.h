@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+// Latency histograms for the critical paths, compiled in with
+// `idf.py -DREEF_BENCH=ON`.
+//
+//     REEF_BENCH_DEFINE(distress_ack, "distress_ack");
+//     ...
+//     msg.rx_us = REEF_BENCH_NOW();
+//     ...
+//     REEF_BENCH_RECORD(distress_ack, REEF_BENCH_NOW() - msg.rx_us);
+//
+// Every REEF_BENCH_PERIOD_S a low-priority task logs one line per
+// histogram, cumulative since boot:
+//
+//     BENCH <profile> <name> n=<count> p50=.. p90=.. p99=.. p999=.. max=.. | <bucket>:<count> ...
+//
+// tools/profile_bench.py in reef_profile collects these lines per
+// placement profile and compares the distributions. Buckets are log-linear
+// (4 per power of two, exact below 16 us). Without REEF_BENCH the macros
+// compile to nothing and REEF_BENCH_NOW() is 0.
+
+#define REEF_BENCH_PERIOD_S 10
+#define REEF_BENCH_BUCKETS 128
+#define REEF_BENCH_MAX 8
+
+#if REEF_BENCH
+
+#include "esp_timer.h"
+
+typedef struct reef_bench
+{
+    const char *name;
+    uint32_t registered;
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t buckets[REEF_BENCH_BUCKETS];
+} reef_bench_t;
+
+// Adds one sample (microseconds); safe from any task, not from ISRs
+void reef_bench_record(reef_bench_t *bench, int64_t us);
+
+// Starts the report task; call once from app_main
+void reef_bench_start(void);
+
+#define REEF_BENCH_DEFINE(var, label) static reef_bench_t var = {.name = (label)}
+#define REEF_BENCH_RECORD(var, us) reef_bench_record(&(var), (us))
+#define REEF_BENCH_NOW() esp_timer_get_time()
+
+#else
+
+#define REEF_BENCH_DEFINE(var, label) extern int reef_bench_unused_##var
+#define REEF_BENCH_RECORD(var, us) ((void)sizeof(us))
+#define REEF_BENCH_NOW() ((int64_t)0)
+
+static inline void reef_bench_start(void)
+{
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "mqtt_client.h"
+
+// Lightweight runtime tracing, compiled in with `idf.py -DREEF_TRACE=ON`.
+//
+// - Task switches, operations on registered queues and MQTT handler
+//   entry/exit go into a fixed ring with microsecond timestamps.
+// - A low-priority task publishes a compact binary snapshot on a metrics
+//   topic: CPU time and stack headroom per task, queue depths, handler
+//   latencies, and the ring events since the previous snapshot.
+// - tools/reef_trace_decode.py captures snapshots and converts them to
+//   Chrome trace / Perfetto JSON.
+//
+// Without REEF_TRACE every call below compiles to nothing.
+
+#if REEF_TRACE
+
+// Starts publishing snapshots on `topic` every `period_ms` (QoS 0)
+void reef_trace_start(esp_mqtt_client_handle_t client, const char *topic,
+                      uint32_t period_ms);
+
+// Traces sends/receives and depth of a queue, mutex or semaphore.
+// Call once, before the queue is shared.
+void reef_trace_queue(QueueHandle_t queue, const char *name);
+
+// Brackets an MQTT event handler; reef_net does this for the app's handler
+uint32_t reef_trace_mqtt_enter(int32_t event_id);
+void reef_trace_mqtt_exit(int32_t event_id, uint32_t t_enter);
+
+#else
+
+static inline void reef_trace_start(esp_mqtt_client_handle_t client,
+                                    const char *topic, uint32_t period_ms)
+{
+}
+
+static inline void reef_trace_queue(QueueHandle_t queue, const char *name)
+{
+}
+
+static inline uint32_t reef_trace_mqtt_enter(int32_t event_id)
+{
+    return 0;
+}
+
+static inline void reef_trace_mqtt_exit(int32_t event_id, uint32_t t_enter)
+{
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+// FreeRTOS trace macros for REEF_TRACE builds. Force-included into every C
+// file (see reef_trace.cmake), ahead of FreeRTOS.h, so only plain C here.
+
+// Ring event types, shared with reef_trace.c and tools/reef_trace_decode.py
+enum
+{
+    REEF_EV_SWITCH = 1,  // task switched in, arg = core
+    REEF_EV_QUEUE_SEND,  // arg = queue id << 8 | depth after
+    REEF_EV_QUEUE_RECV,
+    REEF_EV_QUEUE_FAIL,  // send on a full queue
+    REEF_EV_MQTT_ENTER,  // arg = MQTT event id
+    REEF_EV_MQTT_EXIT,
+};
+
+void reef_trace_task_switched_in(void);
+void reef_trace_task_deleted(void *task);
+void reef_trace_queue_op(void *queue, unsigned type, int from_isr);
+
+#define traceTASK_SWITCHED_IN() reef_trace_task_switched_in()
+#define traceTASK_DELETE(pxTCB) reef_trace_task_deleted(pxTCB)
+
+#define traceQUEUE_SEND(pxQueue) \
+    reef_trace_queue_op(pxQueue, REEF_EV_QUEUE_SEND, 0)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) \
+    reef_trace_queue_op(pxQueue, REEF_EV_QUEUE_SEND, 1)
+#define traceQUEUE_RECEIVE(pxQueue) \
+    reef_trace_queue_op(pxQueue, REEF_EV_QUEUE_RECV, 0)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) \
+    reef_trace_queue_op(pxQueue, REEF_EV_QUEUE_RECV, 1)
+#define traceQUEUE_SEND_FAILED(pxQueue) \
+    reef_trace_queue_op(pxQueue, REEF_EV_QUEUE_FAIL, 0)
+#define traceQUEUE_SEND_FROM_ISR_FAILED(pxQueue) \
+    reef_trace_queue_op(pxQueue, REEF_EV_QUEUE_FAIL, 1)
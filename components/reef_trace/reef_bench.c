@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+
+#include "reef_bench.h"
+#include "reef_mem.h"
+#include "reef_profile.h"
+
+#if REEF_BENCH
+
+static const char *TAG = "REEF_BENCH";
+
+static reef_bench_t *benches[REEF_BENCH_MAX];
+static int n_benches = 0;
+
+// Buckets ------------------------------------------------------------------- //
+// 0-15 us exact, then 4 per power of two: 16, 20, 24, 28, 32, 40, ...
+static int bucket_of(uint32_t us)
+{
+    if (us < 16)
+    {
+        return us;
+    }
+    int octave = 31 - __builtin_clz(us);
+    int sub = (us >> (octave - 2)) & 3;
+    int i = 16 + (octave - 4) * 4 + sub;
+    return i < REEF_BENCH_BUCKETS ? i : REEF_BENCH_BUCKETS - 1;
+}
+
+// Upper edge of a bucket, what the percentiles report
+static uint32_t bucket_top(int i)
+{
+    if (i < 16)
+    {
+        return i;
+    }
+    int octave = 4 + (i - 16) / 4;
+    int sub = (i - 16) % 4;
+    return (((4u + sub + 1) << (octave - 2))) - 1;
+}
+
+void reef_bench_record(reef_bench_t *bench, int64_t us)
+{
+    uint32_t v = us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+
+    // First sample registers the histogram with the reporter
+    uint32_t expected = 0;
+    if (__atomic_compare_exchange_n(&bench->registered, &expected, 1, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+        int slot = __atomic_fetch_add(&n_benches, 1, __ATOMIC_RELAXED);
+        if (slot < REEF_BENCH_MAX)
+        {
+            __atomic_store_n(&benches[slot], bench, __ATOMIC_RELEASE);
+        }
+    }
+
+    __atomic_fetch_add(&bench->buckets[bucket_of(v)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bench->count, 1, __ATOMIC_RELAXED);
+
+    uint32_t max = __atomic_load_n(&bench->max_us, __ATOMIC_RELAXED);
+    while (v > max && !__atomic_compare_exchange_n(&bench->max_us, &max, v, true,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+// Report --------------------------------------------------------------------- //
+static uint32_t percentile(const uint32_t *buckets, uint32_t count, uint32_t per_mille)
+{
+    uint32_t rank = ((uint64_t)count * per_mille + 999) / 1000;
+    uint32_t seen = 0;
+    for (int i = 0; i < REEF_BENCH_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            return bucket_top(i);
+        }
+    }
+    return bucket_top(REEF_BENCH_BUCKETS - 1);
+}
+
+static void report(const reef_bench_t *bench)
+{
+    uint32_t buckets[REEF_BENCH_BUCKETS];
+    uint32_t count = 0;
+    for (int i = 0; i < REEF_BENCH_BUCKETS; i++)
+    {
+        buckets[i] = __atomic_load_n(&bench->buckets[i], __ATOMIC_RELAXED);
+        count += buckets[i];
+    }
+    if (!count)
+    {
+        return;
+    }
+
+    // Non-empty buckets, for the host tool to merge runs
+    char line[512];
+    int len = 0;
+    for (int i = 0; i < REEF_BENCH_BUCKETS && len < (int)sizeof(line) - 16; i++)
+    {
+        if (buckets[i])
+        {
+            len += snprintf(line + len, sizeof(line) - len, " %d:%lu",
+                            i, (unsigned long)buckets[i]);
+        }
+    }
+
+    ESP_LOGI(TAG, "BENCH %s %s n=%lu p50=%lu p90=%lu p99=%lu p999=%lu max=%lu |%s",
+             REEF_PROFILE_NAME, bench->name, (unsigned long)count,
+             (unsigned long)percentile(buckets, count, 500),
+             (unsigned long)percentile(buckets, count, 900),
+             (unsigned long)percentile(buckets, count, 990),
+             (unsigned long)percentile(buckets, count, 999),
+             (unsigned long)__atomic_load_n(&bench->max_us, __ATOMIC_RELAXED),
+             line);
+}
+
+REEF_TASK_STORAGE(bench_report, 3072);
+
+static void report_task(void *arg)
+{
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(REEF_BENCH_PERIOD_S * 1000));
+
+        int n = __atomic_load_n(&n_benches, __ATOMIC_RELAXED);
+        for (int i = 0; i < n && i < REEF_BENCH_MAX; i++)
+        {
+            const reef_bench_t *bench = __atomic_load_n(&benches[i], __ATOMIC_ACQUIRE);
+            if (bench)
+            {
+                report(bench);
+            }
+        }
+    }
+}
+
+void reef_bench_start(void)
+{
+    static bool started = false;
+    if (started)
+    {
+        return;
+    }
+    started = true;
+
+    ESP_LOGI(TAG, "Profile %s, latency report every %d s",
+             REEF_PROFILE_NAME, REEF_BENCH_PERIOD_S);
+    REEF_TASK_CREATE(bench_report, report_task, "reef_bench", NULL, 1,
+                     REEF_CORE_BACKGROUND);
+}
+
+#endif
@@ -0,0 +1,479 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "reef_mem.h"
+#include "reef_trace.h"
+
+#if REEF_TRACE
+
+#if !CONFIG_FREERTOS_USE_TRACE_FACILITY
+#error "REEF_TRACE needs CONFIG_FREERTOS_USE_TRACE_FACILITY (delete sdkconfig to pick up sdkconfig.trace)"
+#endif
+
+#if CONFIG_APPTRACE_SV_ENABLE
+#error "REEF_TRACE and SystemView both define the FreeRTOS trace macros"
+#endif
+
+static const char *TAG = "REEF_TRACE";
+
+// Sizes ---------------------------------------------------------------------- //
+#define RING_EVENTS 2048     // power of two, 8 bytes each
+#define SNAPSHOT_EVENTS 512  // newest ring events sent per snapshot
+#define MAX_TASKS 32         // slot 0 collects everything past this
+#define MAX_QUEUES 16
+#define MQTT_EVENT_IDS 16
+#define NAME_LEN 16
+#define ISR_SLOT 0xff
+
+// Wire format ---------------------------------------------------------------- //
+// Little-endian and packed; bump the version on any change and keep
+// tools/reef_trace_decode.py in step.
+#define SNAPSHOT_MAGIC 0x5452 // "RT"
+#define SNAPSHOT_VERSION 1
+
+typedef struct __attribute__((packed))
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t cores;
+    uint32_t seq;
+    uint64_t uptime_us;
+    uint32_t window_us;
+    uint32_t dropped;   // ring events lost since the previous snapshot
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint8_t n_tasks;
+    uint8_t n_queues;
+    uint8_t n_handlers;
+    uint8_t reserved;
+    uint16_t n_events;
+} snap_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t slot;
+    uint8_t priority;
+    uint16_t stack_free; // bytes, lowest so far; 0 once the task is gone
+    uint32_t run_us;     // CPU time during the window
+    char name[NAME_LEN];
+} snap_task_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t id;
+    uint8_t depth;
+    uint8_t peak;        // highest depth during the window
+    uint8_t length;
+    uint16_t sends;
+    uint16_t receives;
+    uint16_t fails;
+    char name[NAME_LEN];
+} snap_queue_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t event_id;
+    uint8_t reserved;
+    uint16_t count;
+    uint32_t total_us;
+    uint32_t max_us;
+} snap_handler_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t t_us;       // low 32 bits of esp_timer_get_time()
+    uint8_t type;        // REEF_EV_*
+    uint8_t task;        // slot, or ISR_SLOT
+    uint16_t arg;
+} trace_event_t;
+
+// State ---------------------------------------------------------------------- //
+typedef struct
+{
+    TaskHandle_t handle; // NULL once deleted
+    uint32_t run_us;
+    char name[NAME_LEN];
+} task_slot_t;
+
+typedef struct
+{
+    QueueHandle_t handle;
+    uint8_t length;
+    uint8_t peak;
+    uint16_t sends;
+    uint16_t receives;
+    uint16_t fails;
+    char name[NAME_LEN];
+} queue_slot_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t total_us;
+    uint32_t max_us;
+} handler_stat_t;
+
+// Task numbers start at 0 in the kernel, so 0 means "no slot yet"; slot 0
+// itself is the overflow bucket
+static task_slot_t tasks[MAX_TASKS] = {[0] = {.name = "other"}};
+static uint32_t next_task_slot = 1;
+
+static queue_slot_t queues[MAX_QUEUES + 1]; // by id, 1-based
+static uint32_t n_queues = 0;
+
+static handler_stat_t handlers[MQTT_EVENT_IDS];
+static portMUX_TYPE handler_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static trace_event_t ring[RING_EVENTS];
+static uint32_t ring_head = 0;  // next write, free running
+static uint32_t ring_tail = 0;  // next event to send
+
+static uint8_t cur_slot[portNUM_PROCESSORS];
+static uint32_t cur_since[portNUM_PROCESSORS];
+
+static esp_mqtt_client_handle_t snap_client;
+static const char *snap_topic;
+static TickType_t snap_period;
+static uint32_t snap_seq = 0;
+static int64_t window_start_us;
+
+static uint8_t snap_buf[sizeof(snap_header_t) +
+                        MAX_TASKS * sizeof(snap_task_t) +
+                        MAX_QUEUES * sizeof(snap_queue_t) +
+                        MQTT_EVENT_IDS * sizeof(snap_handler_t) +
+                        SNAPSHOT_EVENTS * sizeof(trace_event_t)];
+
+// Recording ------------------------------------------------------------------ //
+// Everything here may run inside the scheduler or an ISR with the flash
+// cache off: IRAM only, no locks beyond the caller's.
+
+static inline uint32_t now32(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static inline void copy_name(char *dst, const char *src)
+{
+    for (int i = 0; i < NAME_LEN; i++)
+    {
+        dst[i] = src[i];
+        if (!src[i])
+        {
+            break;
+        }
+    }
+}
+
+// Lock-free across cores: claim an index, then fill it. A reader racing a
+// writer can see one stale event, which is fine for tracing.
+static IRAM_ATTR void record(uint8_t type, uint8_t task, uint16_t arg)
+{
+    uint32_t i = __atomic_fetch_add(&ring_head, 1, __ATOMIC_RELAXED);
+    trace_event_t *e = &ring[i & (RING_EVENTS - 1)];
+    e->t_us = now32();
+    e->type = type;
+    e->task = task;
+    e->arg = arg;
+}
+
+static IRAM_ATTR UBaseType_t assign_slot(TaskHandle_t task)
+{
+    if (__atomic_load_n(&next_task_slot, __ATOMIC_RELAXED) >= MAX_TASKS)
+    {
+        return 0;
+    }
+
+    uint32_t slot = __atomic_fetch_add(&next_task_slot, 1, __ATOMIC_RELAXED);
+    if (slot >= MAX_TASKS)
+    {
+        return 0;
+    }
+
+    tasks[slot].handle = task;
+    copy_name(tasks[slot].name, pcTaskGetName(task));
+    vTaskSetTaskNumber(task, slot);
+    return slot;
+}
+
+void IRAM_ATTR reef_trace_task_switched_in(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    UBaseType_t slot = uxTaskGetTaskNumber(task);
+    if (slot == 0)
+    {
+        slot = assign_slot(task);
+    }
+
+    int core = xPortGetCoreID();
+    uint32_t now = now32();
+    __atomic_fetch_add(&tasks[cur_slot[core]].run_us, now - cur_since[core],
+                       __ATOMIC_RELAXED);
+    cur_slot[core] = slot;
+    cur_since[core] = now;
+
+    record(REEF_EV_SWITCH, slot, core);
+}
+
+void IRAM_ATTR reef_trace_task_deleted(void *task)
+{
+    UBaseType_t slot = uxTaskGetTaskNumber(task);
+    if (slot > 0 && slot < MAX_TASKS)
+    {
+        tasks[slot].handle = NULL;
+    }
+}
+
+// Called with the queue locked, before the item is copied in or out
+void IRAM_ATTR reef_trace_queue_op(void *queue, unsigned type, int from_isr)
+{
+    UBaseType_t id = uxQueueGetQueueNumber(queue);
+    if (id == 0 || id > MAX_QUEUES)
+    {
+        return;
+    }
+
+    queue_slot_t *q = &queues[id];
+    UBaseType_t depth = uxQueueMessagesWaitingFromISR(queue);
+
+    switch (type)
+    {
+    case REEF_EV_QUEUE_SEND:
+        depth++;
+        q->sends++;
+        break;
+    case REEF_EV_QUEUE_RECV:
+        depth = depth ? depth - 1 : 0;
+        q->receives++;
+        break;
+    default:
+        q->fails++;
+        break;
+    }
+
+    if (depth > 0xff)
+    {
+        depth = 0xff;
+    }
+    if (depth > q->peak)
+    {
+        q->peak = depth;
+    }
+
+    uint8_t task = from_isr ? ISR_SLOT : cur_slot[xPortGetCoreID()];
+    record(type, task, (uint16_t)(id << 8 | depth));
+}
+
+uint32_t reef_trace_mqtt_enter(int32_t event_id)
+{
+    record(REEF_EV_MQTT_ENTER, cur_slot[xPortGetCoreID()], (uint16_t)event_id);
+    return now32();
+}
+
+void reef_trace_mqtt_exit(int32_t event_id, uint32_t t_enter)
+{
+    uint32_t took = now32() - t_enter;
+    record(REEF_EV_MQTT_EXIT, cur_slot[xPortGetCoreID()], (uint16_t)event_id);
+
+    if (event_id < 0 || event_id >= MQTT_EVENT_IDS)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&handler_lock);
+    handler_stat_t *h = &handlers[event_id];
+    h->count++;
+    h->total_us += took;
+    if (took > h->max_us)
+    {
+        h->max_us = took;
+    }
+    portEXIT_CRITICAL(&handler_lock);
+}
+
+void reef_trace_queue(QueueHandle_t queue, const char *name)
+{
+    if (!queue || n_queues >= MAX_QUEUES)
+    {
+        ESP_LOGW(TAG, "Not tracing queue %s", name);
+        return;
+    }
+
+    queue_slot_t *q = &queues[++n_queues];
+    q->handle = queue;
+    q->length = uxQueueSpacesAvailable(queue) + uxQueueMessagesWaiting(queue);
+    copy_name(q->name, name);
+    vQueueSetQueueNumber(queue, n_queues);
+}
+
+// Snapshot ------------------------------------------------------------------- //
+static uint8_t *put(uint8_t *p, const void *src, size_t len)
+{
+    memcpy(p, src, len);
+    return p + len;
+}
+
+static size_t build_snapshot(void)
+{
+    int64_t now = esp_timer_get_time();
+    snap_header_t h = {
+        .magic = SNAPSHOT_MAGIC,
+        .version = SNAPSHOT_VERSION,
+        .cores = portNUM_PROCESSORS,
+        .seq = snap_seq++,
+        .uptime_us = now,
+        .window_us = now - window_start_us,
+        .free_heap = esp_get_free_heap_size(),
+        .min_free_heap = esp_get_minimum_free_heap_size(),
+    };
+    window_start_us = now;
+
+    uint8_t *p = snap_buf + sizeof(h);
+
+    // Tasks; the slice running right now is counted in the next window
+    uint32_t n_tasks = __atomic_load_n(&next_task_slot, __ATOMIC_RELAXED);
+    if (n_tasks > MAX_TASKS)
+    {
+        n_tasks = MAX_TASKS;
+    }
+
+    for (uint32_t i = 0; i < n_tasks; i++)
+    {
+        task_slot_t *t = &tasks[i];
+        snap_task_t row = {
+            .slot = i,
+            .run_us = __atomic_exchange_n(&t->run_us, 0, __ATOMIC_RELAXED),
+        };
+        memcpy(row.name, t->name, NAME_LEN);
+
+        TaskHandle_t task = t->handle;
+        if (task)
+        {
+            UBaseType_t free = uxTaskGetStackHighWaterMark(task);
+            row.priority = uxTaskPriorityGet(task);
+            row.stack_free = free > UINT16_MAX ? UINT16_MAX : free;
+        }
+        p = put(p, &row, sizeof(row));
+    }
+    h.n_tasks = n_tasks;
+
+    // Queues; counters are reset without the queue lock, so they can be
+    // off by the odd operation
+    for (uint32_t id = 1; id <= n_queues; id++)
+    {
+        queue_slot_t *q = &queues[id];
+        UBaseType_t depth = uxQueueMessagesWaiting(q->handle);
+        snap_queue_t row = {
+            .id = id,
+            .depth = depth > 0xff ? 0xff : depth,
+            .peak = q->peak,
+            .length = q->length,
+            .sends = q->sends,
+            .receives = q->receives,
+            .fails = q->fails,
+        };
+        memcpy(row.name, q->name, NAME_LEN);
+        q->peak = row.depth;
+        q->sends = q->receives = q->fails = 0;
+        p = put(p, &row, sizeof(row));
+    }
+    h.n_queues = n_queues;
+
+    // Handler latencies, only for events that occurred
+    handler_stat_t stats[MQTT_EVENT_IDS];
+    portENTER_CRITICAL(&handler_lock);
+    memcpy(stats, handlers, sizeof(stats));
+    memset(handlers, 0, sizeof(handlers));
+    portEXIT_CRITICAL(&handler_lock);
+
+    for (int id = 0; id < MQTT_EVENT_IDS; id++)
+    {
+        if (!stats[id].count)
+        {
+            continue;
+        }
+
+        snap_handler_t row = {
+            .event_id = id,
+            .count = stats[id].count > UINT16_MAX ? UINT16_MAX : stats[id].count,
+            .total_us = stats[id].total_us,
+            .max_us = stats[id].max_us,
+        };
+        p = put(p, &row, sizeof(row));
+        h.n_handlers++;
+    }
+
+    // Ring events since the last snapshot; newest first if they don't fit
+    uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    uint32_t from = ring_tail;
+    uint32_t limit = RING_EVENTS < SNAPSHOT_EVENTS ? RING_EVENTS : SNAPSHOT_EVENTS;
+    if (head - from > limit)
+    {
+        h.dropped = head - from - limit;
+        from = head - limit;
+    }
+
+    for (uint32_t i = from; i != head; i++)
+    {
+        p = put(p, &ring[i & (RING_EVENTS - 1)], sizeof(trace_event_t));
+    }
+    h.n_events = head - from;
+    ring_tail = head;
+
+    memcpy(snap_buf, &h, sizeof(h));
+    return p - snap_buf;
+}
+
+REEF_TASK_STORAGE(snapshot, 4096);
+
+static void snapshot_task(void *arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1)
+    {
+        vTaskDelayUntil(&last_wake, snap_period);
+
+        size_t len = build_snapshot();
+
+        // QoS 0: a lost snapshot shows up as a sequence gap
+        if (esp_mqtt_client_publish(snap_client, snap_topic,
+                                    (const char *)snap_buf, len, 0, 0) < 0)
+        {
+            ESP_LOGD(TAG, "Snapshot %lu not sent", (unsigned long)snap_seq - 1);
+        }
+    }
+}
+
+void reef_trace_start(esp_mqtt_client_handle_t client, const char *topic,
+                      uint32_t period_ms)
+{
+    if (snap_client)
+    {
+        return;
+    }
+
+    snap_client = client;
+    snap_topic = topic;
+    snap_period = pdMS_TO_TICKS(period_ms);
+
+    // CPU shares count from here, not from boot
+    for (int i = 0; i < MAX_TASKS; i++)
+    {
+        __atomic_store_n(&tasks[i].run_us, 0, __ATOMIC_RELAXED);
+    }
+    window_start_us = esp_timer_get_time();
+
+    REEF_TASK_CREATE(snapshot, snapshot_task, "reef_trace", NULL, 1,
+                     REEF_CORE_BACKGROUND);
+    ESP_LOGI(TAG, "Snapshots every %lu ms on %s", (unsigned long)period_ms, topic);
+}
+
+#endif
@@ -0,0 +1,19 @@
+# Compile-time switch for reef_trace: idf.py -DREEF_TRACE=ON build
+#
+# Included from a project CMakeLists between project.cmake and project(),
+# the only place build properties and SDKCONFIG_DEFAULTS still apply to
+# every component.
+option(REEF_TRACE "Record task switches, queue and MQTT handler events" OFF)
+
+if(REEF_TRACE)
+    idf_build_set_property(COMPILE_DEFINITIONS "REEF_TRACE=1" APPEND)
+
+    # Kernel trace macros, seen by every C file including FreeRTOS itself
+    idf_build_set_property(C_COMPILE_OPTIONS
+        "-include;${CMAKE_CURRENT_LIST_DIR}/include/reef_trace_hooks.h" APPEND)
+
+    if(NOT DEFINED SDKCONFIG_DEFAULTS AND EXISTS ${CMAKE_SOURCE_DIR}/sdkconfig.defaults)
+        set(SDKCONFIG_DEFAULTS ${CMAKE_SOURCE_DIR}/sdkconfig.defaults)
+    endif()
+    list(APPEND SDKCONFIG_DEFAULTS ${CMAKE_CURRENT_LIST_DIR}/sdkconfig.trace)
+endif()
@@ -0,0 +1,284 @@
+"""Capture and decode reef_trace metrics snapshots.
+
+    # record snapshots from the metrics topic
+    python3 reef_trace_decode.py capture --broker localhost \\
+        --topic shouryadippizzachor/metrics/priority_guardian --seconds 30 cap.bin
+
+    # Chrome trace / Perfetto JSON (open in ui.perfetto.dev or chrome://tracing)
+    python3 reef_trace_decode.py convert cap.bin -o trace.json
+
+    # per-task CPU, stack, queue and handler tables of the last snapshot
+    python3 reef_trace_decode.py summary cap.bin
+
+A capture file is a sequence of <u32 length><snapshot> records. The snapshot
+layout matches the packed structs in reef_trace.c (version 1).
+"""
+import argparse
+import json
+import struct
+import sys
+import time
+
+MAGIC = 0x5452
+VERSION = 1
+
+HEADER = struct.Struct("<HBBIQIIIIBBBBH")
+TASK = struct.Struct("<BBHI16s")
+QUEUE = struct.Struct("<BBBBHHH16s")
+HANDLER = struct.Struct("<BBHII")
+EVENT = struct.Struct("<IBBH")
+
+# reef_trace_hooks.h
+EV_SWITCH, EV_QUEUE_SEND, EV_QUEUE_RECV, EV_QUEUE_FAIL, EV_MQTT_ENTER, EV_MQTT_EXIT = range(1, 7)
+ISR_SLOT = 0xFF
+
+# esp_mqtt_event_id_t
+MQTT_EVENTS = ["ERROR", "CONNECTED", "DISCONNECTED", "SUBSCRIBED", "UNSUBSCRIBED",
+               "PUBLISHED", "DATA", "BEFORE_CONNECT", "DELETED", "USER"]
+
+PID_CPU, PID_QUEUES, PID_MQTT, PID_METRICS = 1, 2, 3, 4
+
+
+def name_of(raw):
+    return raw.split(b"\0", 1)[0].decode(errors="replace")
+
+
+def mqtt_name(event_id):
+    return MQTT_EVENTS[event_id] if event_id < len(MQTT_EVENTS) else f"event {event_id}"
+
+
+def parse(payload):
+    fields = HEADER.unpack_from(payload, 0)
+    (magic, version, cores, seq, uptime, window, dropped, free_heap, min_heap,
+     n_tasks, n_queues, n_handlers, _, n_events) = fields
+    if magic != MAGIC or version != VERSION:
+        raise ValueError(f"not a v{VERSION} snapshot (magic {magic:#x}, v{version})")
+
+    off = HEADER.size
+    snap = {
+        "cores": cores, "seq": seq, "uptime_us": uptime, "window_us": window,
+        "dropped": dropped, "free_heap": free_heap, "min_free_heap": min_heap,
+        "tasks": [], "queues": [], "handlers": [], "events": [],
+    }
+
+    for _ in range(n_tasks):
+        slot, prio, stack, run, name = TASK.unpack_from(payload, off)
+        off += TASK.size
+        snap["tasks"].append({"slot": slot, "priority": prio, "stack_free": stack,
+                              "run_us": run, "name": name_of(name)})
+
+    for _ in range(n_queues):
+        qid, depth, peak, length, sends, recvs, fails, name = QUEUE.unpack_from(payload, off)
+        off += QUEUE.size
+        snap["queues"].append({"id": qid, "depth": depth, "peak": peak, "length": length,
+                               "sends": sends, "receives": recvs, "fails": fails,
+                               "name": name_of(name)})
+
+    for _ in range(n_handlers):
+        event_id, _, count, total, worst = HANDLER.unpack_from(payload, off)
+        off += HANDLER.size
+        snap["handlers"].append({"event": mqtt_name(event_id), "count": count,
+                                 "total_us": total, "max_us": worst})
+
+    # Events carry the low 32 bits of the timestamp; none is older than
+    # 71 minutes relative to the snapshot, so unwrap against its uptime
+    low = uptime & 0xFFFFFFFF
+    for _ in range(n_events):
+        t, kind, task, arg = EVENT.unpack_from(payload, off)
+        off += EVENT.size
+        snap["events"].append((uptime - ((low - t) & 0xFFFFFFFF), kind, task, arg))
+    snap["events"].sort()
+    return snap
+
+
+def read_capture(path):
+    snaps = []
+    with open(path, "rb") as f:
+        while True:
+            head = f.read(4)
+            if len(head) < 4:
+                break
+            (length,) = struct.unpack("<I", head)
+            payload = f.read(length)
+            try:
+                snaps.append(parse(payload))
+            except (ValueError, struct.error) as err:
+                print(f"skipping record: {err}", file=sys.stderr)
+    snaps.sort(key=lambda s: s["seq"])
+    return snaps
+
+
+# Capture -------------------------------------------------------------------- #
+def capture(args):
+    import paho.mqtt.client as mqtt
+
+    host, _, port = args.broker.partition(":")
+    count = 0
+
+    with open(args.output, "ab") as out:
+        def on_message(client, userdata, msg):
+            nonlocal count
+            out.write(struct.pack("<I", len(msg.payload)) + msg.payload)
+            count += 1
+
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+        client.on_message = on_message
+        client.connect(host, int(port or 1883))
+        client.subscribe(args.topic, qos=0)
+        client.loop_start()
+        try:
+            time.sleep(args.seconds)
+        except KeyboardInterrupt:
+            pass
+        client.loop_stop()
+
+    print(f"{count} snapshots -> {args.output}")
+
+
+# Chrome trace --------------------------------------------------------------- #
+def convert(args):
+    snaps = read_capture(args.capture)
+    if not snaps:
+        sys.exit("no snapshots")
+
+    out = []
+    names = {ISR_SLOT: "ISR"}
+    queue_names = {}
+    cores = max(s["cores"] for s in snaps)
+
+    def meta(pid, tid, kind, name):
+        out.append({"ph": "M", "pid": pid, "tid": tid, "name": kind,
+                    "args": {"name": name}})
+
+    meta(PID_CPU, 0, "process_name", "CPU")
+    meta(PID_QUEUES, 0, "process_name", "Queues")
+    meta(PID_MQTT, 0, "process_name", "MQTT handler")
+    meta(PID_METRICS, 0, "process_name", "Metrics")
+    for core in range(cores):
+        meta(PID_CPU, core, "thread_name", f"core {core}")
+
+    running = {}   # core -> (slot, since)
+    open_handlers = {}  # task -> depth of unmatched ENTERs
+    prev_seq = None
+
+    for snap in snaps:
+        for t in snap["tasks"]:
+            names[t["slot"]] = t["name"]
+        for q in snap["queues"]:
+            queue_names[q["id"]] = q["name"]
+
+        # A gap means missing switches: don't stretch slices across it
+        if snap["dropped"] or (prev_seq is not None and snap["seq"] != prev_seq + 1):
+            running.clear()
+        prev_seq = snap["seq"]
+
+        for ts, kind, task, arg in snap["events"]:
+            if kind == EV_SWITCH:
+                core = arg
+                if core in running:
+                    slot, since = running[core]
+                    out.append({"ph": "X", "pid": PID_CPU, "tid": core,
+                                "name": names.get(slot, f"task {slot}"),
+                                "ts": since, "dur": max(0, ts - since)})
+                running[core] = (task, ts)
+            elif kind in (EV_QUEUE_SEND, EV_QUEUE_RECV):
+                qid, depth = arg >> 8, arg & 0xFF
+                out.append({"ph": "C", "pid": PID_QUEUES, "ts": ts,
+                            "name": queue_names.get(qid, f"queue {qid}"),
+                            "args": {"depth": depth}})
+            elif kind == EV_QUEUE_FAIL:
+                qid = arg >> 8
+                out.append({"ph": "i", "pid": PID_QUEUES, "tid": 0, "s": "p", "ts": ts,
+                            "name": f"{queue_names.get(qid, qid)} full",
+                            "args": {"task": names.get(task, task)}})
+            elif kind == EV_MQTT_ENTER:
+                open_handlers[task] = open_handlers.get(task, 0) + 1
+                out.append({"ph": "B", "pid": PID_MQTT, "tid": task, "ts": ts,
+                            "name": mqtt_name(arg)})
+            elif kind == EV_MQTT_EXIT and open_handlers.get(task):
+                open_handlers[task] -= 1
+                out.append({"ph": "E", "pid": PID_MQTT, "tid": task, "ts": ts})
+
+        ts = snap["uptime_us"]
+        window = snap["window_us"] or 1
+        out.append({"ph": "C", "pid": PID_METRICS, "ts": ts, "name": "cpu %",
+                    "args": {t["name"]: round(100.0 * t["run_us"] / window, 2)
+                             for t in snap["tasks"]}})
+        out.append({"ph": "C", "pid": PID_METRICS, "ts": ts, "name": "stack free",
+                    "args": {t["name"]: t["stack_free"]
+                             for t in snap["tasks"] if t["stack_free"]}})
+        out.append({"ph": "C", "pid": PID_METRICS, "ts": ts, "name": "heap",
+                    "args": {"free": snap["free_heap"], "min free": snap["min_free_heap"]}})
+        for h in snap["handlers"]:
+            out.append({"ph": "C", "pid": PID_METRICS, "ts": ts,
+                        "name": f"mqtt {h['event']} us",
+                        "args": {"avg": h["total_us"] / h["count"], "max": h["max_us"]}})
+
+    for slot, name in names.items():
+        meta(PID_MQTT, slot, "thread_name", name)
+
+    with open(args.output, "w") as f:
+        json.dump({"traceEvents": out, "displayTimeUnit": "ms"}, f)
+    print(f"{len(snaps)} snapshots, {len(out)} trace events -> {args.output}")
+
+
+# Summary -------------------------------------------------------------------- #
+def summary(args):
+    snaps = read_capture(args.capture)
+    if not snaps:
+        sys.exit("no snapshots")
+
+    s = snaps[-1]
+    lost = sum(x["dropped"] for x in snaps)
+    window = s["window_us"] or 1
+    print(f"snapshot {s['seq']} at {s['uptime_us'] / 1e6:.1f} s, "
+          f"window {window / 1000:.0f} ms, {s['cores']} cores")
+    print(f"heap free {s['free_heap']} (min {s['min_free_heap']}), "
+          f"ring events lost over capture: {lost}")
+
+    print(f"\n{'task':14} {'prio':>4} {'cpu %':>7} {'stack free':>10}")
+    for t in sorted(s["tasks"], key=lambda t: -t["run_us"]):
+        print(f"{t['name']:14} {t['priority']:4d} {100.0 * t['run_us'] / window:7.2f} "
+              f"{t['stack_free']:10d}")
+
+    if s["queues"]:
+        print(f"\n{'queue':14} {'depth':>5} {'peak':>5} {'len':>5} "
+              f"{'sends':>6} {'recvs':>6} {'fails':>6}")
+        for q in s["queues"]:
+            print(f"{q['name']:14} {q['depth']:5d} {q['peak']:5d} {q['length']:5d} "
+                  f"{q['sends']:6d} {q['receives']:6d} {q['fails']:6d}")
+
+    if s["handlers"]:
+        print(f"\n{'mqtt handler':14} {'count':>6} {'avg us':>8} {'max us':>8}")
+        for h in s["handlers"]:
+            print(f"{h['event']:14} {h['count']:6d} {h['total_us'] / h['count']:8.0f} "
+                  f"{h['max_us']:8d}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("capture", help="record snapshots from the broker")
+    p.add_argument("output")
+    p.add_argument("--broker", default="broker.mqttdashboard.com")
+    p.add_argument("--topic", required=True)
+    p.add_argument("--seconds", type=float, default=30)
+    p.set_defaults(func=capture)
+
+    p = sub.add_parser("convert", help="capture -> Chrome trace JSON")
+    p.add_argument("capture")
+    p.add_argument("-o", "--output", default="trace.json")
+    p.set_defaults(func=convert)
+
+    p = sub.add_parser("summary", help="tables from the last snapshot")
+    p.add_argument("capture")
+    p.set_defaults(func=summary)
+
+    args = ap.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <assert.h>
+
+// Kernel config for the POSIX port, kept close to the ESP-IDF defaults the
+// firmwares are written against (1 kHz tick, 25 priorities, timer task).
+
+#define configUSE_PREEMPTION 1
+#define configUSE_TIME_SLICING 1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+// Stack depths are in words here (bytes on IDF), so IDF sizes get 8x the
+// room on the host; glibc printf needs it
+#define configMINIMAL_STACK_SIZE 4096
+#define configMAX_TASK_NAME_LEN 16
+#define configTICK_TYPE_WIDTH_IN_BITS TICK_TYPE_WIDTH_32_BITS
+#define configIDLE_SHOULD_YIELD 1
+#define configSTACK_DEPTH_TYPE uint32_t
+
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+// Both, so REEF_STATIC_ALLOC builds work; the kernel brings its own idle
+// and timer task storage
+#define configSUPPORT_STATIC_ALLOCATION 1
+#define configKERNEL_PROVIDED_STATIC_MEMORY 1
+
+#define configUSE_MUTEXES 1
+#define configUSE_RECURSIVE_MUTEXES 1
+#define configUSE_COUNTING_SEMAPHORES 1
+#define configUSE_TASK_NOTIFICATIONS 1
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 1
+#define configQUEUE_REGISTRY_SIZE 0
+
+#define configUSE_IDLE_HOOK 0
+#define configUSE_TICK_HOOK 0
+#define configUSE_MALLOC_FAILED_HOOK 0
+#define configCHECK_FOR_STACK_OVERFLOW 0
+
+#define configUSE_TIMERS 1
+#define configTIMER_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+#define configTIMER_QUEUE_LENGTH 32
+#define configTIMER_TASK_STACK_DEPTH 8192
+
+#define configUSE_TRACE_FACILITY 1
+#define configGENERATE_RUN_TIME_STATS 0
+#define configUSE_STATS_FORMATTING_FUNCTIONS 0
+
+#define INCLUDE_vTaskDelay 1
+#define INCLUDE_vTaskDelete 1
+#define INCLUDE_vTaskSuspend 1
+#define INCLUDE_xTaskDelayUntil 1
+#define INCLUDE_xTaskGetCurrentTaskHandle 1
+#define INCLUDE_xTaskGetSchedulerState 1
+#define INCLUDE_xTimerGetTimerDaemonTaskHandle 1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
+#define INCLUDE_uxTaskPriorityGet 1
+#define INCLUDE_vTaskPrioritySet 1
+
+#define configASSERT(x) assert(x)
@@ -0,0 +1,7 @@
+#pragma once
+
+#define IRAM_ATTR
+
+// Nothing survives a restart of the simulator process: a plain static, so
+// reef_state always falls back to its NVS files
+#define RTC_NOINIT_ATTR
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// CRC-32 (IEEE, reflected), chainable like the ROM version:
+// crc32_le(crc32_le(0, a), b) == crc32_le(0, a + b)
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
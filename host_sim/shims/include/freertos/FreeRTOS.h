@@ -0,0 +1,12 @@
+#pragma once
+
+// IDF spells kernel headers "freertos/<name>.h"
+#include <FreeRTOS.h>
+
+// IDF code gets BITn through FreeRTOS.h
+#include "esp_bit_defs.h"
+
+// IDF's core count; the POSIX port is single-core
+#ifndef portNUM_PROCESSORS
+#define portNUM_PROCESSORS 1
+#endif
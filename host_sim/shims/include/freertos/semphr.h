@@ -0,0 +1,4 @@
+#pragma once
+
+// IDF spells kernel headers "freertos/<name>.h"
+#include <semphr.h>
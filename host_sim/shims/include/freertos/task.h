@@ -0,0 +1,14 @@
+#pragma once
+
+// IDF spells kernel headers "freertos/<name>.h"
+#include <task.h>
+
+// The POSIX port runs one core: the placement chosen by reef_profile is
+// accepted and ignored, only the priorities differ between profiles
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+#define xTaskCreatePinnedToCore(fn, name, depth, arg, prio, handle, core) \
+    ((void)(core), xTaskCreate((fn), (name), (depth), (arg), (prio), (handle)))
+
+#define xTaskCreateStaticPinnedToCore(fn, name, depth, arg, prio, stack, tcb, core) \
+    ((void)(core), xTaskCreateStatic((fn), (name), (depth), (arg), (prio), (stack), (tcb)))
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "esp_err.h"
+
+// The simulated flash is a directory of files, see sim_nvs.c
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Simulator services shared by the shims. Not part of any IDF API.
+
+// Appends one row to the trace CSV: t_us,event,a,b,c
+void sim_trace(const char *event, const char *a, long long b, long long c);
+
+// Milliseconds from the environment variable, or fallback
+int sim_env_ms(const char *name, int fallback);
+
+// Drives an input pin (called from the control task)
+void sim_gpio_input(int pin, int level);
+
+// Drops the Wi-Fi link, as if the AP went away
+void sim_wifi_drop(void);
+
+// Associated and holding an address: the broker is reachable
+bool sim_wifi_has_ip(void);
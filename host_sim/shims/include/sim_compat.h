@@ -0,0 +1,11 @@
+#pragma once
+
+// Force-included into every host translation unit: things newlib has and
+// older glibc does not.
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
@@ -0,0 +1,123 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "esp_event.h"
+
+// Default event loop ---------------------------------------------------------- //
+#define MAX_HANDLERS 32
+#define EVENT_DATA_MAX 128
+#define EVENT_QUEUE_LEN 32
+
+// Priority of the IDF "sys_evt" task
+#define EVENT_TASK_PRIORITY (configMAX_PRIORITIES - 5)
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} handler_entry_t;
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    size_t size;
+    uint8_t data[EVENT_DATA_MAX];
+} posted_event_t;
+
+static handler_entry_t handlers[MAX_HANDLERS];
+static volatile int handler_count = 0;
+static QueueHandle_t event_queue;
+
+static void event_task(void *arg)
+{
+    posted_event_t ev;
+
+    while (1)
+    {
+        if (!xQueueReceive(event_queue, &ev, portMAX_DELAY))
+        {
+            continue;
+        }
+
+        for (int i = 0; i < handler_count; i++)
+        {
+            handler_entry_t *h = &handlers[i];
+            if ((h->base == ESP_EVENT_ANY_BASE || h->base == ev.base) &&
+                (h->id == ESP_EVENT_ANY_ID || h->id == ev.id))
+            {
+                h->handler(h->arg, ev.base, ev.id, ev.size ? ev.data : NULL);
+            }
+        }
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (event_queue)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    event_queue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(posted_event_t));
+    if (!event_queue)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xTaskCreate(event_task, "sys_evt", 4096, NULL, EVENT_TASK_PRIORITY, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base,
+                                     int32_t event_id,
+                                     esp_event_handler_t event_handler,
+                                     void *event_handler_arg)
+{
+    if (!event_handler)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL();
+    if (handler_count == MAX_HANDLERS)
+    {
+        taskEXIT_CRITICAL();
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Fill the entry before publishing it to the loop task
+    handlers[handler_count] = (handler_entry_t){
+        event_base, event_id, event_handler, event_handler_arg};
+    handler_count++;
+    taskEXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+                         const void *event_data, size_t event_data_size,
+                         TickType_t ticks_to_wait)
+{
+    if (!event_queue)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (event_data_size > EVENT_DATA_MAX)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    posted_event_t ev = {.base = event_base, .id = event_id, .size = event_data_size};
+    if (event_data_size)
+    {
+        memcpy(ev.data, event_data, event_data_size);
+    }
+
+    return xQueueSend(event_queue, &ev, ticks_to_wait) == pdTRUE ? ESP_OK
+                                                                  : ESP_ERR_TIMEOUT;
+}
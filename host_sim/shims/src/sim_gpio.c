@@ -0,0 +1,154 @@
+#include <stdio.h>
+
+#include "driver/gpio.h"
+#include "sim.h"
+
+// Pin state ------------------------------------------------------------------ //
+#define GPIO_COUNT 40
+
+typedef struct
+{
+    gpio_mode_t mode;
+    gpio_int_type_t intr;
+    int level;
+    gpio_isr_t isr;
+    void *isr_arg;
+} pin_state_t;
+
+static pin_state_t pins[GPIO_COUNT];
+static bool isr_service = false;
+
+static bool valid(gpio_num_t pin)
+{
+    return pin >= 0 && pin < GPIO_COUNT;
+}
+
+static bool edge_matches(gpio_int_type_t intr, int from, int to)
+{
+    switch (intr)
+    {
+    case GPIO_INTR_POSEDGE:
+        return !from && to;
+    case GPIO_INTR_NEGEDGE:
+        return from && !to;
+    case GPIO_INTR_ANYEDGE:
+        return from != to;
+    case GPIO_INTR_LOW_LEVEL:
+        return !to;
+    case GPIO_INTR_HIGH_LEVEL:
+        return to;
+    default:
+        return false;
+    }
+}
+
+// Runs the handler in the control task: close enough to an ISR for code
+// that only uses ...FromISR() calls
+void sim_gpio_input(int pin, int level)
+{
+    if (!valid(pin))
+    {
+        return;
+    }
+
+    pin_state_t *p = &pins[pin];
+    int from = p->level;
+    p->level = level ? 1 : 0;
+
+    char name[8];
+    snprintf(name, sizeof(name), "%d", pin);
+    sim_trace("gpio_in", name, p->level, 0);
+
+    if (isr_service && p->isr && edge_matches(p->intr, from, p->level))
+    {
+        p->isr(p->isr_arg);
+    }
+}
+
+// Driver --------------------------------------------------------------------- //
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    for (int pin = 0; pin < GPIO_COUNT; pin++)
+    {
+        if (!(config->pin_bit_mask & (1ULL << pin)))
+        {
+            continue;
+        }
+
+        pins[pin].mode = config->mode;
+        pins[pin].intr = config->intr_type;
+        if (config->pull_up_en == GPIO_PULLUP_ENABLE)
+        {
+            pins[pin].level = 1;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pins[gpio_num] = (pin_state_t){0};
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!valid(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pins[gpio_num].mode = mode;
+    return ESP_OK;
+}
+
+// Only transitions are traced, that is what a logic analyser would show
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pin_state_t *p = &pins[gpio_num];
+    int next = level ? 1 : 0;
+    if (p->level != next)
+    {
+        p->level = next;
+
+        char name[8];
+        snprintf(name, sizeof(name), "%d", gpio_num);
+        sim_trace("gpio", name, next, 0);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return valid(gpio_num) ? pins[gpio_num].level : 0;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    if (isr_service)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler,
+                               void *args)
+{
+    if (!valid(gpio_num) || !isr_service)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pins[gpio_num].isr = isr_handler;
+    pins[gpio_num].isr_arg = args;
+    return ESP_OK;
+}
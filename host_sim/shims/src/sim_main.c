@@ -0,0 +1,186 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+#include "sim.h"
+
+// Entry point of the firmware under test
+void app_main(void);
+
+// Simulator main: runs app_main() in a FreeRTOS task, like the IDF startup
+// code, and reads control commands from stdin:
+//
+//   gpio <pin> <level>   drive an input pin (fires ISRs on edges)
+//   wifi drop            lose the AP
+//   quit                 flush the trace and exit
+
+static FILE *trace_file;
+static int64_t duration_us = 0;
+
+// Trace ---------------------------------------------------------------------- //
+void sim_trace(const char *event, const char *a, long long b, long long c)
+{
+    if (!trace_file)
+    {
+        return;
+    }
+
+    // One fprintf per row keeps rows whole without a FreeRTOS lock
+    fprintf(trace_file, "%lld,%s,%s,%lld,%lld\n",
+            (long long)esp_timer_get_time(), event, a ? a : "", b, c);
+}
+
+static void trace_open(const char *path)
+{
+    trace_file = fopen(path, "w");
+    if (!trace_file)
+    {
+        fprintf(stderr, "sim: cannot open trace %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    // Line buffered: load.py tails the trace to see when the firmware is up
+    setvbuf(trace_file, NULL, _IOLBF, 0);
+
+    // Wall clock at t_us = 0, so traces line up with the load generator
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t epoch_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+
+    fprintf(trace_file, "# epoch_us=%lld\n",
+            (long long)(epoch_us - esp_timer_get_time()));
+    fprintf(trace_file, "t_us,event,a,b,c\n");
+}
+
+static void sim_exit(int code)
+{
+    if (trace_file)
+    {
+        fflush(trace_file);
+    }
+    fflush(stdout);
+    _exit(code);
+}
+
+int sim_env_ms(const char *name, int fallback)
+{
+    const char *v = getenv(name);
+    return v && *v ? atoi(v) : fallback;
+}
+
+// Control -------------------------------------------------------------------- //
+static void handle_command(char *line)
+{
+    int pin, level;
+    if (sscanf(line, "gpio %d %d", &pin, &level) == 2)
+    {
+        sim_gpio_input(pin, level);
+    }
+    else if (strncmp(line, "wifi drop", 9) == 0)
+    {
+        sim_wifi_drop();
+    }
+    else if (strncmp(line, "quit", 4) == 0)
+    {
+        sim_exit(0);
+    }
+    else if (*line)
+    {
+        fprintf(stderr, "sim: unknown command '%s'\n", line);
+    }
+}
+
+// Polls stdin every tick: a blocking read would stall the whole simulation
+static void ctl_task(void *arg)
+{
+    char line[128];
+    size_t len = 0;
+
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+
+    while (1)
+    {
+        char c;
+        ssize_t n;
+        while ((n = read(STDIN_FILENO, &c, 1)) == 1)
+        {
+            if (c == '\n')
+            {
+                line[len] = '\0';
+                handle_command(line);
+                len = 0;
+            }
+            else if (len < sizeof(line) - 1)
+            {
+                line[len++] = c;
+            }
+        }
+
+        if (duration_us > 0 && esp_timer_get_time() >= duration_us)
+        {
+            sim_exit(0);
+        }
+
+        // At EOF nothing more will come, poll lazily
+        vTaskDelay(n == 0 ? pdMS_TO_TICKS(10) : 1);
+    }
+}
+
+static void main_task(void *arg)
+{
+    app_main();
+    vTaskDelete(NULL);
+}
+
+// Main ----------------------------------------------------------------------- //
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--trace FILE] [--nvs DIR] [--duration SEC]\n"
+            "env: REEF_SIM_BROKER=host[:port] (default localhost:1883)\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = "trace.csv";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--nvs") == 0 && i + 1 < argc)
+        {
+            setenv("REEF_SIM_NVS", argv[++i], 1);
+        }
+        else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc)
+        {
+            duration_us = (int64_t)(atof(argv[++i]) * 1e6);
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    trace_open(trace_path);
+
+    // Same priority as the IDF main task
+    xTaskCreate(main_task, "main", 8192, NULL, 1, NULL);
+    xTaskCreate(ctl_task, "sim_ctl", 4096, NULL, configMAX_PRIORITIES - 2, NULL);
+
+    vTaskStartScheduler();
+    return 1;
+}
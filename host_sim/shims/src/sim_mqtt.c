@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <mosquitto.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_client.h"
+#include "sim.h"
+
+// esp-mqtt on libmosquitto. The broker URI from config.h is ignored: every
+// client talks to $REEF_SIM_BROKER (host[:port], default localhost:1883), so
+// a simulation never touches the public broker.
+//
+// libmosquitto runs in non-threaded mode, driven from a FreeRTOS task that
+// polls it every tick. Its own thread could not call into the kernel.
+
+static const char *TAG = "SIM_MQTT";
+
+#define MAX_MQTT_HANDLERS 8
+#define MAX_PENDING_ACKS 64
+
+#define DEFAULT_BUFFER_SIZE 1024
+#define DEFAULT_RECONNECT_MS 10000
+#define DEFAULT_KEEPALIVE_S 120
+#define DEFAULT_TASK_PRIORITY 5
+
+typedef struct
+{
+    esp_mqtt_event_id_t event;
+    esp_event_handler_t handler;
+    void *arg;
+} mqtt_handler_t;
+
+typedef enum
+{
+    STATE_IDLE,       // not started, or stopped
+    STATE_WAITING,    // disconnected, waiting for reconnect_at
+    STATE_CONNECTING, // CONNECT sent, no CONNACK yet
+    STATE_CONNECTED,
+} client_state_t;
+
+struct esp_mqtt_client
+{
+    struct mosquitto *mosq;
+    char host[128];
+    int port;
+    int keepalive;
+    int reconnect_ms;
+    bool auto_reconnect;
+    int priority;
+
+    mqtt_handler_t handlers[MAX_MQTT_HANDLERS];
+    int handler_count;
+
+    SemaphoreHandle_t lock; // recursive: handlers may publish
+    TaskHandle_t task;
+    volatile client_state_t state;
+    int64_t reconnect_at;
+
+    int pending_acks[MAX_PENDING_ACKS];
+    int pending_count;
+
+    char *buf;
+    int buf_size;
+};
+
+// Events --------------------------------------------------------------------- //
+static void dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_t *ev)
+{
+    ev->client = client;
+    for (int i = 0; i < client->handler_count; i++)
+    {
+        mqtt_handler_t *h = &client->handlers[i];
+        if (h->event == MQTT_EVENT_ANY || h->event == ev->event_id)
+        {
+            h->handler(h->arg, "MQTT_EVENTS", ev->event_id, ev);
+        }
+    }
+}
+
+static void dispatch_simple(esp_mqtt_client_handle_t client,
+                            esp_mqtt_event_id_t id, int msg_id)
+{
+    esp_mqtt_event_t ev = {.event_id = id, .msg_id = msg_id};
+    dispatch(client, &ev);
+}
+
+// Connection dropped or refused: tell the app, then wait for a retry
+static void connection_lost(esp_mqtt_client_handle_t client)
+{
+    if (client->state == STATE_IDLE || client->state == STATE_WAITING)
+    {
+        return;
+    }
+
+    client->state = STATE_WAITING;
+    client->reconnect_at = client->auto_reconnect
+                               ? esp_timer_get_time() + client->reconnect_ms * 1000LL
+                               : INT64_MAX;
+    client->pending_count = 0;
+
+    sim_trace("mqtt", "disconnected", 0, 0);
+    dispatch_simple(client, MQTT_EVENT_DISCONNECTED, 0);
+}
+
+static void on_connect(struct mosquitto *mosq, void *obj, int rc)
+{
+    esp_mqtt_client_handle_t client = obj;
+    if (rc != 0)
+    {
+        sim_trace("mqtt", "refused", rc, 0);
+        dispatch_simple(client, MQTT_EVENT_ERROR, 0);
+        return;
+    }
+
+    client->state = STATE_CONNECTED;
+    sim_trace("mqtt", "connack", 0, 0);
+    dispatch_simple(client, MQTT_EVENT_CONNECTED, 0);
+}
+
+static void on_disconnect(struct mosquitto *mosq, void *obj, int rc)
+{
+    connection_lost(obj);
+}
+
+static void on_subscribe(struct mosquitto *mosq, void *obj, int mid,
+                         int qos_count, const int *granted_qos)
+{
+    sim_trace("suback", "", mid, qos_count ? granted_qos[0] : 0);
+    dispatch_simple(obj, MQTT_EVENT_SUBSCRIBED, mid);
+}
+
+// libmosquitto reports QoS 0 sends too; only acknowledged ones are PUBLISHED
+static void on_publish(struct mosquitto *mosq, void *obj, int mid)
+{
+    esp_mqtt_client_handle_t client = obj;
+    for (int i = 0; i < client->pending_count; i++)
+    {
+        if (client->pending_acks[i] == mid)
+        {
+            client->pending_acks[i] = client->pending_acks[--client->pending_count];
+            sim_trace("puback", "", mid, 0);
+            dispatch_simple(client, MQTT_EVENT_PUBLISHED, mid);
+            return;
+        }
+    }
+}
+
+// Payloads larger than the buffer arrive in pieces, as with esp-mqtt; only
+// the first piece carries the topic
+static void on_message(struct mosquitto *mosq, void *obj,
+                       const struct mosquitto_message *msg)
+{
+    esp_mqtt_client_handle_t client = obj;
+    sim_trace("rx", msg->topic, msg->payloadlen, msg->mid);
+
+    int offset = 0;
+    do
+    {
+        int len = msg->payloadlen - offset;
+        if (len > client->buf_size)
+        {
+            len = client->buf_size;
+        }
+
+        memcpy(client->buf, (const char *)msg->payload + offset, len);
+        client->buf[len] = '\0';
+
+        esp_mqtt_event_t ev = {
+            .event_id = MQTT_EVENT_DATA,
+            .data = client->buf,
+            .data_len = len,
+            .total_data_len = msg->payloadlen,
+            .current_data_offset = offset,
+            .topic = offset == 0 ? msg->topic : NULL,
+            .topic_len = offset == 0 ? (int)strlen(msg->topic) : 0,
+            .msg_id = msg->mid,
+            .retain = msg->retain,
+            .qos = msg->qos,
+        };
+        dispatch(client, &ev);
+
+        offset += len;
+    } while (offset < msg->payloadlen);
+}
+
+// Task ----------------------------------------------------------------------- //
+static void try_connect(esp_mqtt_client_handle_t client)
+{
+    dispatch_simple(client, MQTT_EVENT_BEFORE_CONNECT, 0);
+
+    client->state = STATE_CONNECTING;
+    int rc = mosquitto_connect(client->mosq, client->host, client->port,
+                               client->keepalive);
+    if (rc != MOSQ_ERR_SUCCESS)
+    {
+        ESP_LOGW(TAG, "connect to %s:%d failed: %s", client->host, client->port,
+                 mosquitto_strerror(rc));
+        dispatch_simple(client, MQTT_EVENT_ERROR, 0);
+        connection_lost(client);
+    }
+}
+
+static void mqtt_task(void *arg)
+{
+    esp_mqtt_client_handle_t client = arg;
+
+    while (1)
+    {
+        xSemaphoreTakeRecursive(client->lock, portMAX_DELAY);
+
+        bool has_ip = sim_wifi_has_ip();
+        switch (client->state)
+        {
+        case STATE_WAITING:
+            if (has_ip && esp_timer_get_time() >= client->reconnect_at)
+            {
+                try_connect(client);
+            }
+            break;
+
+        case STATE_CONNECTING:
+        case STATE_CONNECTED:
+            if (!has_ip)
+            {
+                // The link is gone even though localhost still answers
+                mosquitto_disconnect(client->mosq);
+                connection_lost(client);
+            }
+            else if (mosquitto_loop(client->mosq, 0, 1) != MOSQ_ERR_SUCCESS)
+            {
+                connection_lost(client);
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        xSemaphoreGiveRecursive(client->lock);
+        vTaskDelay(1);
+    }
+}
+
+// API ------------------------------------------------------------------------ //
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    static bool lib_ready = false;
+    if (!lib_ready)
+    {
+        mosquitto_lib_init();
+        lib_ready = true;
+    }
+
+    esp_mqtt_client_handle_t client = calloc(1, sizeof(*client));
+    if (!client)
+    {
+        return NULL;
+    }
+
+    const char *broker = getenv("REEF_SIM_BROKER");
+    strlcpy(client->host, broker && *broker ? broker : "localhost",
+            sizeof(client->host));
+    client->port = 1883;
+
+    char *colon = strchr(client->host, ':');
+    if (colon)
+    {
+        *colon = '\0';
+        client->port = atoi(colon + 1);
+    }
+
+    client->keepalive = config->session.keepalive ? config->session.keepalive
+                                                  : DEFAULT_KEEPALIVE_S;
+    client->reconnect_ms = config->network.reconnect_timeout_ms
+                               ? config->network.reconnect_timeout_ms
+                               : DEFAULT_RECONNECT_MS;
+    client->auto_reconnect = !config->network.disable_auto_reconnect;
+    client->priority = config->task.priority ? config->task.priority
+                                             : DEFAULT_TASK_PRIORITY;
+    client->buf_size = config->buffer.size ? config->buffer.size
+                                           : DEFAULT_BUFFER_SIZE;
+
+    char id[32];
+    snprintf(id, sizeof(id), "reef_sim_%d", (int)getpid());
+
+    client->buf = malloc(client->buf_size + 1);
+    client->lock = xSemaphoreCreateRecursiveMutex();
+    client->mosq = mosquitto_new(id, true, client);
+    if (!client->buf || !client->lock || !client->mosq)
+    {
+        free(client->buf);
+        free(client);
+        return NULL;
+    }
+
+    mosquitto_connect_callback_set(client->mosq, on_connect);
+    mosquitto_disconnect_callback_set(client->mosq, on_disconnect);
+    mosquitto_subscribe_callback_set(client->mosq, on_subscribe);
+    mosquitto_publish_callback_set(client->mosq, on_publish);
+    mosquitto_message_callback_set(client->mosq, on_message);
+
+    ESP_LOGI(TAG, "broker %s:%d (configured %s)", client->host, client->port,
+             config->broker.address.uri ? config->broker.address.uri : "-");
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler,
+                                         void *event_handler_arg)
+{
+    if (!client || !event_handler)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->handler_count == MAX_MQTT_HANDLERS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    client->handlers[client->handler_count++] =
+        (mqtt_handler_t){event, event_handler, event_handler_arg};
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (!client || client->task)
+    {
+        return ESP_FAIL;
+    }
+
+    client->state = STATE_WAITING;
+    client->reconnect_at = 0;
+    return xTaskCreate(mqtt_task, "mqtt_task", 8192, client, client->priority,
+                       &client->task) == pdPASS
+               ? ESP_OK
+               : ESP_FAIL;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    if (!client || !client->task)
+    {
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTakeRecursive(client->lock, portMAX_DELAY);
+    if (client->state == STATE_CONNECTED || client->state == STATE_CONNECTING)
+    {
+        mosquitto_disconnect(client->mosq);
+        connection_lost(client);
+    }
+    client->state = STATE_IDLE;
+    vTaskDelete(client->task);
+    client->task = NULL;
+    xSemaphoreGiveRecursive(client->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client)
+{
+    if (!client || client->state != STATE_WAITING)
+    {
+        return ESP_FAIL;
+    }
+    client->reconnect_at = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client)
+{
+    if (!client)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTakeRecursive(client->lock, portMAX_DELAY);
+    if (client->state == STATE_CONNECTED || client->state == STATE_CONNECTING)
+    {
+        mosquitto_disconnect(client->mosq);
+        connection_lost(client);
+    }
+    client->reconnect_at = INT64_MAX;
+    xSemaphoreGiveRecursive(client->lock);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client,
+                              const char *topic, int qos)
+{
+    if (!client || client->state != STATE_CONNECTED)
+    {
+        return -1;
+    }
+
+    int mid = -1;
+    xSemaphoreTakeRecursive(client->lock, portMAX_DELAY);
+    if (mosquitto_subscribe(client->mosq, &mid, topic, qos) != MOSQ_ERR_SUCCESS)
+    {
+        mid = -1;
+    }
+    sim_trace("subscribe", topic, mid, qos);
+    xSemaphoreGiveRecursive(client->lock);
+    return mid;
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client,
+                                const char *topic)
+{
+    if (!client || client->state != STATE_CONNECTED)
+    {
+        return -1;
+    }
+
+    int mid = -1;
+    xSemaphoreTakeRecursive(client->lock, portMAX_DELAY);
+    if (mosquitto_unsubscribe(client->mosq, &mid, topic) != MOSQ_ERR_SUCCESS)
+    {
+        mid = -1;
+    }
+    xSemaphoreGiveRecursive(client->lock);
+    return mid;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic,
+                            const char *data, int len, int qos, int retain)
+{
+    if (!client || client->state != STATE_CONNECTED)
+    {
+        return -1;
+    }
+    if (len == 0 && data)
+    {
+        len = (int)strlen(data);
+    }
+
+    int mid = -1;
+    xSemaphoreTakeRecursive(client->lock, portMAX_DELAY);
+    if (mosquitto_publish(client->mosq, &mid, topic, len, data, qos,
+                          retain != 0) != MOSQ_ERR_SUCCESS)
+    {
+        mid = -1;
+    }
+    else if (qos > 0 && client->pending_count < MAX_PENDING_ACKS)
+    {
+        client->pending_acks[client->pending_count++] = mid;
+    }
+
+    // Traced under the lock so the PUBACK row can never come first
+    sim_trace("publish", topic, mid, len);
+    xSemaphoreGiveRecursive(client->lock);
+
+    // esp-mqtt returns 0 for QoS 0
+    return qos == 0 && mid >= 0 ? 0 : mid;
+}
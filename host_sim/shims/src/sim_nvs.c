@@ -0,0 +1,260 @@
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "sim.h"
+
+// Simulated flash: one file per key under $REEF_SIM_NVS/<namespace>/, so the
+// cache survives between runs like it does across reboots. Writes are
+// traced, which is what matters for flash wear.
+
+#define MAX_HANDLES 8
+#define NAME_MAX_LEN 15 // NVS key/namespace limit
+
+typedef struct
+{
+    bool in_use;
+    bool writable;
+    char ns[NAME_MAX_LEN + 1];
+} handle_entry_t;
+
+static handle_entry_t handles[MAX_HANDLES];
+
+static const char *nvs_root(void)
+{
+    const char *dir = getenv("REEF_SIM_NVS");
+    return dir && *dir ? dir : "nvs_sim";
+}
+
+static void key_path(char *out, size_t size, const char *ns, const char *key)
+{
+    if (key)
+    {
+        snprintf(out, size, "%s/%s/%s", nvs_root(), ns, key);
+    }
+    else
+    {
+        snprintf(out, size, "%s/%s", nvs_root(), ns);
+    }
+}
+
+static handle_entry_t *lookup(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > MAX_HANDLES || !handles[handle - 1].in_use)
+    {
+        return NULL;
+    }
+    return &handles[handle - 1];
+}
+
+// Flash ---------------------------------------------------------------------- //
+esp_err_t nvs_flash_init(void)
+{
+    if (mkdir(nvs_root(), 0755) != 0 && errno != EEXIST)
+    {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    DIR *root = opendir(nvs_root());
+    if (!root)
+    {
+        return ESP_OK;
+    }
+
+    struct dirent *ns;
+    while ((ns = readdir(root)))
+    {
+        if (ns->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        char dir_path[PATH_MAX];
+        key_path(dir_path, sizeof(dir_path), ns->d_name, NULL);
+
+        DIR *dir = opendir(dir_path);
+        struct dirent *key;
+        while (dir && (key = readdir(dir)))
+        {
+            if (key->d_name[0] != '.')
+            {
+                char path[PATH_MAX];
+                key_path(path, sizeof(path), ns->d_name, key->d_name);
+                unlink(path);
+            }
+        }
+        if (dir)
+        {
+            closedir(dir);
+        }
+        rmdir(dir_path);
+    }
+    closedir(root);
+
+    sim_trace("nvs_erase", "", 0, 0);
+    return ESP_OK;
+}
+
+// Handles -------------------------------------------------------------------- //
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode,
+                   nvs_handle_t *out_handle)
+{
+    if (!namespace_name || strlen(namespace_name) > NAME_MAX_LEN || !out_handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char path[PATH_MAX];
+    key_path(path, sizeof(path), namespace_name, NULL);
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        // Read-only opens of a namespace that was never written fail
+        if (open_mode == NVS_READONLY)
+        {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        if (mkdir(path, 0755) != 0)
+        {
+            return ESP_FAIL;
+        }
+    }
+
+    for (int i = 0; i < MAX_HANDLES; i++)
+    {
+        if (!handles[i].in_use)
+        {
+            handles[i].in_use = true;
+            handles[i].writable = open_mode == NVS_READWRITE;
+            strlcpy(handles[i].ns, namespace_name, sizeof(handles[i].ns));
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    handle_entry_t *h = lookup(handle);
+    if (h)
+    {
+        h->in_use = false;
+    }
+}
+
+// Every write is already durable
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return lookup(handle) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+// Values --------------------------------------------------------------------- //
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value,
+                       size_t *length)
+{
+    handle_entry_t *h = lookup(handle);
+    if (!h || !key || !length)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char path[PATH_MAX];
+    key_path(path, sizeof(path), h->ns, key);
+
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size_t size = (size_t)ftell(f);
+    rewind(f);
+
+    esp_err_t err = ESP_OK;
+    if (!out_value)
+    {
+        *length = size;
+    }
+    else if (*length < size)
+    {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+        *length = fread(out_value, 1, size, f);
+        err = *length == size ? ESP_OK : ESP_FAIL;
+    }
+    fclose(f);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value,
+                       size_t length)
+{
+    handle_entry_t *h = lookup(handle);
+    if (!h || !key || strlen(key) > NAME_MAX_LEN || (!value && length))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!h->writable)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char path[PATH_MAX], tmp[PATH_MAX + 4];
+    key_path(path, sizeof(path), h->ns, key);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f)
+    {
+        return ESP_FAIL;
+    }
+    bool ok = fwrite(value, 1, length, f) == length;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0)
+    {
+        unlink(tmp);
+        return ESP_FAIL;
+    }
+
+    sim_trace("nvs_write", key, (long long)length, 0);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    handle_entry_t *h = lookup(handle);
+    if (!h || !key)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!h->writable)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char path[PATH_MAX];
+    key_path(path, sizeof(path), h->ns, key);
+    if (unlink(path) != 0)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    sim_trace("nvs_erase", key, 0, 0);
+    return ESP_OK;
+}
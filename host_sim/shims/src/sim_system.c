@@ -0,0 +1,247 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+// Time ----------------------------------------------------------------------- //
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t start_us;
+
+__attribute__((constructor)) static void time_init(void)
+{
+    start_us = monotonic_us();
+    srandom((unsigned)start_us ^ (unsigned)getpid());
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return monotonic_us() - start_us;
+}
+
+// esp_timer ------------------------------------------------------------------ //
+struct esp_timer
+{
+    TimerHandle_t handle;
+    esp_timer_cb_t callback;
+    void *arg;
+};
+
+static void timer_fired(TimerHandle_t handle)
+{
+    struct esp_timer *timer = pvTimerGetTimerID(handle);
+    timer->callback(timer->arg);
+}
+
+// The timer command queue must not be blocked on from the timer task itself
+static TickType_t command_wait(void)
+{
+    return xTaskGetCurrentTaskHandle() == xTimerGetTimerDaemonTaskHandle()
+               ? 0
+               : portMAX_DELAY;
+}
+
+static TickType_t us_to_ticks(uint64_t us)
+{
+    TickType_t ticks = pdMS_TO_TICKS((us + 999) / 1000);
+    return ticks ? ticks : 1;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args,
+                           esp_timer_handle_t *out_handle)
+{
+    if (!args || !args->callback || !out_handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (!timer)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->handle = xTimerCreate(args->name ? args->name : "esp_timer", 1,
+                                 pdFALSE, timer, timer_fired);
+    if (!timer->handle)
+    {
+        free(timer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t us, bool reload)
+{
+    if (xTimerIsTimerActive(timer->handle))
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    vTimerSetReloadMode(timer->handle, reload ? pdTRUE : pdFALSE);
+    return xTimerChangePeriod(timer->handle, us_to_ticks(us), command_wait()) == pdPASS
+               ? ESP_OK
+               : ESP_FAIL;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return timer_start(timer, period_us, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!xTimerIsTimerActive(timer->handle))
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return xTimerStop(timer->handle, command_wait()) == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (xTimerIsTimerActive(timer->handle))
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xTimerDelete(timer->handle, command_wait());
+    free(timer);
+    return ESP_OK;
+}
+
+// Log ------------------------------------------------------------------------ //
+static vprintf_like_t log_vprintf = vprintf;
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    vprintf_like_t prev = log_vprintf;
+    log_vprintf = func;
+    return prev;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    log_vprintf(format, args);
+    va_end(args);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// System --------------------------------------------------------------------- //
+uint32_t esp_random(void)
+{
+    return ((uint32_t)random() << 16) ^ (uint32_t)random();
+}
+
+void esp_restart(void)
+{
+    printf("sim: esp_restart()\n");
+    fflush(stdout);
+    _exit(3);
+}
+
+// Every simulator run starts from scratch
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    // No meaningful number on the host; large enough not to trip checks
+    return 320 * 1024;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return esp_get_free_heap_size();
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_FOUND:
+        return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_LENGTH:
+        return "ESP_ERR_NVS_INVALID_LENGTH";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
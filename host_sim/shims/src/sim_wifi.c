@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "sim.h"
+
+// Simulated station: one AP, association and DHCP as fixed delays. Timings
+// come from the environment so cold/warm boots can be compared:
+//
+//   REEF_SIM_SCAN_MS       full all-channel scan        (default 1800)
+//   REEF_SIM_FAST_SCAN_MS  scan of a known channel      (default 60)
+//   REEF_SIM_ASSOC_MS      auth + association           (default 120)
+//   REEF_SIM_DHCP_MS       DHCP discover..ack           (default 900)
+//   REEF_SIM_CHANNEL       the AP's channel             (default 6)
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+static const char *TAG = "SIM_WIFI";
+
+#define REQ_CONNECT BIT0
+#define REQ_DHCP BIT1
+
+static const uint8_t sim_bssid[6] = {0x24, 0x0a, 0xc4, 0x5e, 0xef, 0x01};
+
+struct esp_netif_obj
+{
+    bool dhcp;
+    bool has_ip;
+    esp_netif_ip_info_t ip;
+    esp_netif_dns_info_t dns;
+};
+
+static struct esp_netif_obj sta_netif = {.dhcp = true};
+static wifi_config_t sta_config;
+static volatile bool started = false;
+static volatile bool link_up = false;
+static TaskHandle_t wifi_task_handle;
+
+bool sim_wifi_has_ip(void)
+{
+    return link_up && sta_netif.has_ip;
+}
+
+static uint8_t sim_channel(void)
+{
+    return (uint8_t)sim_env_ms("REEF_SIM_CHANNEL", 6);
+}
+
+static void post_disconnected(uint8_t reason)
+{
+    wifi_event_sta_disconnected_t ev = {.reason = reason};
+    memcpy(ev.bssid, sim_bssid, sizeof(ev.bssid));
+
+    sim_trace("wifi", "disconnected", reason, 0);
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &ev, sizeof(ev),
+                   portMAX_DELAY);
+}
+
+static void got_ip(void)
+{
+    sta_netif.has_ip = true;
+
+    ip_event_got_ip_t ev = {.esp_netif = &sta_netif, .ip_info = sta_netif.ip};
+    sim_trace("wifi", "got_ip", sta_netif.dhcp, 0);
+    esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &ev, sizeof(ev), portMAX_DELAY);
+}
+
+static void run_dhcp(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(sim_env_ms("REEF_SIM_DHCP_MS", 900)));
+    if (!link_up || !sta_netif.dhcp)
+    {
+        return;
+    }
+
+    sta_netif.ip.ip.addr = 0x6404a8c0;      // 192.168.4.100
+    sta_netif.ip.netmask.addr = 0x00ffffff; // 255.255.255.0
+    sta_netif.ip.gw.addr = 0x0104a8c0;      // 192.168.4.1
+    sta_netif.dns.ip.type = ESP_IPADDR_TYPE_V4;
+    sta_netif.dns.ip.u_addr.ip4.addr = 0x0104a8c0;
+    got_ip();
+}
+
+static void run_connect(void)
+{
+    // A pinned BSSID/channel skips the sweep, but only finds the AP if
+    // it is still where the config says
+    const wifi_sta_config_t *sta = &sta_config.sta;
+    bool pinned = sta->bssid_set && sta->channel;
+    vTaskDelay(pdMS_TO_TICKS(pinned ? sim_env_ms("REEF_SIM_FAST_SCAN_MS", 60)
+                                    : sim_env_ms("REEF_SIM_SCAN_MS", 1800)));
+
+    if (pinned && (sta->channel != sim_channel() ||
+                   memcmp(sta->bssid, sim_bssid, sizeof(sim_bssid)) != 0))
+    {
+        post_disconnected(201); // WIFI_REASON_NO_AP_FOUND
+        return;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(sim_env_ms("REEF_SIM_ASSOC_MS", 120)));
+    link_up = true;
+
+    wifi_event_sta_connected_t ev = {.channel = sim_channel()};
+    memcpy(ev.bssid, sim_bssid, sizeof(ev.bssid));
+    sim_trace("wifi", "connected", ev.channel, 0);
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &ev, sizeof(ev),
+                   portMAX_DELAY);
+
+    if (sta_netif.dhcp)
+    {
+        run_dhcp();
+    }
+    else
+    {
+        got_ip();
+    }
+}
+
+// Connect and DHCP requests arrive as notification bits
+static void wifi_task(void *arg)
+{
+    while (1)
+    {
+        uint32_t req = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &req, portMAX_DELAY);
+
+        if ((req & REQ_CONNECT) && started && !link_up)
+        {
+            run_connect();
+        }
+        else if ((req & REQ_DHCP) && link_up && !sta_netif.has_ip)
+        {
+            run_dhcp();
+        }
+    }
+}
+
+void sim_wifi_drop(void)
+{
+    if (!link_up)
+    {
+        return;
+    }
+
+    link_up = false;
+    sta_netif.has_ip = false;
+    post_disconnected(200); // WIFI_REASON_BEACON_TIMEOUT
+}
+
+// esp_netif ------------------------------------------------------------------ //
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    return &sta_netif;
+}
+
+esp_err_t esp_netif_dhcpc_start(esp_netif_t *netif)
+{
+    netif->dhcp = true;
+    netif->has_ip = false;
+
+    // Already associated: lease an address now
+    if (link_up)
+    {
+        xTaskNotify(wifi_task_handle, REQ_DHCP, eSetBits);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *netif)
+{
+    netif->dhcp = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *netif, esp_netif_ip_info_t *info)
+{
+    *info = netif->ip;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *netif,
+                                const esp_netif_ip_info_t *info)
+{
+    if (netif->dhcp)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    netif->ip = *info;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t *netif, esp_netif_dns_type_t type,
+                                 esp_netif_dns_info_t *dns)
+{
+    *dns = netif->dns;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t *netif, esp_netif_dns_type_t type,
+                                 esp_netif_dns_info_t *dns)
+{
+    netif->dns = *dns;
+    return ESP_OK;
+}
+
+// esp_wifi ------------------------------------------------------------------- //
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    if (!wifi_task_handle)
+    {
+        xTaskCreate(wifi_task, "wifi", 4096, NULL, configMAX_PRIORITIES - 2,
+                    &wifi_task_handle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return mode == WIFI_MODE_STA ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    sta_config = *conf;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    *conf = sta_config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    started = true;
+    ESP_LOGI(TAG, "AP " MACSTR " on channel %d", MAC2STR(sim_bssid), sim_channel());
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    xTaskNotify(wifi_task_handle, REQ_CONNECT, eSetBits);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    sim_wifi_drop();
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    if (!link_up)
+    {
+        return ESP_FAIL;
+    }
+
+    memset(ap_info, 0, sizeof(*ap_info));
+    memcpy(ap_info->bssid, sim_bssid, sizeof(sim_bssid));
+    strlcpy((char *)ap_info->ssid, (const char *)sta_config.sta.ssid,
+            sizeof(ap_info->ssid));
+    ap_info->primary = sim_channel();
+    ap_info->rssi = -50;
+    return ESP_OK;
+}
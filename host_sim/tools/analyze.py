@@ -0,0 +1,115 @@
+"""Latency report from a load.py log and a simulator trace.
+
+Each stimulus in the load log is matched with the first unclaimed trace
+row at or after its send time that has the expected event and 'a'
+column. Prints per-kind percentiles, unanswered stimuli, and the spacing
+of output GPIO edges per pin (the TimingKeeper jitter view).
+
+    python3 tools/analyze.py --load load.csv --trace trace.csv
+"""
+import argparse
+import bisect
+import csv
+from collections import defaultdict
+
+
+def read_trace(path):
+    """Rows as (epoch_us, event, a, b, c), wall clock from the header"""
+    epoch = 0
+    rows = []
+    with open(path) as f:
+        for line in f:
+            if line.startswith("# epoch_us="):
+                epoch = int(line.split("=", 1)[1])
+                continue
+            if line.startswith("t_us,") or not line.strip():
+                continue
+            t, event, a, b, c = line.rstrip("\n").split(",", 4)
+            rows.append((epoch + int(t), event, a, int(b), int(c)))
+    return rows
+
+
+def read_load(path):
+    with open(path, newline="") as f:
+        return [(int(r["send_epoch_us"]), r["kind"], r["expect_event"],
+                 r["expect_a"]) for r in csv.DictReader(f)]
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return float("nan")
+    k = min(len(sorted_values) - 1, int(round(p / 100 * (len(sorted_values) - 1))))
+    return sorted_values[k]
+
+
+def match(load, trace):
+    # Candidate answers indexed by (event, a), each list in time order
+    index = defaultdict(list)
+    for t, event, a, _, _ in trace:
+        index[(event, a)].append(t)
+    claimed = defaultdict(int)  # per key: answers already used, in order
+
+    latencies = defaultdict(list)
+    missed = defaultdict(int)
+    for sent, kind, event, expect_a in sorted(load):
+        best = None
+        for a in expect_a.split("|"):
+            times = index.get((event, a), [])
+            i = max(bisect.bisect_left(times, sent), claimed[(event, a)])
+            if i < len(times) and (best is None or times[i] < best[0]):
+                best = (times[i], (event, a), i)
+        if best is None:
+            missed[kind] += 1
+            continue
+        claimed[best[1]] = best[2] + 1
+        latencies[kind].append((best[0] - sent) / 1000.0)
+    return latencies, missed
+
+
+def edge_spacing(trace):
+    last = {}
+    spacing = defaultdict(list)
+    for t, event, a, _, _ in trace:
+        if event != "gpio":
+            continue
+        if a in last:
+            spacing[a].append((t - last[a]) / 1000.0)
+        last[a] = t
+    return spacing
+
+
+def report(title, groups, missed=None):
+    print(title)
+    print(f"  {'':12} {'n':>6} {'p50':>9} {'p90':>9} {'p99':>9} {'max':>9}"
+          + ("  missed" if missed is not None else ""))
+    for key in sorted(groups):
+        v = sorted(groups[key])
+        line = (f"  {key:12} {len(v):6d} {percentile(v, 50):9.2f} "
+                f"{percentile(v, 90):9.2f} {percentile(v, 99):9.2f} {v[-1]:9.2f}")
+        if missed is not None:
+            line += f"  {missed.get(key, 0):6d}"
+        print(line)
+    for key in sorted(set(missed or {}) - set(groups)):
+        print(f"  {key:12} {0:6d} {'':39}  {missed[key]:6d}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--load", default="load.csv")
+    ap.add_argument("--trace", default="trace.csv")
+    args = ap.parse_args()
+
+    trace = read_trace(args.trace)
+    latencies, missed = match(read_load(args.load), trace)
+
+    report("stimulus -> answer latency (ms)", latencies, missed)
+    spacing = edge_spacing(trace)
+    if spacing:
+        print()
+        report("output GPIO edge spacing (ms)",
+               {f"gpio {pin}": v for pin, v in spacing.items()})
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,239 @@
+"""Drive a task*_sim binary with a scripted MQTT/GPIO load.
+
+Starts the simulator, waits for its first SUBACK, then plays one scenario
+against the local broker. Every stimulus is logged to a CSV as
+
+    send_epoch_us,kind,expect_event,expect_a
+
+where (expect_event, expect_a) names the trace row that answers it; a
+'|' in expect_a separates alternatives. analyze.py joins this with the
+simulator trace.
+
+    python3 tools/load.py 2 --count 200 --rate 50
+"""
+import argparse
+import base64
+import csv
+import json
+import os
+import random
+import re
+import subprocess
+import sys
+import time
+
+import paho.mqtt.client as mqtt
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.normpath(os.path.join(HERE, "..", ".."))
+
+TASK_DIRS = {
+    1: "Task1_TimingKeeper",
+    2: "Task2_PriorityGuardian",
+    3: "Task3_WindowSync",
+    4: "Task4_Steganography",
+}
+
+
+def now_us():
+    return time.time_ns() // 1000
+
+
+def read_config(task):
+    """#define NAME "str" / NAME int from the task's config.h"""
+    path = os.path.join(REPO, TASK_DIRS[task], "main", "config.h")
+    defs = {}
+    with open(path) as f:
+        for m in re.finditer(r'^#define\s+(\w+)\s+("[^"]*"|-?\d+)', f.read(), re.M):
+            value = m.group(2)
+            defs[m.group(1)] = value.strip('"') if value.startswith('"') else int(value)
+    return defs
+
+
+def wait_ready(trace_path, proc, timeout):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if proc.poll() is not None:
+            sys.exit(f"simulator exited with {proc.returncode}")
+        try:
+            with open(trace_path) as f:
+                if any(",suback," in line for line in f):
+                    return
+        except FileNotFoundError:
+            pass
+        time.sleep(0.05)
+    sys.exit("simulator did not subscribe in time")
+
+
+class Load:
+    def __init__(self, args, proc, cfg):
+        self.args = args
+        self.proc = proc
+        self.cfg = cfg
+        self.rows = []
+        self.period = 1.0 / args.rate
+
+        host, _, port = args.broker.partition(":")
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+        self.client.connect(host, int(port or 1883))
+        self.client.loop_start()
+
+    def log(self, kind, expect_event, expect_a):
+        self.rows.append((now_us(), kind, expect_event, expect_a))
+
+    def publish(self, topic, payload, kind, expect_event, expect_a, qos=1):
+        # Logged before the call: the latency includes the broker hop
+        self.log(kind, expect_event, expect_a)
+        self.client.publish(topic, payload, qos=qos)
+
+    def gpio(self, pin, level, kind=None, expect_event=None, expect_a=None):
+        if kind:
+            self.log(kind, expect_event, expect_a)
+        self.proc.stdin.write(f"gpio {pin} {level}\n".encode())
+        self.proc.stdin.flush()
+
+    def pace(self, i, start):
+        delay = start + (i + 1) * self.period - time.time()
+        if delay > 0:
+            time.sleep(delay)
+
+    # Scenarios -------------------------------------------------------------- #
+    def task1(self):
+        # New patterns while the previous ones are still blinking
+        topic = self.cfg["MQTT_TOPIC"]
+        start = time.time()
+        for i in range(self.args.count):
+            pattern = {c: [random.randint(20, 200) for _ in range(4)]
+                       for c in ("red", "green", "blue")}
+            self.publish(topic, json_dumps(pattern), "pattern", "rx", topic)
+            self.pace(i, start)
+
+    def stream_payload(self, i):
+        value = f"{random.uniform(0, 100):.2f}"
+        if not self.args.seq:
+            return value
+        return f'{{"{self.cfg["STREAM_SEQ_KEY"]}":{i},"{self.cfg["STREAM_VALUE_KEY"]}":{value}}}'
+
+    def task2(self):
+        # Stream at --rate, one CHALLENGE every --distress-every messages.
+        # With --seq, --drop skips sequence numbers and --reorder swaps
+        # neighbours, to exercise the firmware's gap detection.
+        cfg = self.cfg
+        args = self.args
+        topic = cfg["STREAM_TOPIC"]
+        held = None
+        start = time.time()
+        for i in range(args.count):
+            if random.random() >= args.drop:
+                payload = self.stream_payload(i)
+                if held is None and random.random() < args.reorder:
+                    held = payload
+                else:
+                    self.publish(topic, payload, "stream", "rx", topic, qos=args.stream_qos)
+                    if held is not None:
+                        self.publish(topic, held, "stream", "rx", topic, qos=args.stream_qos)
+                        held = None
+            if i % self.args.distress_every == self.args.distress_every - 1:
+                self.publish(cfg["DISTRESS_TOPIC"], f"CHALLENGE {i}",
+                             "distress", "publish", cfg["ACK_TOPIC"])
+            self.pace(i, start)
+        if held is not None:
+            self.publish(topic, held, "stream", "rx", topic, qos=args.stream_qos)
+
+    def task3(self):
+        # Window open, then a button press inside the tolerance
+        cfg = self.cfg
+        pin = cfg["BUTTON_GPIO"]
+        # The window stays open WINDOW_MAX_MS; space presses beyond it
+        period = max(self.period, cfg["WINDOW_MAX_MS"] / 1000 + 0.2)
+        for i in range(self.args.count):
+            t0 = time.time()
+            self.publish(cfg["WINDOW_TOPIC"], "open", "window", "gpio",
+                         str(cfg["LED_BLUE"]))
+            time.sleep(self.args.press_ms / 1000)
+            self.gpio(pin, 0, "button", "publish", cfg["SYNC_PUB_TOPIC"])
+            time.sleep(cfg["DEBOUNCE_MS"] / 1000 * 2)
+            self.gpio(pin, 1)
+            time.sleep(max(0.0, t0 + period - time.time()))
+
+    def task4(self):
+        # One image, split into chunks of --chunk base64 characters
+        topic = self.cfg["TASK4_CHALLENGE_TOPIC"]
+        blob = base64.b64encode(os.urandom(self.args.image_kb * 1024)).decode()
+        size = self.args.chunk
+        start = time.time()
+        for i, off in enumerate(range(0, len(blob), size)):
+            payload = json_dumps({"agent_id": "load", "type": "png",
+                                  "data": blob[off:off + size]})
+            self.publish(topic, payload, "chunk", "rx", topic)
+            self.pace(i, start)
+
+    def run(self, task):
+        getattr(self, f"task{task}")()
+        time.sleep(self.args.drain)
+        self.client.loop_stop()
+        self.client.disconnect()
+
+        with open(self.args.out, "w", newline="") as f:
+            w = csv.writer(f)
+            w.writerow(("send_epoch_us", "kind", "expect_event", "expect_a"))
+            w.writerows(self.rows)
+
+
+def json_dumps(obj):
+    return json.dumps(obj, separators=(",", ":"))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("task", type=int, choices=sorted(TASK_DIRS))
+    ap.add_argument("--sim", help="simulator binary (default build/taskN_sim)")
+    ap.add_argument("--broker", default="localhost:1883")
+    ap.add_argument("--trace", default="trace.csv")
+    ap.add_argument("--out", default="load.csv")
+    ap.add_argument("--nvs", default="nvs_sim")
+    ap.add_argument("--count", type=int, default=100)
+    ap.add_argument("--rate", type=float, default=20.0, help="messages per second")
+    ap.add_argument("--distress-every", type=int, default=10)
+    ap.add_argument("--stream-qos", type=int, choices=(0, 1), default=0,
+                    help="task 2: QoS the stream is published with")
+    ap.add_argument("--seq", action="store_true",
+                    help="task 2: JSON stream samples with sequence numbers")
+    ap.add_argument("--drop", type=float, default=0.0,
+                    help="task 2: fraction of stream samples not sent")
+    ap.add_argument("--reorder", type=float, default=0.0,
+                    help="task 2: fraction of stream samples sent after the next one")
+    ap.add_argument("--press-ms", type=int, default=20,
+                    help="task 3: window open to button press")
+    ap.add_argument("--image-kb", type=int, default=32)
+    ap.add_argument("--chunk", type=int, default=1024)
+    ap.add_argument("--drain", type=float, default=2.0,
+                    help="seconds to wait for answers after the last stimulus")
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+
+    random.seed(args.seed)
+    sim = args.sim or os.path.join(HERE, "..", "build", f"task{args.task}_sim")
+    env = dict(os.environ, REEF_SIM_BROKER=args.broker)
+
+    if os.path.exists(args.trace):
+        os.remove(args.trace)
+
+    proc = subprocess.Popen([sim, "--trace", args.trace, "--nvs", args.nvs],
+                            stdin=subprocess.PIPE, env=env)
+    try:
+        wait_ready(args.trace, proc, timeout=30)
+        Load(args, proc, read_config(args.task)).run(args.task)
+        proc.stdin.write(b"quit\n")
+        proc.stdin.flush()
+        proc.wait(timeout=5)
+    finally:
+        if proc.poll() is None:
+            proc.kill()
+
+    print(f"load: {args.out}, trace: {args.trace}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,188 @@
+"""Compare Task2 with the stream subscribed at QoS 0 and at QoS 1.
+
+Builds task2_sim once per STREAM_QOS, plays the same load.py scenario
+against each (stream published at QoS 1 with sequence numbers, so the
+subscription QoS is what differs), and prints per mode:
+
+- stream throughput, and lost/reordered samples as counted by the firmware;
+  samples its own queues dropped are reported apart from network loss
+- distress -> ACK latency
+- broker load from the $SYS counters: packets and bytes in and out
+
+The $SYS counters are only updated every sys_interval seconds (10 by
+default), so run the broker with a short one:
+
+    printf 'listener 1883\\nallow_anonymous true\\nsys_interval 1\\n' > sys.conf
+    mosquitto -c sys.conf &
+    python3 tools/qos_compare.py -- --count 2000 --rate 200 --drop 0.01
+
+Arguments after `--` go to load.py.
+"""
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+import analyze
+from load import read_config
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SIM_DIR = os.path.normpath(os.path.join(HERE, ".."))
+
+SYS_TOPICS = {
+    "$SYS/broker/messages/received": "pkts_in",
+    "$SYS/broker/messages/sent": "pkts_out",
+    "$SYS/broker/bytes/received": "bytes_in",
+    "$SYS/broker/bytes/sent": "bytes_out",
+}
+
+STATS_RE = re.compile(r"STREAM qos=(\d+) rx=(\d+) \(([\d.]+)/s\) lost=(\d+) "
+                      r"reordered=(\d+) dup=(\d+) resync=(\d+) dropped=(\d+) "
+                      r"dispatch_stream=(\d+) dispatch_distress=(\d+) dispatch_other=(\d+)")
+
+
+class SysCounters:
+    """Latest $SYS counter values of the broker"""
+
+    def __init__(self, broker, interval):
+        self.interval = interval
+        self.values = {}
+        self.lock = threading.Lock()
+        host, _, port = broker.partition(":")
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+        self.client.on_message = self.on_message
+        self.client.connect(host, int(port or 1883))
+        for topic in SYS_TOPICS:
+            self.client.subscribe(topic)
+        self.client.loop_start()
+
+    def on_message(self, client, userdata, msg):
+        with self.lock:
+            self.values[SYS_TOPICS[msg.topic]] = int(msg.payload)
+
+    def snapshot(self):
+        # Wait for the broker's next update, so the counters are current
+        time.sleep(self.interval + 0.5)
+        with self.lock:
+            return dict(self.values)
+
+    def close(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+def build(qos):
+    build_dir = os.path.join(SIM_DIR, f"build_qos{qos}")
+    for cmd in (["cmake", "-S", SIM_DIR, "-B", build_dir, f"-DTASK2_STREAM_QOS={qos}"],
+                ["cmake", "--build", build_dir, "-j", "--target", "task2_sim"]):
+        print("+ " + " ".join(cmd), file=sys.stderr)
+        subprocess.run(cmd, check=True)
+    return os.path.join(build_dir, "task2_sim")
+
+
+def run(args, qos, sys_counters, workdir):
+    sim = os.path.join(SIM_DIR, f"build_qos{qos}", "task2_sim")
+    if not args.no_build:
+        sim = build(qos)
+
+    trace = os.path.join(workdir, f"trace_qos{qos}.csv")
+    load = os.path.join(workdir, f"load_qos{qos}.csv")
+    period_s = read_config(2)["STREAM_STATS_PERIOD_MS"] / 1000
+
+    before = sys_counters.snapshot()
+    cmd = [sys.executable, os.path.join(HERE, "load.py"), "2", "--sim", sim,
+           "--broker", args.broker, "--trace", trace, "--out", load,
+           "--nvs", os.path.join(workdir, f"nvs_qos{qos}"),
+           "--stream-qos", "1", "--seq", "--drain", str(period_s + 1)] + args.load_args
+    print("+ " + " ".join(cmd), file=sys.stderr)
+    out = subprocess.run(cmd, check=True, stdout=subprocess.PIPE, text=True,
+                         errors="replace").stdout
+    after = sys_counters.snapshot()
+
+    stats = None
+    for m in STATS_RE.finditer(out):
+        stats = m
+    rows = analyze.read_trace(trace)
+    latencies, missed = analyze.match(analyze.read_load(load), rows)
+
+    stream_rx = [t for t, event, a, _, _ in rows
+                 if event == "rx" and a == read_config(2)["STREAM_TOPIC"]]
+    span = (stream_rx[-1] - stream_rx[0]) / 1e6 if len(stream_rx) > 1 else 0
+
+    # The firmware's gap count includes samples its own queues dropped
+    local = int(stats.group(8)) + int(stats.group(9)) if stats else None
+    ack = sorted(latencies.get("distress", []))
+    return {
+        "rx": len(stream_rx),
+        "rate": len(stream_rx) / span if span else 0.0,
+        "lost": max(int(stats.group(4)) - local, 0) if stats else None,
+        "local": local,
+        "distress_local": int(stats.group(10)) if stats else None,
+        "reordered": int(stats.group(5)) if stats else None,
+        "ack_p50": analyze.percentile(ack, 50),
+        "ack_p99": analyze.percentile(ack, 99),
+        "ack_missed": missed.get("distress", 0),
+        "broker": {k: after.get(k, 0) - before.get(k, 0) for k in SYS_TOPICS.values()},
+    }
+
+
+def report(results):
+    def fmt(v):
+        if v is None:
+            return "?"
+        return f"{v:.1f}" if isinstance(v, float) else str(v)
+
+    lines = [
+        ("stream samples received", "rx"),
+        ("stream rate (/s)", "rate"),
+        ("lost in the network", "lost"),
+        ("dropped by the firmware", "local"),
+        ("reordered (firmware count)", "reordered"),
+        ("distress ACK p50 (ms)", "ack_p50"),
+        ("distress ACK p99 (ms)", "ack_p99"),
+        ("distress unanswered", "ack_missed"),
+        ("distress dropped by firmware", "distress_local"),
+    ]
+    print(f"\n{'':30}" + "".join(f"{'QoS ' + str(q):>14}" for q in results))
+    for label, key in lines:
+        print(f"{label:30}" + "".join(f"{fmt(r[key]):>14}" for r in results.values()))
+    for key in SYS_TOPICS.values():
+        print(f"{'broker ' + key:30}"
+              + "".join(f"{fmt(r['broker'][key]):>14}" for r in results.values()))
+
+
+def main():
+    argv = sys.argv[1:]
+    load_args = []
+    if "--" in argv:
+        cut = argv.index("--")
+        argv, load_args = argv[:cut], argv[cut + 1:]
+
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--broker", default="localhost:1883")
+    ap.add_argument("--sys-interval", type=float, default=1.0,
+                    help="the broker's sys_interval in seconds")
+    ap.add_argument("--no-build", action="store_true", help="reuse build_qos0/1")
+    args = ap.parse_args(argv)
+    args.load_args = load_args
+
+    sys_counters = SysCounters(args.broker, args.sys_interval)
+    results = {}
+    try:
+        with tempfile.TemporaryDirectory() as workdir:
+            for qos in (0, 1):
+                results[qos] = run(args, qos, sys_counters, workdir)
+    finally:
+        sys_counters.close()
+    report(results)
+
+
+if __name__ == "__main__":
+    main()